@@ -0,0 +1,150 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+// Minimal stand-in for the parts of aviutl_exedit_sdk the limiter core touches, so
+// that it builds on hosts without AviUtl. Only used by the benchmark and the other
+// host-side targets; the plugin itself keeps building against the real SDK.
+
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+using BOOL = int32_t;
+#endif
+
+
+namespace AviUtl
+{
+	struct PixelYC
+	{
+		int16_t y;
+		int16_t cb;
+		int16_t cr;
+	};
+
+	struct EditHandle;
+
+	struct FileInfo
+	{
+		int32_t flag;
+		const char* name;
+		int32_t w, h;
+		int32_t video_rate, video_scale;
+		int32_t audio_rate, audio_ch;
+		int32_t frame_n;
+	};
+
+	struct FilterProcInfo
+	{
+		int32_t flag;
+		PixelYC* ycp_edit;
+		PixelYC* ycp_temp;
+		int32_t w, h;
+		int32_t max_w, max_h;
+		int32_t frame;
+		int32_t frame_n;
+		int32_t org_w, org_h;
+		int16_t* audiop;
+		int32_t audio_n;
+		int32_t audio_ch;
+		void* pixelp;
+		EditHandle* editp;
+		int32_t yc_size;
+		int32_t line_size;
+	};
+
+	using MultiThreadFunc = void(*)(int32_t thread_id, int32_t thread_num, void* param1, void* param2);
+
+	struct FilterPlugin;
+
+	struct ExFunc
+	{
+		BOOL(*get_file_info)(EditHandle* editp, FileInfo* fip);
+		BOOL(*is_saving)(EditHandle* editp);
+		BOOL(*exec_multi_thread_func)(MultiThreadFunc func, void* param1, void* param2);
+		void* (*get_ycp_filtering_cache_ex)(FilterPlugin* fp, EditHandle* editp, int32_t n, int32_t* w, int32_t* h);
+		BOOL(*set_ycp_filtering_cache_size)(FilterPlugin* fp, int32_t w, int32_t h, int32_t d, int32_t flag);
+		int32_t(*get_frame_n)(EditHandle* editp);
+		BOOL(*ini_save_str)(FilterPlugin* fp, const char* key, const char* str);
+	};
+
+	namespace detail
+	{
+		enum class FilterPluginUpdateStatus : int32_t
+		{
+			All = 0,
+			Track = 0x10000,
+			Check = 0x20000,
+		};
+	}
+
+	struct FilterPlugin
+	{
+		enum class Flag : uint32_t
+		{
+			ExInformation = 1 << 8,
+		};
+
+		int32_t flag;
+		int32_t x, y;
+		const char* name;
+		int32_t track_n;
+		const char** track_name;
+		int32_t* track_default;
+		int32_t* track_s;
+		int32_t* track_e;
+		int32_t check_n;
+		const char** check_name;
+		int32_t* check_default;
+		void* func_proc;
+		void* func_init;
+		void* func_exit;
+		void* func_update;
+		void* func_WndProc;
+		int32_t* track;
+		int32_t* check;
+		void* ex_data_ptr;
+		int32_t ex_data_size;
+		const char* information;
+		void* func_save_start;
+		void* func_save_end;
+		ExFunc* exfunc;
+	};
+
+	struct FilterPluginDLL
+	{
+		using UpdateStatus = detail::FilterPluginUpdateStatus;
+
+		FilterPlugin::Flag flag;
+		int32_t x, y;
+		const char* name;
+		int32_t track_n;
+		const char** track_name;
+		int32_t* track_default;
+		int32_t* track_s;
+		int32_t* track_e;
+		int32_t check_n;
+		const char** check_name;
+		int32_t* check_default;
+		BOOL(*func_proc)(FilterPlugin* fp, FilterProcInfo* fpip);
+		BOOL(*func_init)(FilterPlugin* fp);
+		BOOL(*func_exit)(FilterPlugin* fp);
+		BOOL(*func_update)(FilterPlugin* fp, UpdateStatus status);
+		void* func_WndProc;
+		int32_t* track;
+		int32_t* check;
+		void* ex_data_ptr;
+		int32_t ex_data_size;
+		const char* information;
+	};
+}
@@ -0,0 +1,52 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "aviutl/filter.hpp"
+#include "executor.h"
+
+namespace luminance_limiter_sg
+{
+	// Runs tasks on AviUtl's own worker threads through exec_multi_thread_func.
+	class AviUtlExecutor
+	{
+	public:
+		explicit AviUtlExecutor(const AviUtl::ExFunc* const exfunc) noexcept
+			: exfunc(exfunc)
+		{
+		}
+
+		template<typename F>
+		inline const void parallel_for(const uint32_t count, const F& task) const
+		{
+			struct Context
+			{
+				const F* task;
+				uint32_t count;
+				std::atomic<uint32_t> next;
+			};
+			auto context = Context{ &task, count, 0u };
+
+			exfunc->exec_multi_thread_func(
+				[](int32_t thread_id, int32_t thread_num, void* param1, void* param2) {
+					auto& context = *static_cast<Context*>(param1);
+					for (auto i = context.next++; i < context.count; i = context.next++)
+					{
+						(*context.task)(i);
+					}
+				},
+				&context, nullptr);
+		}
+	private:
+		const AviUtl::ExFunc* exfunc = nullptr;
+	};
+}
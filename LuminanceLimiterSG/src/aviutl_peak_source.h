@@ -0,0 +1,71 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+
+#include "aviutl/filter.hpp"
+#include "frame.h"
+#include "peak_index.h"
+
+namespace luminance_limiter_sg
+{
+	// FramePeakSource over AviUtl's filtering cache: the input image of any frame is
+	// fetched with get_ycp_filtering_cache_ex and measured, and the result is kept in
+	// the PeakIndex when there is one. Only usable inside func_proc. The image is the
+	// input of the filter, so only the first instance of a stack reads it.
+	template<typename M>
+	class AviUtlPeakSource
+	{
+	public:
+		AviUtlPeakSource(AviUtl::FilterPlugin* fp, AviUtl::FilterProcInfo* fpip, PeakIndex* index, M measure) noexcept
+			: fp(fp), fpip(fpip), index(index), measure(measure)
+		{
+			fp->exfunc->set_ycp_filtering_cache_size(fp, fpip->max_w, fpip->max_h, 1, 0);
+		}
+
+		inline const std::optional<std::array<double, 2>> peaks(const int32_t frame) const
+		{
+			if (frame < 0 || frame >= fpip->frame_n)
+			{
+				return std::nullopt;
+			}
+
+			if (index)
+			{
+				if (const auto indexed = index->peaks(frame))
+				{
+					return indexed;
+				}
+			}
+
+			auto width = 0;
+			auto height = 0;
+			const auto cache = static_cast<AviUtl::PixelYC*>(fp->exfunc->get_ycp_filtering_cache_ex(fp, fpip->editp, frame, &width, &height));
+			if (!cache)
+			{
+				return std::nullopt;
+			}
+
+			const auto measured = measure(Frame(cache, width, height, fpip->max_w));
+			if (index)
+			{
+				index->store(frame, measured);
+			}
+			return measured;
+		}
+	private:
+		AviUtl::FilterPlugin* fp;
+		AviUtl::FilterProcInfo* fpip;
+		PeakIndex* index;
+		M measure;
+	};
+}
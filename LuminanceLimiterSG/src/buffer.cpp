@@ -1,62 +1,107 @@
-/*
-	Copyright(c) 2023 SoseiGocho
-	This Source Code Form is subject to the terms of the Mozilla Public License,
-	v. 2.0.If a copy of the MPL was not distributed with this file, You can
-	obtain one at https ://mozilla.org/MPL/2.0/.
-*/
-
-
-#include "buffer.h"
-
-#include "luminance.h"
-
-
-namespace luminance_limiter_sg
-{
-	Buffer::Buffer(uint32_t width, uint32_t height) noexcept
-		: width(width), height(height), buffer(width * height, 0.0)
-	{
-	}
-
-	const double Buffer::maximum() const noexcept
-	{
-		return *std::max_element(this->buffer.begin(), this->buffer.end());
-	}
-
-	const double Buffer::minimum() const noexcept
-	{
-		return *std::min_element(this->buffer.begin(), this->buffer.end());
-	}
-
-	const void Buffer::fetch_image(uint32_t width, uint32_t height, AviUtl::PixelYC* dst) noexcept
-	{
-		AviUtl::PixelYC* row = nullptr;
-		auto buf_idx = 0;
-		for (auto y = 0; y < height; ++y)
-		{
-			row = dst + y * this->width;
-			for (auto x = 0; x < width; ++x)
-			{
-				buffer[buf_idx] = Luminance::normalize_y((row + x)->y);
-				buf_idx++;
-			}
-		}
-	}
-
-	const void Buffer::render(uint32_t width, uint32_t height, AviUtl::PixelYC* dst) const
-	{
-		AviUtl::PixelYC* row = nullptr;
-		auto buf_idx = 0;
-		for (auto y = 0; y < height; ++y)
-		{
-			row = dst + y * this->width;
-			for (auto x = 0; x < width; ++x)
-			{
-				const auto denormalized = Luminance::denormalize_y(buffer[buf_idx]);
-				using U = decltype(denormalized);
-				(row + x)->y = denormalized > static_cast<U>(INT16_MAX) ? static_cast<U>(INT16_MAX) : static_cast<int16_t>(denormalized);
-				buf_idx++;
-			}
-		}
-	}
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#include "buffer.h"
+
+#include <algorithm>
+#include <type_traits>
+
+#include "kernel.h"
+
+
+namespace luminance_limiter_sg
+{
+	template<typename T>
+	static inline auto fetch_kernel(const Kernels& kernel) noexcept
+	{
+		if constexpr (std::is_same_v<T, double>)
+		{
+			return kernel.fetch_y_f64;
+		}
+		else if constexpr (std::is_same_v<T, float>)
+		{
+			return kernel.fetch_y_f32;
+		}
+		else
+		{
+			return kernel.fetch_y_i16;
+		}
+	}
+
+	template<typename T>
+	static inline auto render_kernel(const Kernels& kernel) noexcept
+	{
+		if constexpr (std::is_same_v<T, double>)
+		{
+			return kernel.render_y_f64;
+		}
+		else if constexpr (std::is_same_v<T, float>)
+		{
+			return kernel.render_y_f32;
+		}
+		else
+		{
+			return kernel.render_y_i16;
+		}
+	}
+
+	template<typename T>
+	Buffer<T>::Buffer(uint32_t width, uint32_t height)
+		: Buffer(width, height, width, ScratchPool::global())
+	{
+	}
+
+	template<typename T>
+	Buffer<T>::Buffer(uint32_t width, uint32_t height, uint32_t stride, ScratchPool& pool)
+		: width(width), height(height), stride(stride),
+		block(pool.acquire(static_cast<size_t>(width) * height * sizeof(T))), buffer(block.as<T>())
+	{
+	}
+
+	template<typename T>
+	const double Buffer<T>::maximum() const noexcept
+	{
+		return traits::to_normalized(*std::max_element(buffer, end()));
+	}
+
+	template<typename T>
+	const double Buffer<T>::minimum() const noexcept
+	{
+		return traits::to_normalized(*std::min_element(buffer, end()));
+	}
+
+	template<typename T>
+	const void Buffer<T>::fetch_image(uint32_t width, uint32_t height, AviUtl::PixelYC* dst) noexcept
+	{
+		const auto fetch = fetch_kernel<T>(kernels());
+		for (auto y = 0u; y < height; ++y)
+		{
+			fetch(dst + y * stride, width, buffer + y * width);
+		}
+	}
+
+	template<typename T>
+	const void Buffer<T>::render(uint32_t width, uint32_t height, AviUtl::PixelYC* dst) const
+	{
+		const auto render = render_kernel<T>(kernels());
+		for (auto y = 0u; y < height; ++y)
+		{
+			render(dst + y * stride, width, buffer + y * width);
+		}
+	}
+
+	template<typename T>
+	const T* Buffer<T>::data() const noexcept
+	{
+		return buffer;
+	}
+
+	template class Buffer<double>;
+	template class Buffer<float>;
+	template class Buffer<int16_t>;
 }
\ No newline at end of file
@@ -1,41 +1,95 @@
-/*
-	Copyright(c) 2023 SoseiGocho
-	This Source Code Form is subject to the terms of the Mozilla Public License,
-	v. 2.0.If a copy of the MPL was not distributed with this file, You can
-	obtain one at https ://mozilla.org/MPL/2.0/.
-*/
-
-
-#pragma once
-
-
-#include <vector>
-
-#include "aviutl/filter.hpp"
-#include "common_utility.h"
-
-namespace luminance_limiter_sg
-{
-	class Buffer {
-	public:
-		Buffer(uint32_t width, uint32_t height) noexcept;
-
-		const double maximum() const noexcept;
-		const double minimum() const noexcept;
-
-		template<typename F>
-		inline const void pixelwise_map(const F&& f) {
-			for (auto&& elem : buffer)
-			{
-				elem = f(elem);
-			}
-		}
-
-		const void fetch_image(uint32_t width, uint32_t height, AviUtl::PixelYC* dst) noexcept;
-		const void render(uint32_t width, uint32_t height, AviUtl::PixelYC* dst) const;
-	private:
-		uint32_t width = 0;
-		uint32_t height = 0;
-		std::vector<double> buffer;
-	};
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#pragma once
+
+
+#include <cstdint>
+
+#include "aviutl/filter.hpp"
+#include "common_utility.h"
+#include "luminance.h"
+#include "scratch_pool.h"
+
+namespace luminance_limiter_sg
+{
+	// Storage of one staged Y value. pixelwise_map always sees normalized doubles.
+	// Against Buffer<double>, Buffer<int16_t> renders identical Y and Buffer<float>
+	// differs by at most tolerance Y codes, where the float rounding of a curve
+	// output crosses an integer before truncation.
+	template<typename T>
+	struct BufferTraits;
+
+	template<>
+	struct BufferTraits<double>
+	{
+		constexpr static inline auto tolerance = 0;
+		constexpr static inline double to_normalized(const double value) noexcept { return value; }
+		constexpr static inline double from_normalized(const double y) noexcept { return y; }
+	};
+
+	template<>
+	struct BufferTraits<float>
+	{
+		constexpr static inline auto tolerance = 1;
+		constexpr static inline double to_normalized(const float value) noexcept { return static_cast<double>(value); }
+		constexpr static inline float from_normalized(const double y) noexcept { return static_cast<float>(y); }
+	};
+
+	template<>
+	struct BufferTraits<int16_t>
+	{
+		constexpr static inline auto tolerance = 0;
+		constexpr static inline double to_normalized(const int16_t value) noexcept { return Luminance::normalize_y(value); }
+		constexpr static inline int16_t from_normalized(const double y) noexcept { return Luminance::quantize_y(Luminance::denormalize_y(y)); }
+	};
+
+	// Contiguous, 64-byte aligned Y plane of width * height values, fetched from and
+	// rendered to images whose rows are stride pixels apart. The plane is leased from
+	// a ScratchPool and its values are unspecified until the first fetch_image.
+	template<typename T>
+	class Buffer {
+	public:
+		using value_type = T;
+		using traits = BufferTraits<T>;
+
+		Buffer(uint32_t width, uint32_t height);
+		Buffer(uint32_t width, uint32_t height, uint32_t stride, ScratchPool& pool);
+
+		const double maximum() const noexcept;
+		const double minimum() const noexcept;
+
+		template<typename F>
+		inline const void pixelwise_map(const F&& f) {
+			for (auto* elem = buffer; elem != end(); ++elem)
+			{
+				*elem = traits::from_normalized(f(traits::to_normalized(*elem)));
+			}
+		}
+
+		const void fetch_image(uint32_t width, uint32_t height, AviUtl::PixelYC* dst) noexcept;
+		const void render(uint32_t width, uint32_t height, AviUtl::PixelYC* dst) const;
+
+		const T* data() const noexcept;
+	private:
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t stride = 0;
+		ScratchPool::Block block;
+		T* buffer = nullptr;
+
+		inline T* end() const noexcept
+		{
+			return buffer + static_cast<size_t>(width) * height;
+		}
+	};
+
+	extern template class Buffer<double>;
+	extern template class Buffer<float>;
+	extern template class Buffer<int16_t>;
 }
\ No newline at end of file
@@ -0,0 +1,62 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+
+#include "cache_directory.h"
+
+#include <cstdlib>
+#include <system_error>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+
+namespace luminance_limiter_sg
+{
+	constexpr static inline auto cache_name = "LuminanceLimiterSG";
+
+	static inline const std::filesystem::path user_cache_root()
+	{
+#ifdef _WIN32
+		wchar_t local[MAX_PATH] = {};
+		const auto length = GetEnvironmentVariableW(L"LOCALAPPDATA", local, MAX_PATH);
+		if (length > 0 && length < MAX_PATH)
+		{
+			return std::filesystem::path(local);
+		}
+#else
+		if (const auto xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg)
+		{
+			return std::filesystem::path(xdg);
+		}
+		if (const auto home = std::getenv("HOME"); home && *home)
+		{
+			return std::filesystem::path(home) / ".cache";
+		}
+#endif
+		auto error = std::error_code();
+		return std::filesystem::temp_directory_path(error);
+	}
+
+	const std::filesystem::path& cache_directory()
+	{
+		static const auto directory = []() {
+			const auto root = user_cache_root();
+			if (root.empty())
+			{
+				return std::filesystem::path();
+			}
+			const auto path = root / cache_name;
+			auto error = std::error_code();
+			std::filesystem::create_directories(path, error);
+			return std::filesystem::is_directory(path, error) ? path : std::filesystem::path();
+			}();
+		return directory;
+	}
+}
\ No newline at end of file
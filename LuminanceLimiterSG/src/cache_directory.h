@@ -0,0 +1,22 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+
+#pragma once
+
+#include <filesystem>
+
+namespace luminance_limiter_sg
+{
+	// Per-user directory for the files the filter keeps for itself, so that nothing is
+	// written beside the user's media: %LOCALAPPDATA%\LuminanceLimiterSG on Windows,
+	// $XDG_CACHE_HOME/LuminanceLimiterSG or ~/.cache/LuminanceLimiterSG elsewhere, or
+	// the temporary directory when those are not set. Created on first use; empty when
+	// it cannot be created.
+	const std::filesystem::path& cache_directory();
+}
\ No newline at end of file
@@ -1,6 +1,6 @@
-#pragma once
-
-namespace luminance_limiter_sg
-{
-	constexpr inline auto id = [](auto x) -> auto { return x; };
+#pragma once
+
+namespace luminance_limiter_sg
+{
+	constexpr inline auto id = [](auto x) -> auto { return x; };
 }
\ No newline at end of file
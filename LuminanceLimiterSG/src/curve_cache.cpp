@@ -0,0 +1,86 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#include "curve_cache.h"
+
+#include <cmath>
+
+#include "luminance.h"
+
+
+namespace luminance_limiter_sg
+{
+	const double quantize_peak(const double peak, const uint32_t step) noexcept
+	{
+		if (step == 0u)
+		{
+			return peak;
+		}
+		const auto steps = std::round(Luminance::denormalize_y(peak) / step);
+		return Luminance::normalize_y(steps * step);
+	}
+
+	CurveCache::CurveCache(const size_t capacity)
+		: entries(capacity == 0u ? 1u : capacity)
+	{
+	}
+
+	const uint64_t CurveCache::hits() const noexcept
+	{
+		return hit_count;
+	}
+
+	const uint64_t CurveCache::misses() const noexcept
+	{
+		return miss_count;
+	}
+
+	const void CurveCache::clear() noexcept
+	{
+		for (auto&& entry : entries)
+		{
+			entry.valid = false;
+		}
+		hit_count = 0;
+		miss_count = 0;
+	}
+
+	const TransferTable* CurveCache::find(const CurveKey& key) noexcept
+	{
+		for (auto&& entry : entries)
+		{
+			if (entry.valid && entry.key == key)
+			{
+				entry.last_used = ++clock;
+				return &entry.table;
+			}
+		}
+		return nullptr;
+	}
+
+	const void CurveCache::store(const CurveKey& key, const TransferTable& table) noexcept
+	{
+		auto victim = &entries.front();
+		for (auto&& entry : entries)
+		{
+			if (!entry.valid)
+			{
+				victim = &entry;
+				break;
+			}
+			if (entry.last_used < victim->last_used)
+			{
+				victim = &entry;
+			}
+		}
+		victim->key = key;
+		victim->table = table;
+		victim->valid = true;
+		victim->last_used = ++clock;
+	}
+}
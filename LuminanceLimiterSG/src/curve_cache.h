@@ -0,0 +1,90 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "interpolation.h"
+#include "transfer_table.h"
+
+namespace luminance_limiter_sg
+{
+	// Every input the limiter table is built from. The peaks are quantized before they
+	// get here, so the table depends on the key alone.
+	struct CurveKey
+	{
+		double top_limit = 0.0;
+		double top_threshold = 0.0;
+		double bottom_limit = 0.0;
+		double bottom_threshold = 0.0;
+		double top_peak = 0.0;
+		double bottom_peak = 0.0;
+		InterpolationMode mode = InterpolationMode::Linear;
+
+		bool operator==(const CurveKey&) const = default;
+	};
+
+	// Rounds a normalized peak to a multiple of step YC48 Y; step 0 keeps it exact.
+	const double quantize_peak(const double peak, const uint32_t step) noexcept;
+
+	// Least recently used tables by CurveKey. Storage is allocated once on construction.
+	class CurveCache
+	{
+	public:
+		explicit CurveCache(const size_t capacity = 4u);
+
+		// Leaves table alone when held already names key, copies a cached table on a hit,
+		// and calls bake(table) and keeps the result on a miss.
+		template<typename F>
+		inline const void load(const CurveKey& key, std::optional<CurveKey>& held, TransferTable& table, const F& bake)
+		{
+			if (held == key)
+			{
+				hit_count++;
+				return;
+			}
+
+			if (const auto entry = find(key))
+			{
+				table = *entry;
+				hit_count++;
+			}
+			else
+			{
+				bake(table);
+				store(key, table);
+				miss_count++;
+			}
+			held = key;
+		}
+
+		const uint64_t hits() const noexcept;
+		const uint64_t misses() const noexcept;
+		const void clear() noexcept;
+	private:
+		struct Entry
+		{
+			CurveKey key;
+			uint64_t last_used = 0;
+			bool valid = false;
+			TransferTable table;
+		};
+
+		std::vector<Entry> entries;
+		uint64_t clock = 0;
+		uint64_t hit_count = 0;
+		uint64_t miss_count = 0;
+
+		const TransferTable* find(const CurveKey& key) noexcept;
+		const void store(const CurveKey& key, const TransferTable& table) noexcept;
+	};
+}
@@ -1,27 +1,38 @@
-/*
-	Copyright(c) 2023 SoseiGocho
-	This Source Code Form is subject to the terms of the Mozilla Public License,
-	v. 2.0.If a copy of the MPL was not distributed with this file, You can
-	obtain one at https ://mozilla.org/MPL/2.0/.
-*/
-
-
-#pragma once
-
-#include <concepts>
-
-#include "aviutl/FilterPlugin.hpp"
-
-namespace luminance_limiter_sg
-{
-	template<typename T>
-	concept Effector = requires (T a, AviUtl::FilterPlugin * fp, const Buffer & buffer)
-	{
-		{ new T(fp) };
-		{ a.effect() } noexcept -> std::invocable;
-		{ a.fetch_trackbar_and_buffer(fp, buffer) };
-		{ a.used() } noexcept;
-		{ a.reset() } noexcept;
-		{ a.is_using() } noexcept;
-	};
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <concepts>
+#include <cstdint>
+
+#include "buffer.h"
+#include "histogram.h"
+#include "parameters.h"
+#include "transfer_table.h"
+
+namespace luminance_limiter_sg
+{
+	// What a Rack slot has to provide. The pixel loop only ever sees the table
+	// effect() hands out, so every effector shares the same kernels.
+	template<typename T>
+	concept Effector = requires (T a, const T c, const Parameters & parameters, const Buffer<double> & buffer, const std::array<double, 2> & peaks, const Histogram & histogram)
+	{
+		{ new T(parameters) };
+		{ a.effect() } noexcept -> std::convertible_to<const TransferTable&>;
+		{ a.fetch_trackbar_and_buffer(parameters, buffer) };
+		{ a.fetch_trackbar_and_peaks(parameters, peaks) };
+		{ a.fetch_trackbar_and_histogram(parameters, histogram) };
+		{ c.peaks_of(parameters, histogram) } noexcept -> std::convertible_to<std::array<double, 2>>;
+		{ c.raw_peaks() } noexcept -> std::convertible_to<const std::array<double, 2>&>;
+		{ a.used() } noexcept;
+		{ a.reset() } noexcept;
+		{ a.is_using() } noexcept;
+	};
 }
\ No newline at end of file
@@ -0,0 +1,150 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#include "envelope_checkpoints.h"
+
+#include <algorithm>
+
+#include "luminance.h"
+
+
+namespace luminance_limiter_sg
+{
+	EnvelopeCheckpoints::EnvelopeCheckpoints(const int32_t interval, const size_t capacity) noexcept
+		: interval(std::max(interval, 1)), capacity(std::max(capacity, size_t{ 1 }))
+	{
+	}
+
+	const void EnvelopeCheckpoints::record(const int32_t frame, const std::array<double, 2>& raw, const std::array<double, 2>& peaks, const PeakEnvelopeGenerator& envelope)
+	{
+		if (frame < 0)
+		{
+			return;
+		}
+
+		const auto offset = static_cast<size_t>(frame % interval);
+		auto* checkpoint = find(frame - static_cast<int32_t>(offset));
+		if (offset == 0u)
+		{
+			if (!checkpoint)
+			{
+				if (checkpoints.empty())
+				{
+					checkpoints.resize(capacity);
+					for (auto&& storage : checkpoints)
+					{
+						storage.envelope = envelope;
+						storage.fed.reserve(static_cast<size_t>(interval));
+					}
+				}
+				checkpoint = &*std::min_element(checkpoints.begin(), checkpoints.end(), [](const auto& a, const auto& b) {
+					return a.last_use < b.last_use;
+					});
+				checkpoint->frame = frame;
+			}
+			checkpoint->envelope = envelope;
+			checkpoint->fed.clear();
+			checkpoint->last_use = ++uses;
+			checkpoint->fed.push_back(Fed{ raw, peaks });
+			return;
+		}
+
+		if (!checkpoint || checkpoint->fed.size() < offset)
+		{
+			return;
+		}
+		// Frames processed again replace what followed them.
+		checkpoint->fed.resize(offset);
+		checkpoint->fed.push_back(Fed{ raw, peaks });
+	}
+
+	const bool EnvelopeCheckpoints::restore(const int32_t frame, PeakEnvelopeGenerator& envelope)
+	{
+		if (frame < 0)
+		{
+			return false;
+		}
+
+		const auto offset = static_cast<size_t>(frame % interval);
+		auto* const checkpoint = find(frame - static_cast<int32_t>(offset));
+		if (!checkpoint || checkpoint->fed.size() < offset)
+		{
+			return false;
+		}
+
+		checkpoint->last_use = ++uses;
+		envelope = checkpoint->envelope;
+		for (auto i = size_t{ 0 }; i < offset; ++i)
+		{
+			const auto [top, bottom] = checkpoint->fed[i].peaks;
+			envelope.update_and_get_envelope_peaks(top, bottom);
+		}
+		return true;
+	}
+
+	const bool EnvelopeCheckpoints::agrees(const int32_t frame, const std::optional<std::array<double, 2>>& measured) const noexcept
+	{
+		if (frame < 0 || !measured)
+		{
+			return true;
+		}
+
+		const auto offset = static_cast<size_t>(frame % interval);
+		const auto* const checkpoint = find(frame - static_cast<int32_t>(offset));
+		if (!checkpoint || checkpoint->fed.size() <= offset)
+		{
+			return true;
+		}
+		const auto& recorded = checkpoint->fed[offset].raw;
+		for (auto i = size_t{ 0 }; i < 2u; ++i)
+		{
+			if (Luminance::quantize_y(Luminance::denormalize_y(recorded[i])) != Luminance::quantize_y(Luminance::denormalize_y(measured.value()[i])))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	const int32_t EnvelopeCheckpoints::start_of(const int32_t frame) const noexcept
+	{
+		return frame - frame % interval;
+	}
+
+	const void EnvelopeCheckpoints::clear() noexcept
+	{
+		for (auto&& checkpoint : checkpoints)
+		{
+			checkpoint.frame = unused;
+			checkpoint.last_use = 0u;
+		}
+	}
+
+	const size_t EnvelopeCheckpoints::size() const noexcept
+	{
+		return static_cast<size_t>(std::count_if(checkpoints.begin(), checkpoints.end(), [](const auto& checkpoint) {
+			return checkpoint.frame != unused;
+			}));
+	}
+
+	EnvelopeCheckpoints::Checkpoint* EnvelopeCheckpoints::find(const int32_t frame) noexcept
+	{
+		const auto found = std::find_if(checkpoints.begin(), checkpoints.end(), [frame](const auto& checkpoint) {
+			return checkpoint.frame == frame;
+			});
+		return found == checkpoints.end() ? nullptr : &*found;
+	}
+
+	const EnvelopeCheckpoints::Checkpoint* EnvelopeCheckpoints::find(const int32_t frame) const noexcept
+	{
+		const auto found = std::find_if(checkpoints.begin(), checkpoints.end(), [frame](const auto& checkpoint) {
+			return checkpoint.frame == frame;
+			});
+		return found == checkpoints.end() ? nullptr : &*found;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "peak_envelope_generator.h"
+
+namespace luminance_limiter_sg
+{
+	// Copies of an envelope taken every interval frames, each followed by the peaks the
+	// envelope was fed up to the next one. A seek restores the copy at or before the
+	// frame and replays fewer than interval cached pairs, so it costs O(interval)
+	// whatever the position in the clip. The raw peaks measured on each frame are kept
+	// too, so that a copy can be checked against the frames as they are now before it
+	// is trusted. The storage of all capacity copies is allocated by the first record
+	// and reused from then on: the least recently used copy makes room for a new one.
+	class EnvelopeCheckpoints
+	{
+	public:
+		constexpr static inline int32_t default_interval = 32;
+		constexpr static inline size_t default_capacity = 128u;
+
+		explicit EnvelopeCheckpoints(const int32_t interval = default_interval, const size_t capacity = default_capacity) noexcept;
+
+		// Notes that envelope, in the state before frame, is about to be fed peaks for
+		// frame, whose image measured raw.
+		const void record(const int32_t frame, const std::array<double, 2>& raw, const std::array<double, 2>& peaks, const PeakEnvelopeGenerator& envelope);
+		// Puts envelope in its state before frame, or returns false when the checkpoint
+		// of frame or the peaks after it are missing.
+		const bool restore(const int32_t frame, PeakEnvelopeGenerator& envelope);
+		// False when the raw peaks recorded for frame differ from measured, compared in
+		// YC48 Y like PeakIndex; true when either is missing.
+		const bool agrees(const int32_t frame, const std::optional<std::array<double, 2>>& measured) const noexcept;
+		// First frame of the checkpoint frame is restored from.
+		const int32_t start_of(const int32_t frame) const noexcept;
+		// Forgets every checkpoint but keeps the storage; the envelope settings or its
+		// input changed.
+		const void clear() noexcept;
+
+		// Checkpoints held.
+		const size_t size() const noexcept;
+	private:
+		constexpr static inline int32_t unused = -1;
+
+		struct Fed
+		{
+			std::array<double, 2> raw;
+			std::array<double, 2> peaks;
+		};
+
+		struct Checkpoint
+		{
+			int32_t frame = unused;
+			uint64_t last_use = 0;
+			PeakEnvelopeGenerator envelope;
+			std::vector<Fed> fed;
+		};
+
+		int32_t interval;
+		size_t capacity;
+		uint64_t uses = 0;
+		std::vector<Checkpoint> checkpoints;
+
+		Checkpoint* find(const int32_t frame) noexcept;
+		const Checkpoint* find(const int32_t frame) const noexcept;
+	};
+}
\ No newline at end of file
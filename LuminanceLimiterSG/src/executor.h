@@ -0,0 +1,93 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#pragma once
+
+#include <atomic>
+#include <concepts>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace luminance_limiter_sg
+{
+	// Runs task(i) for every i in [0, count) and returns when all of them are done.
+	template<typename T>
+	concept Executor = requires (T & executor, const uint32_t count, void (*task)(uint32_t))
+	{
+		{ executor.parallel_for(count, task) };
+	};
+
+	class SerialExecutor
+	{
+	public:
+		template<typename F>
+		inline const void parallel_for(const uint32_t count, const F& task) const
+		{
+			for (auto i = 0u; i < count; ++i)
+			{
+				task(i);
+			}
+		}
+	};
+
+	// Portable std::thread pool. Every worker owns a contiguous range of task indices,
+	// takes work from its front and steals the back half of another range when idle.
+	class ThreadPool
+	{
+	public:
+		explicit ThreadPool(const uint32_t threads = std::thread::hardware_concurrency());
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		uint32_t concurrency() const noexcept;
+
+		template<typename F>
+		inline const void parallel_for(const uint32_t count, const F& task)
+		{
+			const auto invoke = [](const void* context, const uint32_t index) {
+				(*static_cast<const F*>(context))(index);
+				};
+			run(Job{ invoke, &task, count });
+		}
+	private:
+		struct Job
+		{
+			void (*invoke)(const void* context, const uint32_t index);
+			const void* context;
+			std::atomic<uint32_t> remaining;
+		};
+
+		struct Range
+		{
+			std::mutex mutex;
+			Job* job = nullptr;
+			uint32_t begin = 0;
+			uint32_t end = 0;
+		};
+
+		const void run(Job&& job);
+		const bool run_one(const size_t self);
+		const void work(const size_t self);
+
+		std::vector<std::unique_ptr<Range>> ranges;
+		std::vector<std::thread> workers;
+
+		std::mutex submit_mutex;
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::condition_variable done;
+		uint64_t generation = 0;
+		bool stopping = false;
+	};
+}
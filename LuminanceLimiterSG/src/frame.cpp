@@ -0,0 +1,225 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#include "frame.h"
+
+#include <bit>
+#include <cmath>
+
+#include "kernel.h"
+
+
+namespace luminance_limiter_sg
+{
+	Frame::Frame(AviUtl::PixelYC* pixels, uint32_t width, uint32_t height, uint32_t stride) noexcept
+		: pixels(pixels), width(width), height(height), stride(stride)
+	{
+	}
+
+	const uint32_t Frame::sampling_step(const StatisticsQuality quality) const noexcept
+	{
+		if (quality == StatisticsQuality::Exact || width * height <= draft_samples)
+		{
+			return 1u;
+		}
+		return static_cast<uint32_t>(std::sqrt(static_cast<double>(width) * height / draft_samples));
+	}
+
+	// Hash of the Y of every step-th pixel of the row-th sampled row. Four lanes keep
+	// the multiplies independent, and the splitmix64 finalizer lets rows be summed.
+	static inline const uint64_t hash_row(const AviUtl::PixelYC* line, const uint32_t width, const uint32_t row, const uint32_t step) noexcept
+	{
+		constexpr auto prime = uint64_t{ 1099511628211u };
+		auto lanes = std::array<uint64_t, 4>{ 14695981039346656037u, 0x9E3779B97F4A7C15u, 0xC2B2AE3D27D4EB4Fu, 0x165667B19E3779F9u };
+		auto x = 0u;
+		for (; x + 3u * step < width; x += 4u * step)
+		{
+			lanes[0] = (lanes[0] ^ static_cast<uint16_t>(line[x].y)) * prime;
+			lanes[1] = (lanes[1] ^ static_cast<uint16_t>(line[x + step].y)) * prime;
+			lanes[2] = (lanes[2] ^ static_cast<uint16_t>(line[x + 2u * step].y)) * prime;
+			lanes[3] = (lanes[3] ^ static_cast<uint16_t>(line[x + 3u * step].y)) * prime;
+		}
+		for (; x < width; x += step)
+		{
+			lanes[0] = (lanes[0] ^ static_cast<uint16_t>(line[x].y)) * prime;
+		}
+
+		auto hash = lanes[0] ^ std::rotl(lanes[1], 16) ^ std::rotl(lanes[2], 32) ^ std::rotl(lanes[3], 48) ^ row;
+		hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9u;
+		hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBu;
+		return hash ^ (hash >> 31);
+	}
+
+	const uint64_t Frame::hash(const uint32_t step) const noexcept
+	{
+		const auto partial = hash_rows(0u, sampled_rows(step), step);
+		return merge_hash(&partial, 1u);
+	}
+
+	const std::array<double, 2> Frame::peaks(const uint32_t step) const noexcept
+	{
+		if (width == 0 || height == 0)
+		{
+			return { 0.0, 0.0 };
+		}
+
+		const auto [top, bottom] = reduce_rows(0u, sampled_rows(step), step);
+		return { Luminance::normalize_y(top), Luminance::normalize_y(bottom) };
+	}
+
+	const std::array<double, 2> Frame::peaks(const Region& region, const uint32_t step) const noexcept
+	{
+		const auto& kernel = kernels();
+		int16_t top = INT16_MIN;
+		int16_t bottom = INT16_MAX;
+		const auto first_row = (region.top + step - 1u) / step * step;
+		const auto first_column = (region.left + step - 1u) / step * step;
+		for (auto row = first_row; row < region.bottom && row < height; row += step)
+		{
+			const auto line = pixels + row * stride;
+			if (step == 1u)
+			{
+				kernel.reduce_y(line + region.left, region.right - region.left, top, bottom);
+			}
+			else
+			{
+				for (auto x = first_column; x < region.right; x += step)
+				{
+					const auto y = (line + x)->y;
+					top = y > top ? y : top;
+					bottom = y < bottom ? y : bottom;
+				}
+			}
+		}
+		if (top < bottom)
+		{
+			return { 0.0, 0.0 };
+		}
+		return { Luminance::normalize_y(top), Luminance::normalize_y(bottom) };
+	}
+
+	const void Frame::histogram(Histogram& result, const uint32_t step) const noexcept
+	{
+		result.clear();
+		histogram_rows(result, 0u, sampled_rows(step), step);
+	}
+
+	const void Frame::apply(const TransferTable& table) noexcept
+	{
+		apply_rows(table, 0u, height);
+	}
+
+	const uint64_t Frame::apply_hashed(const TransferTable& table, const uint32_t step) noexcept
+	{
+		const auto partial = apply_hashed_rows(table, 0u, height, step);
+		return merge_hash(&partial, 1u);
+	}
+
+	const uint32_t Frame::sampled_rows(const uint32_t step) const noexcept
+	{
+		return (height + step - 1u) / step;
+	}
+
+	const uint32_t Frame::band_count(const uint32_t step) const noexcept
+	{
+		const auto rows = sampled_rows(step);
+		const auto columns = (width + step - 1u) / step;
+		if (columns == 0 || rows == 0 || columns * rows < parallel_threshold)
+		{
+			return 1u;
+		}
+		return rows < max_bands ? rows : max_bands;
+	}
+
+	const uint32_t Frame::band_begin(const uint32_t band, const uint32_t bands, const uint32_t rows) const noexcept
+	{
+		return static_cast<uint32_t>(static_cast<uint64_t>(rows) * band / bands);
+	}
+
+	// begin and end count sampled rows, so row r of the image is r * step.
+	const std::array<int16_t, 2> Frame::reduce_rows(const uint32_t begin, const uint32_t end, const uint32_t step) const noexcept
+	{
+		const auto& kernel = kernels();
+		int16_t top = INT16_MIN;
+		int16_t bottom = INT16_MAX;
+		for (auto row = begin; row < end; ++row)
+		{
+			const auto line = pixels + row * step * stride;
+			if (step == 1u)
+			{
+				kernel.reduce_y(line, width, top, bottom);
+			}
+			else
+			{
+				for (auto x = 0u; x < width; x += step)
+				{
+					const auto y = (line + x)->y;
+					top = y > top ? y : top;
+					bottom = y < bottom ? y : bottom;
+				}
+			}
+			if (top == INT16_MAX && bottom == INT16_MIN)
+			{
+				break;
+			}
+		}
+		return { top, bottom };
+	}
+
+	const void Frame::histogram_rows(Histogram& result, const uint32_t begin, const uint32_t end, const uint32_t step) const noexcept
+	{
+		for (auto row = begin; row < end; ++row)
+		{
+			result.add(pixels + row * step * stride, width, step);
+		}
+	}
+
+	const void Frame::apply_rows(const TransferTable& table, const uint32_t begin, const uint32_t end) noexcept
+	{
+		const auto& kernel = kernels();
+		for (auto y = begin; y < end; ++y)
+		{
+			kernel.apply_table_y(pixels + y * stride, width, table.data());
+		}
+	}
+	const uint64_t Frame::hash_rows(const uint32_t begin, const uint32_t end, const uint32_t step) const noexcept
+	{
+		auto hash = uint64_t{ 0 };
+		for (auto row = begin; row < end; ++row)
+		{
+			hash += hash_row(pixels + row * step * stride, width, row, step);
+		}
+		return hash;
+	}
+
+	// begin and end count image rows here; only every step-th one is hashed.
+	const uint64_t Frame::apply_hashed_rows(const TransferTable& table, const uint32_t begin, const uint32_t end, const uint32_t step) noexcept
+	{
+		const auto& kernel = kernels();
+		auto hash = uint64_t{ 0 };
+		for (auto y = begin; y < end; ++y)
+		{
+			kernel.apply_table_y(pixels + y * stride, width, table.data());
+			if (y % step == 0u)
+			{
+				hash += hash_row(pixels + y * stride, width, y / step, step);
+			}
+		}
+		return hash;
+	}
+
+	const uint64_t Frame::merge_hash(const uint64_t* partials, const uint32_t bands) const noexcept
+	{
+		auto hash = (static_cast<uint64_t>(width) << 32) | height;
+		for (auto band = 0u; band < bands; ++band)
+		{
+			hash += partials[band];
+		}
+		return hash;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,184 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "aviutl/filter.hpp"
+#include "executor.h"
+#include "histogram.h"
+#include "luminance.h"
+#include "processing_mode.h"
+#include "transfer_table.h"
+
+namespace luminance_limiter_sg
+{
+	// Pixels in [left, right) x [top, bottom) of a Frame.
+	struct Region
+	{
+		uint32_t left = 0;
+		uint32_t top = 0;
+		uint32_t right = 0;
+		uint32_t bottom = 0;
+	};
+
+	// View of the YC48 image AviUtl hands to func_proc, processed in place.
+	// Large frames are split into row bands that run on an Executor.
+	// Statistics can be taken on every step-th row and column for draft previews.
+	class Frame {
+	public:
+		constexpr static inline auto max_bands = 64u;
+		constexpr static inline auto parallel_threshold = 320u * 240u;
+		constexpr static inline auto max_histogram_bands = 16u;
+		constexpr static inline auto draft_samples = 480u * 270u;
+
+		Frame(AviUtl::PixelYC* pixels, uint32_t width, uint32_t height, uint32_t stride) noexcept;
+
+		const uint32_t sampling_step(const StatisticsQuality quality) const noexcept;
+		// Hash of Y over every pixel the statistics read at step, whatever the bands.
+		const uint64_t hash(const uint32_t step = 1u) const noexcept;
+
+		const std::array<double, 2> peaks(const uint32_t step = 1u) const noexcept;
+		// Peaks of the pixels of region on the step grid of the whole frame.
+		const std::array<double, 2> peaks(const Region& region, const uint32_t step = 1u) const noexcept;
+		const void histogram(Histogram& result, const uint32_t step = 1u) const noexcept;
+		const void apply(const TransferTable& table) noexcept;
+		// apply, returning the hash of the Y written, taken while each row is in cache.
+		const uint64_t apply_hashed(const TransferTable& table, const uint32_t step = 1u) noexcept;
+
+		template<Executor E>
+		inline const std::array<double, 2> peaks(E& executor, const uint32_t step = 1u) const
+		{
+			const auto bands = band_count(step);
+			if (bands <= 1u)
+			{
+				return peaks(step);
+			}
+
+			const auto rows = sampled_rows(step);
+			auto partials = std::array<std::array<int16_t, 2>, max_bands>();
+			executor.parallel_for(bands, [&](const uint32_t band) {
+				partials[band] = reduce_rows(band_begin(band, bands, rows), band_begin(band + 1u, bands, rows), step);
+				});
+
+			auto merged = partials[0];
+			for (auto band = 1u; band < bands; ++band)
+			{
+				merged[0] = partials[band][0] > merged[0] ? partials[band][0] : merged[0];
+				merged[1] = partials[band][1] < merged[1] ? partials[band][1] : merged[1];
+			}
+			return { Luminance::normalize_y(merged[0]), Luminance::normalize_y(merged[1]) };
+		}
+
+		// Each band fills its own sub-histogram; partials is kept by the caller so
+		// the bins are allocated once rather than per frame.
+		template<Executor E>
+		inline const void histogram(Histogram& result, std::vector<Histogram>& partials, E& executor, const uint32_t step = 1u) const
+		{
+			const auto bands = band_count(step) < max_histogram_bands ? band_count(step) : max_histogram_bands;
+			if (bands <= 1u)
+			{
+				return histogram(result, step);
+			}
+
+			if (partials.size() < bands)
+			{
+				partials.resize(bands);
+			}
+			const auto rows = sampled_rows(step);
+			executor.parallel_for(bands, [&](const uint32_t band) {
+				partials[band].clear();
+				histogram_rows(partials[band], band_begin(band, bands, rows), band_begin(band + 1u, bands, rows), step);
+				});
+
+			result.clear();
+			for (auto band = 0u; band < bands; ++band)
+			{
+				result.merge(partials[band]);
+			}
+		}
+
+		template<Executor E>
+		inline const uint64_t hash(E& executor, const uint32_t step = 1u) const
+		{
+			const auto bands = band_count(step);
+			if (bands <= 1u)
+			{
+				return hash(step);
+			}
+
+			const auto rows = sampled_rows(step);
+			auto partials = std::array<uint64_t, max_bands>();
+			executor.parallel_for(bands, [&](const uint32_t band) {
+				partials[band] = hash_rows(band_begin(band, bands, rows), band_begin(band + 1u, bands, rows), step);
+				});
+			return merge_hash(partials.data(), bands);
+		}
+
+		template<Executor E>
+		inline const uint64_t apply_hashed(const TransferTable& table, E& executor, const uint32_t step = 1u)
+		{
+			const auto bands = band_count(1u);
+			if (bands <= 1u)
+			{
+				return apply_hashed(table, step);
+			}
+
+			auto partials = std::array<uint64_t, max_bands>();
+			executor.parallel_for(bands, [&](const uint32_t band) {
+				partials[band] = apply_hashed_rows(table, band_begin(band, bands, height), band_begin(band + 1u, bands, height), step);
+				});
+			return merge_hash(partials.data(), bands);
+		}
+
+		template<Executor E>
+		inline const void apply(const TransferTable& table, E& executor)
+		{
+			const auto bands = band_count(1u);
+			if (bands <= 1u)
+			{
+				return apply(table);
+			}
+
+			executor.parallel_for(bands, [&](const uint32_t band) {
+				apply_rows(table, band_begin(band, bands, height), band_begin(band + 1u, bands, height));
+				});
+		}
+		// Calls f(line, width, row) on every row, in row bands on executor.
+		template<typename F, Executor E>
+		inline const void map_rows(const F& f, E& executor)
+		{
+			const auto bands = band_count(1u);
+			executor.parallel_for(bands, [&](const uint32_t band) {
+				for (auto row = band_begin(band, bands, height); row < band_begin(band + 1u, bands, height); ++row)
+				{
+					f(pixels + row * stride, width, row);
+				}
+				});
+		}
+	private:
+		AviUtl::PixelYC* pixels = nullptr;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t stride = 0;
+
+		const uint32_t sampled_rows(const uint32_t step) const noexcept;
+		const uint32_t band_count(const uint32_t step) const noexcept;
+		const uint32_t band_begin(const uint32_t band, const uint32_t bands, const uint32_t rows) const noexcept;
+		const std::array<int16_t, 2> reduce_rows(const uint32_t begin, const uint32_t end, const uint32_t step) const noexcept;
+		const void histogram_rows(Histogram& result, const uint32_t begin, const uint32_t end, const uint32_t step) const noexcept;
+		const void apply_rows(const TransferTable& table, const uint32_t begin, const uint32_t end) noexcept;
+		// Row hashes are summed, so bands can be hashed in any order and merged.
+		const uint64_t hash_rows(const uint32_t begin, const uint32_t end, const uint32_t step) const noexcept;
+		const uint64_t apply_hashed_rows(const TransferTable& table, const uint32_t begin, const uint32_t end, const uint32_t step) noexcept;
+		const uint64_t merge_hash(const uint64_t* partials, const uint32_t bands) const noexcept;
+	};
+}
@@ -0,0 +1,57 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <concepts>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace luminance_limiter_sg
+{
+	// Raw normalized { top, bottom } peaks of any frame, or nothing when the frame
+	// is out of range or cannot be read. PeakIndex is the file-backed source.
+	template<typename S>
+	concept FramePeakSource = requires (const S & source, const int32_t frame)
+	{
+		{ source.peaks(frame) } -> std::convertible_to<std::optional<std::array<double, 2>>>;
+	};
+
+	// Source of no frame at all.
+	class EmptyPeakSource
+	{
+	public:
+		inline const std::optional<std::array<double, 2>> peaks(const int32_t) const noexcept
+		{
+			return std::nullopt;
+		}
+	};
+
+	class MemoryPeakSource
+	{
+	public:
+		MemoryPeakSource(std::vector<std::array<double, 2>> peaks) noexcept
+			: frames(std::move(peaks))
+		{
+		}
+
+		inline const std::optional<std::array<double, 2>> peaks(const int32_t frame) const noexcept
+		{
+			if (frame < 0 || static_cast<size_t>(frame) >= frames.size())
+			{
+				return std::nullopt;
+			}
+			return frames[frame];
+		}
+	private:
+		std::vector<std::array<double, 2>> frames;
+	};
+}
@@ -0,0 +1,172 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#include "histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "luminance.h"
+
+
+namespace luminance_limiter_sg
+{
+	static inline const size_t bin_of(const int32_t y) noexcept
+	{
+		const auto clamped = y < Histogram::y_lower ? Histogram::y_lower : (y > Histogram::y_upper ? Histogram::y_upper : y);
+		return static_cast<size_t>(clamped - Histogram::y_lower);
+	}
+
+	Histogram::Histogram() noexcept
+	{
+		clear();
+	}
+
+	const void Histogram::clear() noexcept
+	{
+		bins.fill(0u);
+		count = 0;
+		top = INT16_MIN;
+		bottom = INT16_MAX;
+	}
+
+	const void Histogram::add(const AviUtl::PixelYC* row, uint32_t n, uint32_t step) noexcept
+	{
+		for (auto i = 0u; i < n; i += step)
+		{
+			const auto y = (row + i)->y;
+			bins[bin_of(y)]++;
+			top = y > top ? y : top;
+			bottom = y < bottom ? y : bottom;
+			count++;
+		}
+	}
+
+	const void Histogram::merge(const Histogram& other) noexcept
+	{
+		for (auto i = 0u; i < size; ++i)
+		{
+			bins[i] += other.bins[i];
+		}
+		count += other.count;
+		top = other.top > top ? other.top : top;
+		bottom = other.bottom < bottom ? other.bottom : bottom;
+	}
+
+	const void Histogram::transfer(const Histogram& source, const TransferTable& table) noexcept
+	{
+		clear();
+		if (source.count == 0)
+		{
+			return;
+		}
+
+		for (auto i = size_t{ 0 }; i < size; ++i)
+		{
+			if (source.bins[i] == 0)
+			{
+				continue;
+			}
+			const auto y = table[static_cast<int16_t>(static_cast<int32_t>(i) + y_lower)];
+			bins[bin_of(y)] += source.bins[i];
+			top = y > top ? y : top;
+			bottom = y < bottom ? y : bottom;
+		}
+		count = source.count;
+	}
+
+	const uint64_t Histogram::total() const noexcept
+	{
+		return count;
+	}
+
+	const int16_t Histogram::maximum() const noexcept
+	{
+		return top;
+	}
+
+	const int16_t Histogram::minimum() const noexcept
+	{
+		return bottom;
+	}
+
+	const int16_t Histogram::upper_percentile(const double exclusion) const noexcept
+	{
+		const auto excluded = static_cast<uint64_t>(std::floor(std::clamp(exclusion, 0.0, 1.0) * static_cast<double>(count)));
+		if (count == 0 || excluded == 0)
+		{
+			return top;
+		}
+
+		auto cumulative = uint64_t{ 0 };
+		for (auto i = size; i-- > 0;)
+		{
+			cumulative += bins[i];
+			if (cumulative > excluded)
+			{
+				return i == size - 1 ? top : static_cast<int16_t>(static_cast<int32_t>(i) + y_lower);
+			}
+		}
+		return bottom;
+	}
+
+	const int16_t Histogram::lower_percentile(const double exclusion) const noexcept
+	{
+		const auto excluded = static_cast<uint64_t>(std::floor(std::clamp(exclusion, 0.0, 1.0) * static_cast<double>(count)));
+		if (count == 0 || excluded == 0)
+		{
+			return bottom;
+		}
+
+		auto cumulative = uint64_t{ 0 };
+		for (auto i = size_t{ 0 }; i < size; ++i)
+		{
+			cumulative += bins[i];
+			if (cumulative > excluded)
+			{
+				return i == 0 ? bottom : static_cast<int16_t>(static_cast<int32_t>(i) + y_lower);
+			}
+		}
+		return top;
+	}
+
+	const std::array<double, 2> Histogram::peaks(const double exclusion) const noexcept
+	{
+		if (count == 0)
+		{
+			return { 0.0, 0.0 };
+		}
+		return { Luminance::normalize_y(upper_percentile(exclusion)), Luminance::normalize_y(lower_percentile(exclusion)) };
+	}
+
+	const double Histogram::modified(const TransferTable& table) const noexcept
+	{
+		if (count == 0)
+		{
+			return 0.0;
+		}
+
+		auto changed = uint64_t{ 0 };
+		for (auto i = size_t{ 0 }; i < size; ++i)
+		{
+			const auto y = static_cast<int16_t>(static_cast<int32_t>(i) + y_lower);
+			changed += table[y] != y ? bins[i] : 0u;
+		}
+		return static_cast<double>(changed) / static_cast<double>(count);
+	}
+
+	const uint32_t Histogram::operator[](const int16_t y) const noexcept
+	{
+		return bins[bin_of(y)];
+	}
+
+	const std::array<uint32_t, Histogram::size>& Histogram::counts() const noexcept
+	{
+		return bins;
+	}
+}
@@ -0,0 +1,56 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "aviutl/filter.hpp"
+#include "transfer_table.h"
+
+namespace luminance_limiter_sg
+{
+	// Luminance histogram with one bin per YC48 Y in the TransferTable span.
+	// Y outside the span is counted in the edge bins; the exact extremes are kept aside.
+	class Histogram {
+	public:
+		constexpr static inline auto y_lower = TransferTable::y_lower;
+		constexpr static inline auto y_upper = TransferTable::y_upper;
+		constexpr static inline auto size = TransferTable::size;
+
+		Histogram() noexcept;
+
+		const void clear() noexcept;
+		const void add(const AviUtl::PixelYC* row, uint32_t n, uint32_t step = 1u) noexcept;
+		const void merge(const Histogram& other) noexcept;
+		// The histogram source would have after every pixel went through table.
+		const void transfer(const Histogram& source, const TransferTable& table) noexcept;
+
+		const uint64_t total() const noexcept;
+		const int16_t maximum() const noexcept;
+		const int16_t minimum() const noexcept;
+		const int16_t upper_percentile(const double exclusion) const noexcept;
+		const int16_t lower_percentile(const double exclusion) const noexcept;
+
+		// Normalized { top, bottom } with at most exclusion of the pixels beyond each.
+		const std::array<double, 2> peaks(const double exclusion = 0.0) const noexcept;
+		// Fraction of the pixels counted whose Y table changes; Y outside the span is
+		// taken at its edge bin.
+		const double modified(const TransferTable& table) const noexcept;
+
+		const uint32_t operator[](const int16_t y) const noexcept;
+		const std::array<uint32_t, size>& counts() const noexcept;
+	private:
+		std::array<uint32_t, size> bins;
+		uint64_t count = 0;
+		int16_t top = INT16_MIN;
+		int16_t bottom = INT16_MAX;
+	};
+}
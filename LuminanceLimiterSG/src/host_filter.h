@@ -0,0 +1,56 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "aviutl/filter.hpp"
+#include "trackbar.h"
+
+
+namespace luminance_limiter_sg
+{
+	// FilterPlugin backed by its own trackbar and check box values, for running the
+	// filter outside AviUtl. Only the fields the core reads are filled in.
+	class HostFilter
+	{
+	public:
+		HostFilter() noexcept
+			: track(track_default), check(check_default), track_s_values(track_s), track_e_values(track_e)
+		{
+			fp.track_n = static_cast<int32_t>(track_n);
+			fp.track = track.data();
+			fp.track_s = track_s_values.data();
+			fp.track_e = track_e_values.data();
+			fp.check_n = static_cast<int32_t>(check_n);
+			fp.check = check.data();
+		}
+
+		HostFilter(const HostFilter&) = delete;
+		HostFilter& operator=(const HostFilter&) = delete;
+
+		inline AviUtl::FilterPlugin* plugin() noexcept
+		{
+			return &fp;
+		}
+
+		inline const AviUtl::FilterPlugin* plugin() const noexcept
+		{
+			return &fp;
+		}
+
+		std::array<int32_t, track_n> track;
+		std::array<int32_t, check_n> check;
+	private:
+		std::array<int32_t, track_n> track_s_values;
+		std::array<int32_t, track_n> track_e_values;
+		AviUtl::FilterPlugin fp{};
+	};
+}
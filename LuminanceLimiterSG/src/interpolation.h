@@ -1,239 +1,328 @@
-/*
-	Copyright(c) 2023 SoseiGocho
-	This Source Code Form is subject to the terms of the Mozilla Public License,
-	v. 2.0.If a copy of the MPL was not distributed with this file, You can
-	obtain one at https ://mozilla.org/MPL/2.0/.
-*/
-
-
-#pragma once
-
-#include <concepts>
-#include <optional>
-#include <stdexcept>
-#include <vector>
-
-namespace luminance_limiter_sg
-{
-	enum class InterpolationMode : int32_t
-	{
-		Linear,
-		Lagrange,
-		Spline
-	};
-
-	constexpr static inline auto binary_search(const std::vector<double>& xs, const double x) noexcept
-	{
-		auto left = -1;
-		auto right = xs.size() - 1;
-
-		while (right - left > 1)
-		{
-			const auto mid = left + (right - left) / 2;
-			if (xs[mid] > x)
-			{
-				right = mid;
-			}
-			else
-			{
-				left = mid;
-			}
-		}
-
-		return right;
-	}
-
-	const static inline std::regular_invocable<double> auto linear_interp(const std::vector<double>&& xs, const std::vector<double>&& ys)
-	{
-		if (xs.size() != ys.size())
-		{
-			throw std::runtime_error("Error: xs and ys must have the same size.");
-		}
-
-		if (xs.size() < 2)
-		{
-			throw std::runtime_error("Error: xs and ys must have at least 2 elements.");
-		}
-
-		auto n = xs.size();
-		std::vector<double> slopes(n - 1);
-		for (auto i = 0; i < n - 1; ++i)
-		{
-			slopes[i] = (ys[i + 1] - ys[i]) / (xs[i + 1] - xs[i]);
-		}
-
-		return [=](double x) -> double {
-			auto idx = binary_search(xs, x);
-			idx = idx >= xs.size() - 1 ? xs.size() - 2 : idx;
-			return ys[idx] + slopes[idx] * (x - xs[idx]);
-			};
-	};
-
-	const static inline std::regular_invocable<double> auto lagrange_interp(const std::vector<double>&& xs, const std::vector<double>&& ys)
-	{
-		if (xs.size() != ys.size())
-		{
-			throw std::runtime_error("Error: xs and ys must have the same size.");
-		}
-
-		if (xs.size() < 2)
-		{
-			throw std::runtime_error("Error: xs and ys must have at least 2 elements.");
-		}
-
-		return [=](double x) {
-			auto sum = 0.0;
-			for (auto i = 0; i < xs.size(); ++i)
-			{
-				auto prod = 1.0;
-				for (auto j = 0; j < xs.size(); ++j)
-				{
-					if (i != j)
-					{
-						prod *= (x - xs[j]) / (xs[i] - xs[j]);
-					}
-				}
-				sum += ys[i] * prod;
-			}
-			return sum;
-			};
-	}
-
-	constexpr static inline auto tdma(const std::vector<double>& a, const std::vector<double>& b, const std::vector<double>& c, const std::vector<double>& d)
-	{
-		auto n = a.size() - 1;
-		auto p = std::vector<double>(a.size());
-		auto q = std::vector<double>(a.size());
-
-		p[0] = -b[0] / a[0];
-		q[0] = d[0] / a[0];
-
-		for (auto i = 1; i < a.size(); i++)
-		{
-			p[i] = -b[i] / (a[i] + c[i] * p[i - 1]);
-			q[i] = (d[i] - c[i] * q[i - 1]) / (a[i] + c[i] * p[i - 1]);
-		}
-
-		auto x = std::vector<double>(a.size());
-		x[n] = q[n];
-		for (auto i = n - 1; i > -1; i--)
-		{
-			x[i] = p[i] * x[i + 1] + q[i];
-		}
-
-		return x;
-	}
-
-	const static inline std::regular_invocable<double> auto spline_interp(const std::vector<double>&& xs, const std::vector<double>&& ys)
-	{
-		if (xs.size() != ys.size())
-		{
-			throw std::runtime_error("Error: xs and ys must have the same size.");
-		}
-
-		if (xs.size() < 2)
-		{
-			throw std::runtime_error("Error: xs and ys must have at least 2 elements.");
-		}
-
-		const auto n = xs.size() - 1;
-
-		auto as = std::vector<double>(xs.size());
-		for (auto i = 0; i < xs.size(); i++)
-		{
-			as[i] = ys[i];
-		}
-
-		auto hs = std::vector<double>(n);
-		for (auto i = 0; i < n; i++)
-		{
-			hs[i] = xs[i + 1] - xs[i];
-		}
-
-		auto aas = std::vector<double>(xs.size());
-		for (auto i = 0; i < xs.size(); i++)
-		{
-			if (i == 0)
-			{
-				aas[i] = 1;
-			}
-			else if (i == n)
-			{
-				aas[i] = 0;
-			}
-			else
-			{
-				aas[i] = 2 * (hs[i - 1] + hs[i]);
-			}
-		}
-
-		auto abs = std::vector<double>(xs.size());
-		for (auto i = 0; i < xs.size(); i++)
-		{
-			if (i == 0)
-			{
-				abs[i] = 0;
-			}
-			else if (i == n)
-			{
-				abs[i] = 1;
-			}
-			else
-			{
-				abs[i] = hs[i];
-			}
-		}
-
-		auto acs = std::vector<double>(xs.size());
-		for (auto i = 0; i < xs.size(); i++)
-		{
-			if (i == 0)
-			{
-				acs[i] = 0;
-			}
-			else
-			{
-				acs[i] = hs[i - 1];
-			}
-		}
-
-		auto prod_b = std::vector<double>(xs.size());
-		for (auto i = 0; i < xs.size(); i++)
-		{
-			if (i == 0 || i == n)
-			{
-				prod_b[i] = 0;
-			}
-			else
-			{
-				prod_b[i] = 3 * ((as[i + 1] - as[i]) / hs[i] - (as[i] - as[i - 1]) / hs[i - 1]);
-			}
-		}
-
-		auto cs = tdma(aas, abs, acs, prod_b);
-
-		auto bs = std::vector<double>(xs.size());
-		auto ds = std::vector<double>(xs.size());
-		for (auto i = 0; i <= n; i++)
-		{
-			if (i == n)
-			{
-				bs[i] = 0.0;
-				ds[i] = 0.0;
-			}
-			else
-			{
-				bs[i] = (as[i + 1] - as[i]) / hs[i] - hs[i] * (cs[i + 1] + 2 * cs[i]) / 3;
-				ds[i] = (cs[i + 1] - cs[i]) / (3.0 * hs[i]);
-			}
-		}
-
-		return [=](double x) {
-			auto idx = binary_search(xs, x);
-			idx = idx >= xs.size() ? xs.size() - 1 : idx;
-			auto dt = x - xs[idx];
-			return as[idx] + (bs[idx] + (cs[idx] + ds[idx] * dt) * dt) * dt;
-			};
-	}
-
-}
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <variant>
+
+namespace luminance_limiter_sg
+{
+	enum class InterpolationMode : int32_t
+	{
+		Linear,
+		Lagrange,
+		Spline,
+		Monotone
+	};
+
+	template<size_t N>
+	using Knots = std::array<double, N>;
+
+	// Index of the first knot greater than x, or the last knot when there is none.
+	template<size_t N>
+	constexpr static inline size_t binary_search(const Knots<N>& xs, const double x) noexcept
+	{
+		auto left = -1;
+		auto right = static_cast<int32_t>(N) - 1;
+
+		while (right - left > 1)
+		{
+			const auto mid = left + (right - left) / 2;
+			if (xs[mid] > x)
+			{
+				right = mid;
+			}
+			else
+			{
+				left = mid;
+			}
+		}
+
+		return static_cast<size_t>(right);
+	}
+
+	template<size_t N>
+	class LinearCurve
+	{
+		static_assert(N >= 2, "Error: xs and ys must have at least 2 elements.");
+	public:
+		constexpr LinearCurve() noexcept = default;
+		constexpr LinearCurve(const Knots<N>& xs, const Knots<N>& ys) noexcept
+			: xs(xs), ys(ys)
+		{
+			for (auto i = size_t{ 0 }; i < N - 1; ++i)
+			{
+				slopes[i] = (ys[i + 1] - ys[i]) / (xs[i + 1] - xs[i]);
+			}
+		}
+
+		constexpr double operator()(const double x) const noexcept
+		{
+			auto idx = binary_search(xs, x);
+			idx = idx >= N - 1 ? N - 2 : idx;
+			return ys[idx] + slopes[idx] * (x - xs[idx]);
+		}
+	private:
+		Knots<N> xs{};
+		Knots<N> ys{};
+		Knots<N - 1> slopes{};
+	};
+
+	template<size_t N>
+	class LagrangeCurve
+	{
+		static_assert(N >= 2, "Error: xs and ys must have at least 2 elements.");
+	public:
+		constexpr LagrangeCurve() noexcept = default;
+		constexpr LagrangeCurve(const Knots<N>& xs, const Knots<N>& ys) noexcept
+			: xs(xs), ys(ys)
+		{
+		}
+
+		constexpr double operator()(const double x) const noexcept
+		{
+			auto sum = 0.0;
+			for (auto i = size_t{ 0 }; i < N; ++i)
+			{
+				auto prod = 1.0;
+				for (auto j = size_t{ 0 }; j < N; ++j)
+				{
+					if (i != j)
+					{
+						prod *= (x - xs[j]) / (xs[i] - xs[j]);
+					}
+				}
+				sum += ys[i] * prod;
+			}
+			return sum;
+		}
+	private:
+		Knots<N> xs{};
+		Knots<N> ys{};
+	};
+
+	// Forward sweep of the tridiagonal solve. Only the last unknown is kept: the back
+	// substitution of the original vector version never ran (its unsigned counter was
+	// compared against -1), and the shape of every existing spline depends on that.
+	template<size_t N>
+	constexpr static inline Knots<N> tdma(const Knots<N>& a, const Knots<N>& b, const Knots<N>& c, const Knots<N>& d) noexcept
+	{
+		auto p = Knots<N>{};
+		auto q = Knots<N>{};
+
+		p[0] = -b[0] / a[0];
+		q[0] = d[0] / a[0];
+
+		for (auto i = size_t{ 1 }; i < N; i++)
+		{
+			p[i] = -b[i] / (a[i] + c[i] * p[i - 1]);
+			q[i] = (d[i] - c[i] * q[i - 1]) / (a[i] + c[i] * p[i - 1]);
+		}
+
+		auto x = Knots<N>{};
+		x[N - 1] = q[N - 1];
+		return x;
+	}
+
+	template<size_t N>
+	class SplineCurve
+	{
+		static_assert(N >= 2, "Error: xs and ys must have at least 2 elements.");
+	public:
+		constexpr SplineCurve() noexcept = default;
+		constexpr SplineCurve(const Knots<N>& xs, const Knots<N>& ys) noexcept
+			: xs(xs), as(ys)
+		{
+			constexpr auto n = N - 1;
+
+			auto hs = Knots<n>{};
+			for (auto i = size_t{ 0 }; i < n; i++)
+			{
+				hs[i] = xs[i + 1] - xs[i];
+			}
+
+			auto aas = Knots<N>{};
+			auto abs = Knots<N>{};
+			auto acs = Knots<N>{};
+			auto prod_b = Knots<N>{};
+			for (auto i = size_t{ 0 }; i < N; i++)
+			{
+				aas[i] = i == 0 ? 1.0 : (i == n ? 0.0 : 2 * (hs[i - 1] + hs[i]));
+				abs[i] = i == 0 ? 0.0 : (i == n ? 1.0 : hs[i]);
+				acs[i] = i == 0 ? 0.0 : hs[i - 1];
+				prod_b[i] = (i == 0 || i == n) ? 0.0
+					: 3 * ((as[i + 1] - as[i]) / hs[i] - (as[i] - as[i - 1]) / hs[i - 1]);
+			}
+
+			cs = tdma(aas, abs, acs, prod_b);
+
+			for (auto i = size_t{ 0 }; i < n; i++)
+			{
+				bs[i] = (as[i + 1] - as[i]) / hs[i] - hs[i] * (cs[i + 1] + 2 * cs[i]) / 3;
+				ds[i] = (cs[i + 1] - cs[i]) / (3.0 * hs[i]);
+			}
+		}
+
+		constexpr double operator()(const double x) const noexcept
+		{
+			const auto idx = binary_search(xs, x);
+			const auto dt = x - xs[idx];
+			return as[idx] + (bs[idx] + (cs[idx] + ds[idx] * dt) * dt) * dt;
+		}
+	private:
+		Knots<N> xs{};
+		Knots<N> as{};
+		Knots<N> bs{};
+		Knots<N> cs{};
+		Knots<N> ds{};
+	};
+
+	// Knot slopes of the monotone (PCHIP) cubic of Fritsch and Carlson: zero where the
+	// data turns, the weighted harmonic mean of the neighbouring secants elsewhere, and
+	// the shape-preserving three-point estimate at both ends. xs must be increasing.
+	constexpr static inline void monotone_slopes(const std::span<const double> xs, const std::span<const double> ys, const std::span<double> slopes) noexcept
+	{
+		const auto n = xs.size();
+		const auto secant = [&](const size_t i) { return (ys[i + 1] - ys[i]) / (xs[i + 1] - xs[i]); };
+		if (n == 2)
+		{
+			slopes[0] = slopes[1] = secant(0);
+			return;
+		}
+
+		for (auto i = size_t{ 1 }; i < n - 1; ++i)
+		{
+			const auto h0 = xs[i] - xs[i - 1];
+			const auto h1 = xs[i + 1] - xs[i];
+			const auto s0 = secant(i - 1);
+			const auto s1 = secant(i);
+			if (s0 * s1 <= 0.0)
+			{
+				slopes[i] = 0.0;
+				continue;
+			}
+			const auto w0 = 2.0 * h1 + h0;
+			const auto w1 = h1 + 2.0 * h0;
+			slopes[i] = (w0 + w1) / (w0 / s0 + w1 / s1);
+		}
+
+		const auto edge = [](const double h0, const double h1, const double s0, const double s1) {
+			const auto d = ((2.0 * h0 + h1) * s0 - h0 * s1) / (h0 + h1);
+			if (d * s0 <= 0.0)
+			{
+				return 0.0;
+			}
+			if (s0 * s1 <= 0.0 && (d < 0.0 ? -d : d) > 3.0 * (s0 < 0.0 ? -s0 : s0))
+			{
+				return 3.0 * s0;
+			}
+			return d;
+			};
+		slopes[0] = edge(xs[1] - xs[0], xs[2] - xs[1], secant(0), secant(1));
+		slopes[n - 1] = edge(xs[n - 1] - xs[n - 2], xs[n - 2] - xs[n - 3], secant(n - 2), secant(n - 3));
+	}
+
+	// Coefficients { a, b, c, d } of a + (b + (c + d t) t) t, t = x - x0, for the cubic
+	// Hermite segment from (x0, y0) to (x1, y1) with slopes m0 and m1.
+	constexpr static inline std::array<double, 4> hermite_segment(const double x0, const double x1, const double y0, const double y1, const double m0, const double m1) noexcept
+	{
+		const auto h = x1 - x0;
+		const auto s = (y1 - y0) / h;
+		return { y0, m0, (3.0 * s - 2.0 * m0 - m1) / h, (m0 + m1 - 2.0 * s) / (h * h) };
+	}
+
+	template<size_t N>
+	class MonotoneCurve
+	{
+		static_assert(N >= 2, "Error: xs and ys must have at least 2 elements.");
+	public:
+		constexpr MonotoneCurve() noexcept = default;
+		constexpr MonotoneCurve(const Knots<N>& xs, const Knots<N>& ys) noexcept
+			: xs(xs)
+		{
+			auto slopes = Knots<N>{};
+			monotone_slopes(xs, ys, slopes);
+			for (auto i = size_t{ 0 }; i < N - 1; ++i)
+			{
+				segments[i] = hermite_segment(xs[i], xs[i + 1], ys[i], ys[i + 1], slopes[i], slopes[i + 1]);
+			}
+		}
+
+		constexpr double operator()(const double x) const noexcept
+		{
+			const auto idx = binary_search(xs, x);
+			const auto segment = idx == 0 ? size_t{ 0 } : idx - 1;
+			const auto& [a, b, c, d] = segments[segment];
+			const auto dt = x - xs[segment];
+			return a + (b + (c + d * dt) * dt) * dt;
+		}
+	private:
+		Knots<N> xs{};
+		std::array<std::array<double, 4>, N - 1> segments{};
+	};
+
+	template<InterpolationMode Mode, size_t N>
+	struct CurveOf;
+
+	template<size_t N>
+	struct CurveOf<InterpolationMode::Linear, N>
+	{
+		using type = LinearCurve<N>;
+	};
+
+	template<size_t N>
+	struct CurveOf<InterpolationMode::Lagrange, N>
+	{
+		using type = LagrangeCurve<N>;
+	};
+
+	template<size_t N>
+	struct CurveOf<InterpolationMode::Spline, N>
+	{
+		using type = SplineCurve<N>;
+	};
+
+	template<size_t N>
+	struct CurveOf<InterpolationMode::Monotone, N>
+	{
+		using type = MonotoneCurve<N>;
+	};
+
+	// Every curve a trackbar can select, by value. std::visit dispatches to the concrete type.
+	template<size_t N>
+	using Curve = std::variant<LinearCurve<N>, LagrangeCurve<N>, SplineCurve<N>, MonotoneCurve<N>>;
+
+	template<size_t N>
+	constexpr static inline Curve<N> make_curve(const InterpolationMode mode, const Knots<N>& xs, const Knots<N>& ys)
+	{
+		switch (mode)
+		{
+		case InterpolationMode::Linear:
+			return typename CurveOf<InterpolationMode::Linear, N>::type(xs, ys);
+		case InterpolationMode::Lagrange:
+			return typename CurveOf<InterpolationMode::Lagrange, N>::type(xs, ys);
+		case InterpolationMode::Spline:
+			return typename CurveOf<InterpolationMode::Spline, N>::type(xs, ys);
+		case InterpolationMode::Monotone:
+			return typename CurveOf<InterpolationMode::Monotone, N>::type(xs, ys);
+		default:
+			throw std::runtime_error("Error: Illegal interpolation mode.");
+		}
+	}
+
+	static_assert(std::regular_invocable<LinearCurve<4>, double>);
+	static_assert(std::regular_invocable<LagrangeCurve<4>, double>);
+	static_assert(std::regular_invocable<SplineCurve<4>, double>);
+	static_assert(std::regular_invocable<MonotoneCurve<4>, double>);
+}
\ No newline at end of file
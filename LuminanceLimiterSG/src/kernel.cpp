@@ -0,0 +1,123 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#include "kernel.h"
+
+#include <initializer_list>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+
+namespace luminance_limiter_sg
+{
+#if defined(_MSC_VER)
+	static inline const bool os_saves_state(const unsigned long long mask) noexcept
+	{
+		int info[4];
+		__cpuid(info, 1);
+		const auto osxsave = (info[2] & (1 << 27)) != 0;
+		return osxsave && (_xgetbv(0) & mask) == mask;
+	}
+
+	static inline const bool cpu_supports(const InstructionSet instruction_set) noexcept
+	{
+		int info[4];
+		__cpuid(info, 0);
+		const auto max_leaf = info[0];
+
+		__cpuid(info, 1);
+		const auto sse41 = (info[2] & (1 << 19)) != 0;
+
+		auto avx2 = false;
+		auto avx512 = false;
+		if (max_leaf >= 7)
+		{
+			__cpuidex(info, 7, 0);
+			avx2 = (info[1] & (1 << 5)) != 0;
+			avx512 = (info[1] & (1 << 16)) != 0 && (info[1] & (1 << 30)) != 0;
+		}
+
+		switch (instruction_set)
+		{
+		case InstructionSet::Scalar:
+			return true;
+		case InstructionSet::SSE41:
+			return sse41;
+		case InstructionSet::AVX2:
+			return sse41 && avx2 && os_saves_state(0x6);
+		case InstructionSet::AVX512:
+			return sse41 && avx2 && avx512 && os_saves_state(0xe6);
+		default:
+			return false;
+		}
+	}
+#else
+	static inline const bool cpu_supports(const InstructionSet instruction_set) noexcept
+	{
+		__builtin_cpu_init();
+		switch (instruction_set)
+		{
+		case InstructionSet::Scalar:
+			return true;
+		case InstructionSet::SSE41:
+			return __builtin_cpu_supports("sse4.1");
+		case InstructionSet::AVX2:
+			return __builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("avx2");
+		case InstructionSet::AVX512:
+			return __builtin_cpu_supports("avx2")
+				&& __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+		default:
+			return false;
+		}
+	}
+#endif
+
+	const bool is_supported(const InstructionSet instruction_set) noexcept
+	{
+		return cpu_supports(instruction_set);
+	}
+
+	const Kernels* kernels_for(const InstructionSet instruction_set) noexcept
+	{
+		if (!is_supported(instruction_set))
+		{
+			return nullptr;
+		}
+
+		switch (instruction_set)
+		{
+		case InstructionSet::Scalar:
+			return &scalar_kernels;
+		case InstructionSet::SSE41:
+			return &sse41_kernels;
+		case InstructionSet::AVX2:
+			return &avx2_kernels;
+		case InstructionSet::AVX512:
+			return &avx512_kernels;
+		default:
+			return nullptr;
+		}
+	}
+
+	const Kernels& kernels() noexcept
+	{
+		static const Kernels& selected = []() -> const Kernels& {
+			for (const auto instruction_set : { InstructionSet::AVX512, InstructionSet::AVX2, InstructionSet::SSE41 })
+			{
+				if (const auto candidate = kernels_for(instruction_set))
+				{
+					return *candidate;
+				}
+			}
+			return scalar_kernels;
+			}();
+		return selected;
+	}
+}
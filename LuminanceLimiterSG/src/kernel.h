@@ -0,0 +1,77 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+
+#include "aviutl/filter.hpp"
+
+#if defined(_MSC_VER)
+#define LUMINANCE_LIMITER_SG_TARGET(isa)
+#else
+#define LUMINANCE_LIMITER_SG_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+namespace luminance_limiter_sg
+{
+	enum class InstructionSet : int32_t
+	{
+		Scalar,
+		SSE41,
+		AVX2,
+		AVX512
+	};
+
+	// Row kernels over the AoS YC48 layout. Only PixelYC::y is read or written.
+	// table points at the TransferTable entry of TransferTable::y_lower.
+	// fetch/render move Y to and from a contiguous plane: f64 and f32 planes hold
+	// normalized Y, i16 planes hold YC48 Y as is.
+	// blend_tables_y takes two pair tables, each interleaving the entries of an upper
+	// and a lower table as { upper, lower } from TransferTable::y_lower on, and sets Y
+	// to their bilinear blend: vertical weighs the lower entries and weights[i] the
+	// right table, both out of blend_one.
+	struct Kernels
+	{
+		constexpr static inline int32_t blend_bits = 8;
+		constexpr static inline int32_t blend_one = 1 << blend_bits;
+
+		InstructionSet instruction_set;
+		void (*reduce_y)(const AviUtl::PixelYC* src, uint32_t n, int16_t& top, int16_t& bottom) noexcept;
+		void (*apply_table_y)(AviUtl::PixelYC* dst, uint32_t n, const int16_t* table) noexcept;
+		void (*fetch_y_f64)(const AviUtl::PixelYC* src, uint32_t n, double* dst) noexcept;
+		void (*render_y_f64)(AviUtl::PixelYC* dst, uint32_t n, const double* src) noexcept;
+		void (*fetch_y_f32)(const AviUtl::PixelYC* src, uint32_t n, float* dst) noexcept;
+		void (*render_y_f32)(AviUtl::PixelYC* dst, uint32_t n, const float* src) noexcept;
+		void (*fetch_y_i16)(const AviUtl::PixelYC* src, uint32_t n, int16_t* dst) noexcept;
+		void (*render_y_i16)(AviUtl::PixelYC* dst, uint32_t n, const int16_t* src) noexcept;
+		void (*blend_tables_y)(AviUtl::PixelYC* dst, uint32_t n, const int16_t* left, const int16_t* right, const int16_t* weights, int32_t vertical) noexcept;
+	};
+
+	namespace scalar
+	{
+		void reduce_y(const AviUtl::PixelYC* src, uint32_t n, int16_t& top, int16_t& bottom) noexcept;
+		void apply_table_y(AviUtl::PixelYC* dst, uint32_t n, const int16_t* table) noexcept;
+		void fetch_y_f64(const AviUtl::PixelYC* src, uint32_t n, double* dst) noexcept;
+		void render_y_f64(AviUtl::PixelYC* dst, uint32_t n, const double* src) noexcept;
+		void fetch_y_f32(const AviUtl::PixelYC* src, uint32_t n, float* dst) noexcept;
+		void render_y_f32(AviUtl::PixelYC* dst, uint32_t n, const float* src) noexcept;
+		void fetch_y_i16(const AviUtl::PixelYC* src, uint32_t n, int16_t* dst) noexcept;
+		void render_y_i16(AviUtl::PixelYC* dst, uint32_t n, const int16_t* src) noexcept;
+		void blend_tables_y(AviUtl::PixelYC* dst, uint32_t n, const int16_t* left, const int16_t* right, const int16_t* weights, int32_t vertical) noexcept;
+	}
+
+	extern const Kernels scalar_kernels;
+	extern const Kernels sse41_kernels;
+	extern const Kernels avx2_kernels;
+	extern const Kernels avx512_kernels;
+
+	const bool is_supported(const InstructionSet instruction_set) noexcept;
+	const Kernels* kernels_for(const InstructionSet instruction_set) noexcept;
+	const Kernels& kernels() noexcept;
+}
@@ -0,0 +1,272 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#include "kernel.h"
+
+#include <immintrin.h>
+
+#include "luminance.h"
+#include "transfer_table.h"
+
+#define TARGET LUMINANCE_LIMITER_SG_TARGET("avx2")
+
+
+namespace luminance_limiter_sg
+{
+	namespace avx2
+	{
+		// The reduction walks 16 pixels as 3 ymm registers; y sits in lanes i with
+		// i % 3 == 0, 2 and 1 respectively. The other kernels deinterleave 8 pixels
+		// with the SSE shuffles so the y values feed one 8-wide int32 gather.
+		constexpr static inline auto reduce_pixels_per_step = 16u;
+		constexpr static inline auto pixels_per_step = 8u;
+
+		TARGET static inline __m128i load_ys(const AviUtl::PixelYC* src, __m128i v[3]) noexcept
+		{
+			const auto p = reinterpret_cast<const __m128i*>(src);
+			v[0] = _mm_loadu_si128(p);
+			v[1] = _mm_loadu_si128(p + 1);
+			v[2] = _mm_loadu_si128(p + 2);
+
+			const auto y0 = _mm_shuffle_epi8(v[0], _mm_setr_epi8(0, 1, 6, 7, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+			const auto y1 = _mm_shuffle_epi8(v[1], _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 3, 8, 9, 14, 15, -1, -1, -1, -1));
+			const auto y2 = _mm_shuffle_epi8(v[2], _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 4, 5, 10, 11));
+			return _mm_or_si128(_mm_or_si128(y0, y1), y2);
+		}
+
+		TARGET static inline void store_ys(AviUtl::PixelYC* dst, const __m128i v[3], const __m128i ys) noexcept
+		{
+			const auto y0 = _mm_shuffle_epi8(ys, _mm_setr_epi8(0, 1, -1, -1, -1, -1, 2, 3, -1, -1, -1, -1, 4, 5, -1, -1));
+			const auto y1 = _mm_shuffle_epi8(ys, _mm_setr_epi8(-1, -1, 6, 7, -1, -1, -1, -1, 8, 9, -1, -1, -1, -1, 10, 11));
+			const auto y2 = _mm_shuffle_epi8(ys, _mm_setr_epi8(-1, -1, -1, -1, 12, 13, -1, -1, -1, -1, 14, 15, -1, -1, -1, -1));
+
+			const auto p = reinterpret_cast<__m128i*>(dst);
+			_mm_storeu_si128(p, _mm_blend_epi16(v[0], y0, 0x49));
+			_mm_storeu_si128(p + 1, _mm_blend_epi16(v[1], y1, 0x92));
+			_mm_storeu_si128(p + 2, _mm_blend_epi16(v[2], y2, 0x24));
+		}
+
+		TARGET static inline int16_t horizontal_max(const __m256i v) noexcept
+		{
+			auto m = _mm_max_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+			m = _mm_max_epi16(m, _mm_srli_si128(m, 8));
+			m = _mm_max_epi16(m, _mm_srli_si128(m, 4));
+			m = _mm_max_epi16(m, _mm_srli_si128(m, 2));
+			return static_cast<int16_t>(_mm_extract_epi16(m, 0));
+		}
+
+		TARGET static inline int16_t horizontal_min(const __m256i v) noexcept
+		{
+			auto m = _mm_min_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+			m = _mm_min_epi16(m, _mm_srli_si128(m, 8));
+			m = _mm_min_epi16(m, _mm_srli_si128(m, 4));
+			m = _mm_min_epi16(m, _mm_srli_si128(m, 2));
+			return static_cast<int16_t>(_mm_extract_epi16(m, 0));
+		}
+
+		TARGET static void reduce_y(const AviUtl::PixelYC* src, uint32_t n, int16_t& top, int16_t& bottom) noexcept
+		{
+			const auto mask0 = _mm256_setr_epi16(-1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1);
+			const auto mask1 = _mm256_setr_epi16(0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0);
+			const auto mask2 = _mm256_setr_epi16(0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0);
+			const auto lowest = _mm256_set1_epi16(INT16_MIN);
+			const auto highest = _mm256_set1_epi16(INT16_MAX);
+
+			auto tops = _mm256_set1_epi16(top);
+			auto bottoms = _mm256_set1_epi16(bottom);
+
+			auto i = 0u;
+			for (; i + reduce_pixels_per_step <= n; i += reduce_pixels_per_step)
+			{
+				const auto p = reinterpret_cast<const __m256i*>(src + i);
+				const auto v0 = _mm256_loadu_si256(p);
+				const auto v1 = _mm256_loadu_si256(p + 1);
+				const auto v2 = _mm256_loadu_si256(p + 2);
+
+				tops = _mm256_max_epi16(tops, _mm256_blendv_epi8(lowest, v0, mask0));
+				tops = _mm256_max_epi16(tops, _mm256_blendv_epi8(lowest, v1, mask1));
+				tops = _mm256_max_epi16(tops, _mm256_blendv_epi8(lowest, v2, mask2));
+				bottoms = _mm256_min_epi16(bottoms, _mm256_blendv_epi8(highest, v0, mask0));
+				bottoms = _mm256_min_epi16(bottoms, _mm256_blendv_epi8(highest, v1, mask1));
+				bottoms = _mm256_min_epi16(bottoms, _mm256_blendv_epi8(highest, v2, mask2));
+			}
+
+			top = horizontal_max(tops);
+			bottom = horizontal_min(bottoms);
+
+			scalar::reduce_y(src + i, n - i, top, bottom);
+		}
+
+		TARGET static void apply_table_y(AviUtl::PixelYC* dst, uint32_t n, const int16_t* table) noexcept
+		{
+			const auto lower = _mm_set1_epi16(static_cast<int16_t>(TransferTable::y_lower));
+			const auto upper = _mm_set1_epi16(static_cast<int16_t>(TransferTable::y_upper));
+			const auto base = reinterpret_cast<const int*>(table);
+
+			auto i = 0u;
+			for (; i + pixels_per_step <= n; i += pixels_per_step)
+			{
+				__m128i v[3];
+				const auto ys = load_ys(dst + i, v);
+				const auto indices = _mm256_cvtepi16_epi32(_mm_sub_epi16(_mm_min_epi16(_mm_max_epi16(ys, lower), upper), lower));
+
+				// Each dword gather reads the entry and its successor; keep the low half.
+				const auto gathered = _mm256_i32gather_epi32(base, indices, 2);
+				const auto entries = _mm256_srai_epi32(_mm256_slli_epi32(gathered, 16), 16);
+				const auto mapped = _mm_packs_epi32(_mm256_castsi256_si128(entries), _mm256_extracti128_si256(entries, 1));
+
+				store_ys(dst + i, v, mapped);
+			}
+
+			scalar::apply_table_y(dst + i, n - i, table);
+		}
+
+		TARGET static void fetch_y_f64(const AviUtl::PixelYC* src, uint32_t n, double* dst) noexcept
+		{
+			const auto scale = _mm256_set1_pd(1.0 / Luminance::y_max);
+
+			auto i = 0u;
+			for (; i + pixels_per_step <= n; i += pixels_per_step)
+			{
+				__m128i v[3];
+				const auto ys = _mm256_cvtepi16_epi32(load_ys(src + i, v));
+
+				_mm256_storeu_pd(dst + i, _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(ys)), scale));
+				_mm256_storeu_pd(dst + i + 4, _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(ys, 1)), scale));
+			}
+
+			scalar::fetch_y_f64(src + i, n - i, dst + i);
+		}
+
+		TARGET static inline __m128i quantize_quad(const double* src) noexcept
+		{
+			const auto denormalized = _mm256_mul_pd(_mm256_loadu_pd(src), _mm256_set1_pd(Luminance::y_max));
+			const auto clamped = _mm256_min_pd(
+				_mm256_max_pd(denormalized, _mm256_set1_pd(static_cast<double>(INT16_MIN))),
+				_mm256_set1_pd(static_cast<double>(INT16_MAX)));
+			return _mm256_cvttpd_epi32(clamped);
+		}
+
+		TARGET static void render_y_f64(AviUtl::PixelYC* dst, uint32_t n, const double* src) noexcept
+		{
+			auto i = 0u;
+			for (; i + pixels_per_step <= n; i += pixels_per_step)
+			{
+				__m128i v[3];
+				load_ys(dst + i, v);
+				store_ys(dst + i, v, _mm_packs_epi32(quantize_quad(src + i), quantize_quad(src + i + 4)));
+			}
+
+			scalar::render_y_f64(dst + i, n - i, src + i);
+		}
+
+		TARGET static void fetch_y_f32(const AviUtl::PixelYC* src, uint32_t n, float* dst) noexcept
+		{
+			const auto scale = _mm256_set1_ps(static_cast<float>(1.0 / Luminance::y_max));
+
+			auto i = 0u;
+			for (; i + pixels_per_step <= n; i += pixels_per_step)
+			{
+				__m128i v[3];
+				const auto ys = _mm256_cvtepi16_epi32(load_ys(src + i, v));
+				_mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(ys), scale));
+			}
+
+			scalar::fetch_y_f32(src + i, n - i, dst + i);
+		}
+
+		TARGET static void render_y_f32(AviUtl::PixelYC* dst, uint32_t n, const float* src) noexcept
+		{
+			const auto scale = _mm256_set1_ps(static_cast<float>(Luminance::y_max));
+			const auto lowest = _mm256_set1_ps(static_cast<float>(INT16_MIN));
+			const auto highest = _mm256_set1_ps(static_cast<float>(INT16_MAX));
+
+			auto i = 0u;
+			for (; i + pixels_per_step <= n; i += pixels_per_step)
+			{
+				__m128i v[3];
+				load_ys(dst + i, v);
+				const auto clamped = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i), scale), lowest), highest);
+				const auto quantized = _mm256_cvttps_epi32(clamped);
+				store_ys(dst + i, v, _mm_packs_epi32(_mm256_castsi256_si128(quantized), _mm256_extracti128_si256(quantized, 1)));
+			}
+
+			scalar::render_y_f32(dst + i, n - i, src + i);
+		}
+
+		TARGET static void fetch_y_i16(const AviUtl::PixelYC* src, uint32_t n, int16_t* dst) noexcept
+		{
+			auto i = 0u;
+			for (; i + pixels_per_step <= n; i += pixels_per_step)
+			{
+				__m128i v[3];
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), load_ys(src + i, v));
+			}
+
+			scalar::fetch_y_i16(src + i, n - i, dst + i);
+		}
+
+		TARGET static void render_y_i16(AviUtl::PixelYC* dst, uint32_t n, const int16_t* src) noexcept
+		{
+			auto i = 0u;
+			for (; i + pixels_per_step <= n; i += pixels_per_step)
+			{
+				__m128i v[3];
+				load_ys(dst + i, v);
+				store_ys(dst + i, v, _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+			}
+
+			scalar::render_y_i16(dst + i, n - i, src + i);
+		}
+
+		TARGET static void blend_tables_y(AviUtl::PixelYC* dst, uint32_t n, const int16_t* left, const int16_t* right, const int16_t* weights, int32_t vertical) noexcept
+		{
+			const auto lower = _mm_set1_epi16(static_cast<int16_t>(TransferTable::y_lower));
+			const auto upper = _mm_set1_epi16(static_cast<int16_t>(TransferTable::y_upper));
+			// One dword holds the { upper, lower } pair, so madd does the vertical blend.
+			const auto vertical_pair = _mm256_set1_epi32(static_cast<int32_t>(
+				static_cast<uint32_t>(vertical) << 16 | static_cast<uint32_t>(Kernels::blend_one - vertical)));
+			const auto round = _mm256_set1_epi32(1 << (2 * Kernels::blend_bits - 1));
+			const auto left_pairs = reinterpret_cast<const int*>(left);
+			const auto right_pairs = reinterpret_cast<const int*>(right);
+
+			auto i = 0u;
+			for (; i + pixels_per_step <= n; i += pixels_per_step)
+			{
+				__m128i v[3];
+				const auto ys = load_ys(dst + i, v);
+				const auto indices = _mm256_cvtepi16_epi32(_mm_sub_epi16(_mm_min_epi16(_mm_max_epi16(ys, lower), upper), lower));
+
+				const auto left_blend = _mm256_madd_epi16(_mm256_i32gather_epi32(left_pairs, indices, 4), vertical_pair);
+				const auto right_blend = _mm256_madd_epi16(_mm256_i32gather_epi32(right_pairs, indices, 4), vertical_pair);
+				const auto horizontal = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(weights + i)));
+				const auto blended = _mm256_add_epi32(
+					_mm256_slli_epi32(left_blend, Kernels::blend_bits),
+					_mm256_mullo_epi32(_mm256_sub_epi32(right_blend, left_blend), horizontal));
+				const auto mapped = _mm256_srai_epi32(_mm256_add_epi32(blended, round), 2 * Kernels::blend_bits);
+
+				store_ys(dst + i, v, _mm_packs_epi32(_mm256_castsi256_si128(mapped), _mm256_extracti128_si256(mapped, 1)));
+			}
+
+			scalar::blend_tables_y(dst + i, n - i, left, right, weights + i, vertical);
+		}
+	}
+
+	const Kernels avx2_kernels = {
+		InstructionSet::AVX2,
+		avx2::reduce_y,
+		avx2::apply_table_y,
+		avx2::fetch_y_f64,
+		avx2::render_y_f64,
+		avx2::fetch_y_f32,
+		avx2::render_y_f32,
+		avx2::fetch_y_i16,
+		avx2::render_y_i16,
+		avx2::blend_tables_y,
+	};
+}
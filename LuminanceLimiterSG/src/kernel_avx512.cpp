@@ -0,0 +1,258 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#include "kernel.h"
+
+#include <immintrin.h>
+
+#include "luminance.h"
+#include "transfer_table.h"
+
+#define TARGET LUMINANCE_LIMITER_SG_TARGET("avx512f,avx512bw")
+
+
+namespace luminance_limiter_sg
+{
+	namespace avx512
+	{
+		// The reduction walks 32 pixels as 3 zmm registers under y lane masks.
+		// The other kernels take 16 pixels (48 words) as one full and one half register.
+		constexpr static inline auto reduce_pixels_per_step = 32u;
+		constexpr static inline auto pixels_per_step = 16u;
+
+		constexpr static inline __mmask32 y_lanes0 = 0x49249249u;
+		constexpr static inline __mmask32 y_lanes1 = 0x92492492u;
+		constexpr static inline __mmask32 y_lanes2 = 0x24924924u;
+		constexpr static inline __mmask32 half = 0x0000ffffu;
+
+		TARGET static inline __m256i load_ys(const AviUtl::PixelYC* src, __m512i v[2]) noexcept
+		{
+			const auto p = reinterpret_cast<const int16_t*>(src);
+			v[0] = _mm512_loadu_si512(p);
+			v[1] = _mm512_maskz_loadu_epi16(half, p + 32);
+
+			const auto gather = _mm512_set_epi16(
+				0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+				45, 42, 39, 36, 33, 30, 27, 24, 21, 18, 15, 12, 9, 6, 3, 0);
+			return _mm512_castsi512_si256(_mm512_permutex2var_epi16(v[0], gather, v[1]));
+		}
+
+		TARGET static inline void store_ys(AviUtl::PixelYC* dst, const __m512i v[2], const __m256i ys) noexcept
+		{
+			const auto scatter0 = _mm512_set_epi16(
+				10, 10, 9, 9, 9, 8, 8, 8, 7, 7, 7, 6, 6, 6, 5, 5,
+				5, 4, 4, 4, 3, 3, 3, 2, 2, 2, 1, 1, 1, 0, 0, 0);
+			const auto scatter1 = _mm512_set_epi16(
+				0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+				15, 15, 15, 14, 14, 14, 13, 13, 13, 12, 12, 12, 11, 11, 11, 10);
+			const auto wide = _mm512_zextsi256_si512(ys);
+
+			const auto p = reinterpret_cast<int16_t*>(dst);
+			_mm512_storeu_si512(p, _mm512_mask_permutexvar_epi16(v[0], y_lanes0, scatter0, wide));
+			_mm512_mask_storeu_epi16(p + 32, half, _mm512_mask_permutexvar_epi16(v[1], y_lanes1 & half, scatter1, wide));
+		}
+
+		TARGET static void reduce_y(const AviUtl::PixelYC* src, uint32_t n, int16_t& top, int16_t& bottom) noexcept
+		{
+			auto tops = _mm512_set1_epi16(top);
+			auto bottoms = _mm512_set1_epi16(bottom);
+
+			auto i = 0u;
+			for (; i + reduce_pixels_per_step <= n; i += reduce_pixels_per_step)
+			{
+				const auto p = reinterpret_cast<const int16_t*>(src + i);
+				const auto v0 = _mm512_loadu_si512(p);
+				const auto v1 = _mm512_loadu_si512(p + 32);
+				const auto v2 = _mm512_loadu_si512(p + 64);
+
+				tops = _mm512_mask_max_epi16(tops, y_lanes0, tops, v0);
+				tops = _mm512_mask_max_epi16(tops, y_lanes1, tops, v1);
+				tops = _mm512_mask_max_epi16(tops, y_lanes2, tops, v2);
+				bottoms = _mm512_mask_min_epi16(bottoms, y_lanes0, bottoms, v0);
+				bottoms = _mm512_mask_min_epi16(bottoms, y_lanes1, bottoms, v1);
+				bottoms = _mm512_mask_min_epi16(bottoms, y_lanes2, bottoms, v2);
+			}
+
+			const auto max256 = _mm256_max_epi16(_mm512_castsi512_si256(tops), _mm512_extracti64x4_epi64(tops, 1));
+			const auto min256 = _mm256_min_epi16(_mm512_castsi512_si256(bottoms), _mm512_extracti64x4_epi64(bottoms, 1));
+			auto max128 = _mm_max_epi16(_mm256_castsi256_si128(max256), _mm256_extracti128_si256(max256, 1));
+			auto min128 = _mm_min_epi16(_mm256_castsi256_si128(min256), _mm256_extracti128_si256(min256, 1));
+			max128 = _mm_max_epi16(max128, _mm_srli_si128(max128, 8));
+			max128 = _mm_max_epi16(max128, _mm_srli_si128(max128, 4));
+			max128 = _mm_max_epi16(max128, _mm_srli_si128(max128, 2));
+			min128 = _mm_min_epi16(min128, _mm_srli_si128(min128, 8));
+			min128 = _mm_min_epi16(min128, _mm_srli_si128(min128, 4));
+			min128 = _mm_min_epi16(min128, _mm_srli_si128(min128, 2));
+			top = static_cast<int16_t>(_mm_extract_epi16(max128, 0));
+			bottom = static_cast<int16_t>(_mm_extract_epi16(min128, 0));
+
+			scalar::reduce_y(src + i, n - i, top, bottom);
+		}
+
+		TARGET static void apply_table_y(AviUtl::PixelYC* dst, uint32_t n, const int16_t* table) noexcept
+		{
+			const auto lower = _mm512_set1_epi32(TransferTable::y_lower);
+			const auto upper = _mm512_set1_epi32(TransferTable::y_upper);
+
+			auto i = 0u;
+			for (; i + pixels_per_step <= n; i += pixels_per_step)
+			{
+				__m512i v[2];
+				const auto ys = _mm512_cvtepi16_epi32(load_ys(dst + i, v));
+				const auto indices = _mm512_sub_epi32(_mm512_min_epi32(_mm512_max_epi32(ys, lower), upper), lower);
+
+				// Each dword gather reads the entry and its successor; truncation keeps the entry.
+				const auto gathered = _mm512_i32gather_epi32(indices, table, 2);
+				store_ys(dst + i, v, _mm512_cvtepi32_epi16(gathered));
+			}
+
+			scalar::apply_table_y(dst + i, n - i, table);
+		}
+
+		TARGET static void fetch_y_f64(const AviUtl::PixelYC* src, uint32_t n, double* dst) noexcept
+		{
+			const auto scale = _mm512_set1_pd(1.0 / Luminance::y_max);
+
+			auto i = 0u;
+			for (; i + pixels_per_step <= n; i += pixels_per_step)
+			{
+				__m512i v[2];
+				const auto ys = _mm512_cvtepi16_epi32(load_ys(src + i, v));
+
+				_mm512_storeu_pd(dst + i, _mm512_mul_pd(_mm512_cvtepi32_pd(_mm512_castsi512_si256(ys)), scale));
+				_mm512_storeu_pd(dst + i + 8, _mm512_mul_pd(_mm512_cvtepi32_pd(_mm512_extracti64x4_epi64(ys, 1)), scale));
+			}
+
+			scalar::fetch_y_f64(src + i, n - i, dst + i);
+		}
+
+		TARGET static inline __m256i quantize_octet(const double* src) noexcept
+		{
+			const auto denormalized = _mm512_mul_pd(_mm512_loadu_pd(src), _mm512_set1_pd(Luminance::y_max));
+			const auto clamped = _mm512_min_pd(
+				_mm512_max_pd(denormalized, _mm512_set1_pd(static_cast<double>(INT16_MIN))),
+				_mm512_set1_pd(static_cast<double>(INT16_MAX)));
+			return _mm512_cvttpd_epi32(clamped);
+		}
+
+		TARGET static void render_y_f64(AviUtl::PixelYC* dst, uint32_t n, const double* src) noexcept
+		{
+			auto i = 0u;
+			for (; i + pixels_per_step <= n; i += pixels_per_step)
+			{
+				__m512i v[2];
+				load_ys(dst + i, v);
+				const auto quantized = _mm512_inserti64x4(_mm512_castsi256_si512(quantize_octet(src + i)), quantize_octet(src + i + 8), 1);
+				store_ys(dst + i, v, _mm512_cvtsepi32_epi16(quantized));
+			}
+
+			scalar::render_y_f64(dst + i, n - i, src + i);
+		}
+
+		TARGET static void fetch_y_f32(const AviUtl::PixelYC* src, uint32_t n, float* dst) noexcept
+		{
+			const auto scale = _mm512_set1_ps(static_cast<float>(1.0 / Luminance::y_max));
+
+			auto i = 0u;
+			for (; i + pixels_per_step <= n; i += pixels_per_step)
+			{
+				__m512i v[2];
+				const auto ys = _mm512_cvtepi16_epi32(load_ys(src + i, v));
+				_mm512_storeu_ps(dst + i, _mm512_mul_ps(_mm512_cvtepi32_ps(ys), scale));
+			}
+
+			scalar::fetch_y_f32(src + i, n - i, dst + i);
+		}
+
+		TARGET static void render_y_f32(AviUtl::PixelYC* dst, uint32_t n, const float* src) noexcept
+		{
+			const auto scale = _mm512_set1_ps(static_cast<float>(Luminance::y_max));
+			const auto lowest = _mm512_set1_ps(static_cast<float>(INT16_MIN));
+			const auto highest = _mm512_set1_ps(static_cast<float>(INT16_MAX));
+
+			auto i = 0u;
+			for (; i + pixels_per_step <= n; i += pixels_per_step)
+			{
+				__m512i v[2];
+				load_ys(dst + i, v);
+				const auto clamped = _mm512_min_ps(_mm512_max_ps(_mm512_mul_ps(_mm512_loadu_ps(src + i), scale), lowest), highest);
+				store_ys(dst + i, v, _mm512_cvtsepi32_epi16(_mm512_cvttps_epi32(clamped)));
+			}
+
+			scalar::render_y_f32(dst + i, n - i, src + i);
+		}
+
+		TARGET static void fetch_y_i16(const AviUtl::PixelYC* src, uint32_t n, int16_t* dst) noexcept
+		{
+			auto i = 0u;
+			for (; i + pixels_per_step <= n; i += pixels_per_step)
+			{
+				__m512i v[2];
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), load_ys(src + i, v));
+			}
+
+			scalar::fetch_y_i16(src + i, n - i, dst + i);
+		}
+
+		TARGET static void render_y_i16(AviUtl::PixelYC* dst, uint32_t n, const int16_t* src) noexcept
+		{
+			auto i = 0u;
+			for (; i + pixels_per_step <= n; i += pixels_per_step)
+			{
+				__m512i v[2];
+				load_ys(dst + i, v);
+				store_ys(dst + i, v, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i)));
+			}
+
+			scalar::render_y_i16(dst + i, n - i, src + i);
+		}
+
+		TARGET static void blend_tables_y(AviUtl::PixelYC* dst, uint32_t n, const int16_t* left, const int16_t* right, const int16_t* weights, int32_t vertical) noexcept
+		{
+			const auto lower = _mm512_set1_epi32(TransferTable::y_lower);
+			const auto upper = _mm512_set1_epi32(TransferTable::y_upper);
+			// One dword holds the { upper, lower } pair, so madd does the vertical blend.
+			const auto vertical_pair = _mm512_set1_epi32(static_cast<int32_t>(
+				static_cast<uint32_t>(vertical) << 16 | static_cast<uint32_t>(Kernels::blend_one - vertical)));
+			const auto round = _mm512_set1_epi32(1 << (2 * Kernels::blend_bits - 1));
+
+			auto i = 0u;
+			for (; i + pixels_per_step <= n; i += pixels_per_step)
+			{
+				__m512i v[2];
+				const auto ys = _mm512_cvtepi16_epi32(load_ys(dst + i, v));
+				const auto indices = _mm512_sub_epi32(_mm512_min_epi32(_mm512_max_epi32(ys, lower), upper), lower);
+
+				const auto left_blend = _mm512_madd_epi16(_mm512_i32gather_epi32(indices, left, 4), vertical_pair);
+				const auto right_blend = _mm512_madd_epi16(_mm512_i32gather_epi32(indices, right, 4), vertical_pair);
+				const auto horizontal = _mm512_cvtepi16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights + i)));
+				const auto blended = _mm512_add_epi32(
+					_mm512_slli_epi32(left_blend, Kernels::blend_bits),
+					_mm512_mullo_epi32(_mm512_sub_epi32(right_blend, left_blend), horizontal));
+				const auto mapped = _mm512_srai_epi32(_mm512_add_epi32(blended, round), 2 * Kernels::blend_bits);
+
+				store_ys(dst + i, v, _mm512_cvtepi32_epi16(mapped));
+			}
+
+			scalar::blend_tables_y(dst + i, n - i, left, right, weights + i, vertical);
+		}
+	}
+
+	const Kernels avx512_kernels = {
+		InstructionSet::AVX512,
+		avx512::reduce_y,
+		avx512::apply_table_y,
+		avx512::fetch_y_f64,
+		avx512::render_y_f64,
+		avx512::fetch_y_f32,
+		avx512::render_y_f32,
+		avx512::fetch_y_i16,
+		avx512::render_y_i16,
+		avx512::blend_tables_y,
+	};
+}
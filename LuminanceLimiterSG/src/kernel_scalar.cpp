@@ -0,0 +1,121 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#include "kernel.h"
+
+#include "luminance.h"
+#include "transfer_table.h"
+
+
+namespace luminance_limiter_sg
+{
+	namespace scalar
+	{
+		void reduce_y(const AviUtl::PixelYC* src, uint32_t n, int16_t& top, int16_t& bottom) noexcept
+		{
+			auto current_top = top;
+			auto current_bottom = bottom;
+			for (auto i = 0u; i < n; ++i)
+			{
+				const auto y = (src + i)->y;
+				current_top = y > current_top ? y : current_top;
+				current_bottom = y < current_bottom ? y : current_bottom;
+			}
+			top = current_top;
+			bottom = current_bottom;
+		}
+
+		void apply_table_y(AviUtl::PixelYC* dst, uint32_t n, const int16_t* table) noexcept
+		{
+			for (auto i = 0u; i < n; ++i)
+			{
+				const int32_t y = (dst + i)->y;
+				const auto clamped = y < TransferTable::y_lower ? TransferTable::y_lower
+					: y > TransferTable::y_upper ? TransferTable::y_upper : y;
+				(dst + i)->y = table[clamped - TransferTable::y_lower];
+			}
+		}
+
+		void fetch_y_f64(const AviUtl::PixelYC* src, uint32_t n, double* dst) noexcept
+		{
+			for (auto i = 0u; i < n; ++i)
+			{
+				dst[i] = Luminance::normalize_y((src + i)->y);
+			}
+		}
+
+		void render_y_f64(AviUtl::PixelYC* dst, uint32_t n, const double* src) noexcept
+		{
+			for (auto i = 0u; i < n; ++i)
+			{
+				(dst + i)->y = Luminance::quantize_y(Luminance::denormalize_y(src[i]));
+			}
+		}
+
+		void fetch_y_f32(const AviUtl::PixelYC* src, uint32_t n, float* dst) noexcept
+		{
+			for (auto i = 0u; i < n; ++i)
+			{
+				dst[i] = static_cast<float>(Luminance::normalize_y((src + i)->y));
+			}
+		}
+
+		void render_y_f32(AviUtl::PixelYC* dst, uint32_t n, const float* src) noexcept
+		{
+			for (auto i = 0u; i < n; ++i)
+			{
+				(dst + i)->y = Luminance::quantize_y(Luminance::denormalize_y(static_cast<double>(src[i])));
+			}
+		}
+
+		void fetch_y_i16(const AviUtl::PixelYC* src, uint32_t n, int16_t* dst) noexcept
+		{
+			for (auto i = 0u; i < n; ++i)
+			{
+				dst[i] = (src + i)->y;
+			}
+		}
+
+		void render_y_i16(AviUtl::PixelYC* dst, uint32_t n, const int16_t* src) noexcept
+		{
+			for (auto i = 0u; i < n; ++i)
+			{
+				(dst + i)->y = src[i];
+			}
+		}
+
+		void blend_tables_y(AviUtl::PixelYC* dst, uint32_t n, const int16_t* left, const int16_t* right, const int16_t* weights, int32_t vertical) noexcept
+		{
+			const auto upper_weight = Kernels::blend_one - vertical;
+			for (auto i = 0u; i < n; ++i)
+			{
+				const int32_t y = (dst + i)->y;
+				const auto clamped = y < TransferTable::y_lower ? TransferTable::y_lower
+					: y > TransferTable::y_upper ? TransferTable::y_upper : y;
+				const auto entry = static_cast<size_t>(clamped - TransferTable::y_lower) * 2u;
+				const auto left_blend = left[entry] * upper_weight + left[entry + 1u] * vertical;
+				const auto right_blend = right[entry] * upper_weight + right[entry + 1u] * vertical;
+				const auto blended = left_blend * Kernels::blend_one + (right_blend - left_blend) * weights[i];
+				(dst + i)->y = static_cast<int16_t>((blended + (1 << (2 * Kernels::blend_bits - 1))) >> (2 * Kernels::blend_bits));
+			}
+		}
+	}
+
+	const Kernels scalar_kernels = {
+		InstructionSet::Scalar,
+		scalar::reduce_y,
+		scalar::apply_table_y,
+		scalar::fetch_y_f64,
+		scalar::render_y_f64,
+		scalar::fetch_y_f32,
+		scalar::render_y_f32,
+		scalar::fetch_y_i16,
+		scalar::render_y_i16,
+		scalar::blend_tables_y,
+	};
+}
@@ -0,0 +1,281 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#include "kernel.h"
+
+#include <immintrin.h>
+
+#include "luminance.h"
+#include "transfer_table.h"
+
+#define TARGET LUMINANCE_LIMITER_SG_TARGET("sse4.1")
+
+
+namespace luminance_limiter_sg
+{
+	namespace sse41
+	{
+		// 8 pixels are 3 registers; y sits in lanes {0,3,6}, {1,4,7} and {2,5}.
+		constexpr static inline auto pixels_per_step = 8u;
+
+		TARGET static inline __m128i load_ys(const AviUtl::PixelYC* src, __m128i v[3]) noexcept
+		{
+			const auto p = reinterpret_cast<const __m128i*>(src);
+			v[0] = _mm_loadu_si128(p);
+			v[1] = _mm_loadu_si128(p + 1);
+			v[2] = _mm_loadu_si128(p + 2);
+
+			const auto y0 = _mm_shuffle_epi8(v[0], _mm_setr_epi8(0, 1, 6, 7, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+			const auto y1 = _mm_shuffle_epi8(v[1], _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 3, 8, 9, 14, 15, -1, -1, -1, -1));
+			const auto y2 = _mm_shuffle_epi8(v[2], _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 4, 5, 10, 11));
+			return _mm_or_si128(_mm_or_si128(y0, y1), y2);
+		}
+
+		TARGET static inline void store_ys(AviUtl::PixelYC* dst, const __m128i v[3], const __m128i ys) noexcept
+		{
+			const auto y0 = _mm_shuffle_epi8(ys, _mm_setr_epi8(0, 1, -1, -1, -1, -1, 2, 3, -1, -1, -1, -1, 4, 5, -1, -1));
+			const auto y1 = _mm_shuffle_epi8(ys, _mm_setr_epi8(-1, -1, 6, 7, -1, -1, -1, -1, 8, 9, -1, -1, -1, -1, 10, 11));
+			const auto y2 = _mm_shuffle_epi8(ys, _mm_setr_epi8(-1, -1, -1, -1, 12, 13, -1, -1, -1, -1, 14, 15, -1, -1, -1, -1));
+
+			const auto p = reinterpret_cast<__m128i*>(dst);
+			_mm_storeu_si128(p, _mm_blend_epi16(v[0], y0, 0x49));
+			_mm_storeu_si128(p + 1, _mm_blend_epi16(v[1], y1, 0x92));
+			_mm_storeu_si128(p + 2, _mm_blend_epi16(v[2], y2, 0x24));
+		}
+
+		TARGET static inline __m128i clamped_indices(const __m128i ys) noexcept
+		{
+			const auto lower = _mm_set1_epi16(static_cast<int16_t>(TransferTable::y_lower));
+			const auto upper = _mm_set1_epi16(static_cast<int16_t>(TransferTable::y_upper));
+			return _mm_sub_epi16(_mm_min_epi16(_mm_max_epi16(ys, lower), upper), lower);
+		}
+
+		TARGET static void reduce_y(const AviUtl::PixelYC* src, uint32_t n, int16_t& top, int16_t& bottom) noexcept
+		{
+			auto tops = _mm_set1_epi16(top);
+			auto bottoms = _mm_set1_epi16(bottom);
+			const auto lowest = _mm_set1_epi16(INT16_MIN);
+			const auto highest = _mm_set1_epi16(INT16_MAX);
+
+			auto i = 0u;
+			for (; i + pixels_per_step <= n; i += pixels_per_step)
+			{
+				const auto p = reinterpret_cast<const __m128i*>(src + i);
+				const auto v0 = _mm_loadu_si128(p);
+				const auto v1 = _mm_loadu_si128(p + 1);
+				const auto v2 = _mm_loadu_si128(p + 2);
+
+				tops = _mm_max_epi16(tops, _mm_blend_epi16(lowest, v0, 0x49));
+				tops = _mm_max_epi16(tops, _mm_blend_epi16(lowest, v1, 0x92));
+				tops = _mm_max_epi16(tops, _mm_blend_epi16(lowest, v2, 0x24));
+				bottoms = _mm_min_epi16(bottoms, _mm_blend_epi16(highest, v0, 0x49));
+				bottoms = _mm_min_epi16(bottoms, _mm_blend_epi16(highest, v1, 0x92));
+				bottoms = _mm_min_epi16(bottoms, _mm_blend_epi16(highest, v2, 0x24));
+			}
+
+			tops = _mm_max_epi16(tops, _mm_srli_si128(tops, 8));
+			tops = _mm_max_epi16(tops, _mm_srli_si128(tops, 4));
+			tops = _mm_max_epi16(tops, _mm_srli_si128(tops, 2));
+			bottoms = _mm_min_epi16(bottoms, _mm_srli_si128(bottoms, 8));
+			bottoms = _mm_min_epi16(bottoms, _mm_srli_si128(bottoms, 4));
+			bottoms = _mm_min_epi16(bottoms, _mm_srli_si128(bottoms, 2));
+			top = static_cast<int16_t>(_mm_extract_epi16(tops, 0));
+			bottom = static_cast<int16_t>(_mm_extract_epi16(bottoms, 0));
+
+			scalar::reduce_y(src + i, n - i, top, bottom);
+		}
+
+		TARGET static void apply_table_y(AviUtl::PixelYC* dst, uint32_t n, const int16_t* table) noexcept
+		{
+			auto i = 0u;
+			for (; i + pixels_per_step <= n; i += pixels_per_step)
+			{
+				__m128i v[3];
+				const auto indices = clamped_indices(load_ys(dst + i, v));
+
+				// No gather before AVX2; the lookups stay scalar between the vector shuffles.
+				const auto mapped = _mm_setr_epi16(
+					table[static_cast<uint16_t>(_mm_extract_epi16(indices, 0))],
+					table[static_cast<uint16_t>(_mm_extract_epi16(indices, 1))],
+					table[static_cast<uint16_t>(_mm_extract_epi16(indices, 2))],
+					table[static_cast<uint16_t>(_mm_extract_epi16(indices, 3))],
+					table[static_cast<uint16_t>(_mm_extract_epi16(indices, 4))],
+					table[static_cast<uint16_t>(_mm_extract_epi16(indices, 5))],
+					table[static_cast<uint16_t>(_mm_extract_epi16(indices, 6))],
+					table[static_cast<uint16_t>(_mm_extract_epi16(indices, 7))]);
+
+				store_ys(dst + i, v, mapped);
+			}
+
+			scalar::apply_table_y(dst + i, n - i, table);
+		}
+
+		TARGET static void fetch_y_f64(const AviUtl::PixelYC* src, uint32_t n, double* dst) noexcept
+		{
+			const auto scale = _mm_set1_pd(1.0 / Luminance::y_max);
+
+			auto i = 0u;
+			for (; i + pixels_per_step <= n; i += pixels_per_step)
+			{
+				__m128i v[3];
+				const auto ys = load_ys(src + i, v);
+				const auto lo = _mm_cvtepi16_epi32(ys);
+				const auto hi = _mm_cvtepi16_epi32(_mm_srli_si128(ys, 8));
+
+				_mm_storeu_pd(dst + i, _mm_mul_pd(_mm_cvtepi32_pd(lo), scale));
+				_mm_storeu_pd(dst + i + 2, _mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(lo, 8)), scale));
+				_mm_storeu_pd(dst + i + 4, _mm_mul_pd(_mm_cvtepi32_pd(hi), scale));
+				_mm_storeu_pd(dst + i + 6, _mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(hi, 8)), scale));
+			}
+
+			scalar::fetch_y_f64(src + i, n - i, dst + i);
+		}
+
+		TARGET static inline __m128i quantize_pair(const double* src) noexcept
+		{
+			const auto denormalized = _mm_mul_pd(_mm_loadu_pd(src), _mm_set1_pd(Luminance::y_max));
+			const auto clamped = _mm_min_pd(
+				_mm_max_pd(denormalized, _mm_set1_pd(static_cast<double>(INT16_MIN))),
+				_mm_set1_pd(static_cast<double>(INT16_MAX)));
+			return _mm_cvttpd_epi32(clamped);
+		}
+
+		TARGET static inline __m128i quantize(const double* src) noexcept
+		{
+			const auto lo = _mm_unpacklo_epi64(quantize_pair(src), quantize_pair(src + 2));
+			const auto hi = _mm_unpacklo_epi64(quantize_pair(src + 4), quantize_pair(src + 6));
+			return _mm_packs_epi32(lo, hi);
+		}
+
+		TARGET static void render_y_f64(AviUtl::PixelYC* dst, uint32_t n, const double* src) noexcept
+		{
+			auto i = 0u;
+			for (; i + pixels_per_step <= n; i += pixels_per_step)
+			{
+				__m128i v[3];
+				load_ys(dst + i, v);
+				store_ys(dst + i, v, quantize(src + i));
+			}
+
+			scalar::render_y_f64(dst + i, n - i, src + i);
+		}
+
+		TARGET static void fetch_y_f32(const AviUtl::PixelYC* src, uint32_t n, float* dst) noexcept
+		{
+			const auto scale = _mm_set1_ps(static_cast<float>(1.0 / Luminance::y_max));
+
+			auto i = 0u;
+			for (; i + pixels_per_step <= n; i += pixels_per_step)
+			{
+				__m128i v[3];
+				const auto ys = load_ys(src + i, v);
+				_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepi16_epi32(ys)), scale));
+				_mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepi16_epi32(_mm_srli_si128(ys, 8))), scale));
+			}
+
+			scalar::fetch_y_f32(src + i, n - i, dst + i);
+		}
+
+		TARGET static inline __m128i quantize_quad(const float* src) noexcept
+		{
+			const auto denormalized = _mm_mul_ps(_mm_loadu_ps(src), _mm_set1_ps(static_cast<float>(Luminance::y_max)));
+			const auto clamped = _mm_min_ps(
+				_mm_max_ps(denormalized, _mm_set1_ps(static_cast<float>(INT16_MIN))),
+				_mm_set1_ps(static_cast<float>(INT16_MAX)));
+			return _mm_cvttps_epi32(clamped);
+		}
+
+		TARGET static void render_y_f32(AviUtl::PixelYC* dst, uint32_t n, const float* src) noexcept
+		{
+			auto i = 0u;
+			for (; i + pixels_per_step <= n; i += pixels_per_step)
+			{
+				__m128i v[3];
+				load_ys(dst + i, v);
+				store_ys(dst + i, v, _mm_packs_epi32(quantize_quad(src + i), quantize_quad(src + i + 4)));
+			}
+
+			scalar::render_y_f32(dst + i, n - i, src + i);
+		}
+
+		TARGET static void fetch_y_i16(const AviUtl::PixelYC* src, uint32_t n, int16_t* dst) noexcept
+		{
+			auto i = 0u;
+			for (; i + pixels_per_step <= n; i += pixels_per_step)
+			{
+				__m128i v[3];
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), load_ys(src + i, v));
+			}
+
+			scalar::fetch_y_i16(src + i, n - i, dst + i);
+		}
+
+		TARGET static void render_y_i16(AviUtl::PixelYC* dst, uint32_t n, const int16_t* src) noexcept
+		{
+			auto i = 0u;
+			for (; i + pixels_per_step <= n; i += pixels_per_step)
+			{
+				__m128i v[3];
+				load_ys(dst + i, v);
+				store_ys(dst + i, v, _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+			}
+
+			scalar::render_y_i16(dst + i, n - i, src + i);
+		}
+
+		TARGET static inline __m128i blend_quad(const int32_t* left, const int32_t* right, const __m128i indices, const __m128i vertical_pair, const __m128i weights) noexcept
+		{
+			const auto left_blend = _mm_madd_epi16(_mm_setr_epi32(
+				left[_mm_extract_epi32(indices, 0)], left[_mm_extract_epi32(indices, 1)],
+				left[_mm_extract_epi32(indices, 2)], left[_mm_extract_epi32(indices, 3)]), vertical_pair);
+			const auto right_blend = _mm_madd_epi16(_mm_setr_epi32(
+				right[_mm_extract_epi32(indices, 0)], right[_mm_extract_epi32(indices, 1)],
+				right[_mm_extract_epi32(indices, 2)], right[_mm_extract_epi32(indices, 3)]), vertical_pair);
+			const auto blended = _mm_add_epi32(
+				_mm_slli_epi32(left_blend, Kernels::blend_bits),
+				_mm_mullo_epi32(_mm_sub_epi32(right_blend, left_blend), weights));
+			return _mm_srai_epi32(_mm_add_epi32(blended, _mm_set1_epi32(1 << (2 * Kernels::blend_bits - 1))), 2 * Kernels::blend_bits);
+		}
+
+		TARGET static void blend_tables_y(AviUtl::PixelYC* dst, uint32_t n, const int16_t* left, const int16_t* right, const int16_t* weights, int32_t vertical) noexcept
+		{
+			// One dword holds the { upper, lower } pair, so madd does the vertical blend.
+			const auto vertical_pair = _mm_set1_epi32(static_cast<int32_t>(
+				static_cast<uint32_t>(vertical) << 16 | static_cast<uint32_t>(Kernels::blend_one - vertical)));
+			const auto left_pairs = reinterpret_cast<const int32_t*>(left);
+			const auto right_pairs = reinterpret_cast<const int32_t*>(right);
+
+			auto i = 0u;
+			for (; i + pixels_per_step <= n; i += pixels_per_step)
+			{
+				__m128i v[3];
+				const auto indices = clamped_indices(load_ys(dst + i, v));
+				const auto horizontal = _mm_loadu_si128(reinterpret_cast<const __m128i*>(weights + i));
+
+				const auto low = blend_quad(left_pairs, right_pairs, _mm_cvtepu16_epi32(indices), vertical_pair, _mm_cvtepi16_epi32(horizontal));
+				const auto high = blend_quad(left_pairs, right_pairs, _mm_cvtepu16_epi32(_mm_srli_si128(indices, 8)), vertical_pair, _mm_cvtepi16_epi32(_mm_srli_si128(horizontal, 8)));
+				store_ys(dst + i, v, _mm_packs_epi32(low, high));
+			}
+
+			scalar::blend_tables_y(dst + i, n - i, left, right, weights + i, vertical);
+		}
+	}
+
+	const Kernels sse41_kernels = {
+		InstructionSet::SSE41,
+		sse41::reduce_y,
+		sse41::apply_table_y,
+		sse41::fetch_y_f64,
+		sse41::render_y_f64,
+		sse41::fetch_y_f32,
+		sse41::render_y_f32,
+		sse41::fetch_y_i16,
+		sse41::render_y_i16,
+		sse41::blend_tables_y,
+	};
+}
@@ -0,0 +1,130 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#include "knot_curve.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+
+namespace luminance_limiter_sg
+{
+	// Second derivatives of the natural cubic spline, by the Thomas algorithm.
+	static const std::vector<double> natural_moments(const std::span<const double> xs, const std::span<const double> ys)
+	{
+		const auto n = xs.size();
+		auto moments = std::vector<double>(n, 0.0);
+		if (n < 3)
+		{
+			return moments;
+		}
+
+		auto rhs = std::vector<double>(n, 0.0);
+		auto upper = std::vector<double>(n, 0.0);
+		for (auto i = size_t{ 1 }; i < n - 1; ++i)
+		{
+			const auto h0 = xs[i] - xs[i - 1];
+			const auto h1 = xs[i + 1] - xs[i];
+			const auto lower = h0 / 6.0;
+			const auto d = (h0 + h1) / 3.0 - lower * upper[i - 1];
+			upper[i] = h1 / 6.0 / d;
+			rhs[i] = ((ys[i + 1] - ys[i]) / h1 - (ys[i] - ys[i - 1]) / h0 - lower * rhs[i - 1]) / d;
+		}
+		for (auto i = n - 2; i > 0; --i)
+		{
+			moments[i] = rhs[i] - upper[i] * moments[i + 1];
+		}
+		return moments;
+	}
+
+	KnotCurve::KnotCurve(const std::span<const double> xs, const std::span<const double> ys, const InterpolationMode mode)
+		: xs(xs.begin(), xs.end())
+	{
+		const auto n = xs.size();
+		if (n < 2 || ys.size() != n)
+		{
+			throw std::invalid_argument("Error: xs and ys must have the same size of at least 2.");
+		}
+		for (auto i = size_t{ 1 }; i < n; ++i)
+		{
+			if (!(xs[i] > xs[i - 1]))
+			{
+				throw std::invalid_argument("Error: xs must be strictly increasing.");
+			}
+		}
+
+		segments.resize(n - 1);
+		switch (mode)
+		{
+		case InterpolationMode::Linear:
+			for (auto i = size_t{ 0 }; i < n - 1; ++i)
+			{
+				segments[i] = { ys[i], (ys[i + 1] - ys[i]) / (xs[i + 1] - xs[i]), 0.0, 0.0 };
+			}
+			break;
+		case InterpolationMode::Spline:
+		{
+			const auto moments = natural_moments(xs, ys);
+			for (auto i = size_t{ 0 }; i < n - 1; ++i)
+			{
+				const auto h = xs[i + 1] - xs[i];
+				segments[i] = {
+					ys[i],
+					(ys[i + 1] - ys[i]) / h - h * (2.0 * moments[i] + moments[i + 1]) / 6.0,
+					moments[i] / 2.0,
+					(moments[i + 1] - moments[i]) / (6.0 * h) };
+			}
+			break;
+		}
+		case InterpolationMode::Monotone:
+		{
+			auto slopes = std::vector<double>(n);
+			monotone_slopes(xs, ys, slopes);
+			for (auto i = size_t{ 0 }; i < n - 1; ++i)
+			{
+				segments[i] = hermite_segment(xs[i], xs[i + 1], ys[i], ys[i + 1], slopes[i], slopes[i + 1]);
+			}
+			break;
+		}
+		default:
+			throw std::invalid_argument("Error: Illegal interpolation mode for a knot curve.");
+		}
+
+		const auto& last = segments.back();
+		const auto h = xs[n - 1] - xs[n - 2];
+		ends = { ys.front(), ys.back() };
+		end_slopes = { segments.front()[1], last[1] + (2.0 * last[2] + 3.0 * last[3] * h) * h };
+
+		auto spacing = xs[1] - xs[0];
+		for (auto i = size_t{ 2 }; i < n; ++i)
+		{
+			spacing = std::min(spacing, xs[i] - xs[i - 1]);
+		}
+		const auto range = xs.back() - xs.front();
+		const auto cells = static_cast<size_t>(std::min(std::ceil(range / spacing), static_cast<double>(max_grid_cells)));
+		grid.resize(cells + 1u);
+		cell_scale = static_cast<double>(cells) / range;
+		auto segment = size_t{ 0 };
+		for (auto cell = size_t{ 0 }; cell < cells; ++cell)
+		{
+			const auto start = xs.front() + static_cast<double>(cell) / cell_scale;
+			while (segment + 2u < n && xs[segment + 1u] <= start)
+			{
+				++segment;
+			}
+			grid[cell] = static_cast<uint32_t>(segment);
+		}
+		grid[cells] = static_cast<uint32_t>(n - 2u);
+	}
+
+	const size_t KnotCurve::knot_count() const noexcept
+	{
+		return xs.size();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,92 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "interpolation.h"
+
+namespace luminance_limiter_sg
+{
+	// Piecewise cubic through any number of user knots, for transfer curves drawn rather
+	// than derived from the trackbars. Every segment is kept as Horner coefficients. A
+	// uniform grid over the knot range records the segment at each cell start, with
+	// cells no wider than the closest pair of knots, so a lookup is one multiply and at
+	// most one step. Knots closer than max_grid_cells allow share cells, and a lookup in
+	// those cells binary searches the few segments they cover.
+	// Linear, Spline (natural cubic) and Monotone are supported; Lagrange is a single
+	// polynomial of the knot count's degree and is refused. Beyond the end knots the
+	// curve continues along the end slopes.
+	class KnotCurve
+	{
+	public:
+		// Bound on the grid, whatever the knot spacing.
+		constexpr static inline size_t max_grid_cells = size_t{ 1 } << 14;
+
+		// xs must be strictly increasing and hold at least two knots.
+		KnotCurve(const std::span<const double> xs, const std::span<const double> ys, const InterpolationMode mode);
+
+		inline double operator()(const double x) const noexcept
+		{
+			if (x <= xs.front())
+			{
+				return ends[0] + end_slopes[0] * (x - xs.front());
+			}
+			if (x >= xs.back())
+			{
+				return ends[1] + end_slopes[1] * (x - xs.back());
+			}
+			const auto segment = segment_of(x);
+			const auto& [a, b, c, d] = segments[segment];
+			const auto dt = x - xs[segment];
+			return a + (b + (c + d * dt) * dt) * dt;
+		}
+
+		// Index of the segment holding x, for x within the knot range.
+		inline size_t segment_of(const double x) const noexcept
+		{
+			const auto cell = std::min(static_cast<size_t>((x - xs.front()) * cell_scale), grid.size() - 2u);
+			const auto first = static_cast<size_t>(grid[cell]);
+			const auto last = static_cast<size_t>(grid[cell + 1u]);
+			auto segment = first;
+			if (last > first + 1u)
+			{
+				segment = static_cast<size_t>(std::upper_bound(xs.begin() + (first + 1u), xs.begin() + (last + 1u), x) - xs.begin()) - 1u;
+			}
+			// Rounding may put x in a cell next to its own.
+			while (segment > 0u && xs[segment] > x)
+			{
+				--segment;
+			}
+			while (segment + 2u < xs.size() && xs[segment + 1u] <= x)
+			{
+				++segment;
+			}
+			return segment;
+		}
+
+		const size_t knot_count() const noexcept;
+	private:
+		std::vector<double> xs;
+		std::vector<std::array<double, 4>> segments;
+		// Segment at the start of each cell, and the last segment after them.
+		std::vector<uint32_t> grid;
+		double cell_scale = 0.0;
+		std::array<double, 2> ends = { 0.0, 0.0 };
+		std::array<double, 2> end_slopes = { 0.0, 0.0 };
+	};
+
+	static_assert(std::regular_invocable<KnotCurve, double>);
+}
\ No newline at end of file
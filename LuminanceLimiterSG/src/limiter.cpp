@@ -1,153 +1,188 @@
-/*
-	Copyright(c) 2023 SoseiGocho
-	This Source Code Form is subject to the terms of the Mozilla Public License,
-	v. 2.0.If a copy of the MPL was not distributed with this file, You can
-	obtain one at https ://mozilla.org/MPL/2.0/.
-*/
-
-#include "limiter.h"
-
-#include <algorithm>
-#include <array>
-#include <stdexcept>
-
-#include "common_utility.h"
-#include "project_parameter.h"
-
-namespace luminance_limiter_sg
-{
-	const inline std::function<
-		std::function<double(double)>(
-			double, double,
-			double, double,
-			double, double)> select_character(InterpolationMode mode)
-	{
-		switch (mode)
-		{
-		case InterpolationMode::Linear:
-			return make_linear_character;
-		case InterpolationMode::Lagrange:
-			return make_lagrange_character;
-		case InterpolationMode::Spline:
-			return make_spline_character;
-		default:
-			throw std::runtime_error("Error: Illegal interpolation mode.");
-		}
-	}
-
-	Limiter::Limiter(const AviUtl::FilterPlugin* const fp)
-	{
-		const auto top_limit = Luminance::normalize_y(fp->track[1]);
-		const auto bottom_limit = Luminance::normalize_y(fp->track[4]);
-		peak_envelope_generator.set_limit(top_limit, bottom_limit);
-
-		if (!ProjectParameter::fps())
-		{
-			throw std::runtime_error("Fps has not initialized.");
-		}
-		const auto sustain = static_cast<uint32_t>(std::floor(static_cast<double>(fp->track[5]) * ProjectParameter::fps().value() / 1000.0));
-		peak_envelope_generator.set_sustain(sustain);
-
-		const auto release = std::ceil(static_cast<double>(fp->track[6]) * ProjectParameter::fps().value() / 1000.0);
-		peak_envelope_generator.set_release(release);
-	}
-
-	const std::function<double(double)> Limiter::effect() const noexcept
-	{
-		return [&](double y) -> double { return limit(y); };
-	}
-
-	const void Limiter::fetch_trackbar_and_buffer(const AviUtl::FilterPlugin* const fp, const Buffer& buffer)
-	{
-		const auto orig_top = buffer.maximum();
-		const auto orig_bottom = buffer.minimum();
-
-		const auto top_limit = Luminance::normalize_y(fp->track[1]);
-		const auto bottom_limit =Luminance::normalize_y(fp->track[4]);
-		
-		auto thresholds = std::array<double, 2>({ Luminance::normalize_y(fp->track[2]), Luminance::normalize_y(fp->track[3]) });
-		std::sort(thresholds.begin(), thresholds.end());
-
-		const auto [enveloped_top, enveloped_bottom] =
-			peak_envelope_generator.update_and_get_envelope_peaks(orig_top, orig_bottom);
-
-		const auto limit_character_interpolation_mode = static_cast<InterpolationMode>(fp->track[7]);
-		update_limiter(
-			top_limit, thresholds[1],
-			bottom_limit, thresholds[0],
-			enveloped_top, enveloped_bottom,
-			limit_character_interpolation_mode);
-	}
-
-	const void Limiter::update_from_trackbar(const AviUtl::FilterPlugin* const fp, const uint32_t track) noexcept
-	{
-		switch (track)
-		{
-		case 8U:
-		{
-			const auto sustain = static_cast<uint32_t>(std::floor(static_cast<double>(fp->track[5]) * ProjectParameter::fps().value() / 1000.0));
-			peak_envelope_generator.set_sustain(sustain);
-			break;
-		}
-		case 9U:
-		{
-			const auto release = std::ceil(static_cast<double>(fp->track[6]) * ProjectParameter::fps().value() / 1000.0);
-			peak_envelope_generator.set_release(release);
-			break;
-		}
-		case 13U:
-		{			
-			const auto top_limit = Luminance::normalize_y(fp->track[1]);
-			const auto bottom_limit = Luminance::normalize_y(fp->track[4]);
-			peak_envelope_generator.set_limit(top_limit, bottom_limit);
-			break;
-		}
-		case 14U:
-		{
-			const auto top_limit = Luminance::normalize_y(fp->track[1]);
-			const auto bottom_limit = Luminance::normalize_y(fp->track[4]);
-			peak_envelope_generator.set_limit(top_limit, bottom_limit);
-			break;
-		}
-		default:
-			break;
-		}
-	}
-
-	const void Limiter::used() noexcept
-	{
-		use = true;
-	}
-
-	const void Limiter::reset() noexcept
-	{
-		use = false;
-	}
-
-	const bool Limiter::is_using() const noexcept
-	{
-		return use;
-	}
-
-	BOOL Limiter::update_limiter(
-		const double top_limit, const double top_threshold,
-		const double bottom_limit, const double bottom_threshold,
-		const double top_peak, const double bottom_peak,
-		InterpolationMode mode)
-	{
-		this->limiter = make_limit(
-			make_character(
-				top_limit, top_threshold,
-				bottom_limit, bottom_threshold,
-				top_peak, bottom_peak,
-				select_character(mode)),
-			top_limit, bottom_limit);
-
-		return true;
-	}
-
-	double Limiter::limit(const double y) const
-	{
-		return this->limiter(y);
-	}
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+#include "limiter.h"
+
+#include <algorithm>
+#include <array>
+#include <variant>
+
+#include "common_utility.h"
+
+namespace luminance_limiter_sg
+{
+	Limiter::Limiter(const Parameters& parameters)
+	{
+		peak_envelope_generator.set_limit(parameters.top_limit, parameters.bottom_limit);
+		peak_envelope_generator.reserve(parameters.max_sustain);
+		peak_envelope_generator.set_sustain(parameters.sustain);
+		peak_envelope_generator.set_release(parameters.release);
+		look_ahead.set_limit(parameters.top_limit, parameters.bottom_limit);
+		look_ahead.set_window(parameters.look_ahead);
+		applied = parameters;
+	}
+
+	const TransferTable& Limiter::effect() const noexcept
+	{
+		return table;
+	}
+
+	const void Limiter::fetch_trackbar_and_peaks(const Parameters& parameters, const std::array<double, 2>& peaks)
+	{
+		configure(parameters);
+		raw = peaks;
+		const auto frame = next_frame++;
+
+		auto held = std::array<double, 2>();
+		auto enveloped = std::array<double, 2>();
+		{
+			LUMINANCE_LIMITER_SG_TIME_STAGE(Stage::Envelope);
+			const auto ahead = look_ahead.peaks(peaks);
+			checkpoints.record(frame, peaks, ahead, peak_envelope_generator);
+			held = peak_envelope_generator.hold_peaks(ahead[0], ahead[1]);
+			enveloped = peak_envelope_generator.wrap_peaks(held[0], held[1]);
+		}
+		const auto [enveloped_top, enveloped_bottom] = enveloped;
+
+		const auto key = limiter_key(parameters, enveloped_top, enveloped_bottom);
+		update_limiter(key, parameters.share_cache && shared_cache ? *shared_cache : own_cache);
+
+		if (TelemetryLog::global().enabled())
+		{
+			const auto [xs, ys] = make_some_charactors(
+				key.top_limit, key.top_threshold,
+				key.bottom_limit, key.bottom_threshold,
+				key.top_peak, key.bottom_peak);
+			record.frame = frame;
+			record.mode = key.mode;
+			record.raw = peaks;
+			record.held = held;
+			record.wrapped = enveloped;
+			record.xs = xs;
+			record.ys = ys;
+		}
+	}
+
+	const void Limiter::fetch_trackbar_and_histogram(const Parameters& parameters, const Histogram& histogram)
+	{
+		fetch_trackbar_and_peaks(parameters, peaks_of(parameters, histogram));
+	}
+
+	const std::array<double, 2> Limiter::peaks_of(const Parameters& parameters, const Histogram& histogram) const noexcept
+	{
+		return histogram.peaks(parameters.exclusion);
+	}
+
+	const std::array<double, 2>& Limiter::raw_peaks() const noexcept
+	{
+		return raw;
+	}
+
+	const FrameRecord& Limiter::last_record() const noexcept
+	{
+		return record;
+	}
+
+	const void Limiter::configure(const Parameters& parameters)
+	{
+		if (parameters.version == applied.version)
+		{
+			return;
+		}
+
+		// Checkpoints taken under another envelope would restore the wrong state.
+		if (!parameters.same_envelope(applied))
+		{
+			checkpoints.clear();
+		}
+		if (parameters.top_limit != applied.top_limit || parameters.bottom_limit != applied.bottom_limit)
+		{
+			peak_envelope_generator.set_limit(parameters.top_limit, parameters.bottom_limit);
+			look_ahead.set_limit(parameters.top_limit, parameters.bottom_limit);
+		}
+		if (parameters.sustain != applied.sustain)
+		{
+			peak_envelope_generator.set_sustain(parameters.sustain);
+		}
+		if (parameters.release != applied.release)
+		{
+			peak_envelope_generator.set_release(parameters.release);
+		}
+		look_ahead.set_window(parameters.look_ahead);
+		applied = parameters;
+	}
+
+	const void Limiter::rewind() noexcept
+	{
+		next_frame = -1;
+		look_ahead.reset();
+	}
+
+	const void Limiter::share(CurveCache* const cache) noexcept
+	{
+		shared_cache = cache;
+	}
+
+	const CurveCache& Limiter::curve_cache() const noexcept
+	{
+		return own_cache;
+	}
+
+	const void Limiter::used() noexcept
+	{
+		use = true;
+	}
+
+	const void Limiter::reset() noexcept
+	{
+		use = false;
+	}
+
+	const bool Limiter::is_using() const noexcept
+	{
+		return use;
+	}
+
+	BOOL Limiter::update_limiter(const CurveKey& key, CurveCache& cache)
+	{
+		cache.load(key, held, this->table, [&](TransferTable& table) {
+			LUMINANCE_LIMITER_SG_TIME_STAGE(Stage::Curve);
+			bake_limiter(table, key);
+			});
+
+		return true;
+	}
+
+	const CurveKey limiter_key(const Parameters& parameters, const double top_peak, const double bottom_peak) noexcept
+	{
+		return CurveKey{
+			parameters.top_limit, parameters.top_threshold,
+			parameters.bottom_limit, parameters.bottom_threshold,
+			quantize_peak(top_peak, parameters.quantization_step), quantize_peak(bottom_peak, parameters.quantization_step),
+			parameters.mode };
+	}
+
+	const void bake_limiter(TransferTable& table, const CurveKey& key, const size_t step)
+	{
+		const auto [xs, ys] = make_some_charactors(
+			key.top_limit, key.top_threshold,
+			key.bottom_limit, key.bottom_threshold,
+			key.top_peak, key.bottom_peak);
+		std::visit([&](const auto& character) {
+			if (step > 1u)
+			{
+				// Clamping after sampling keeps the kinks at the limits exact.
+				table.bake_sampled(character, step, xs);
+				table.clamp(key.bottom_limit, key.top_limit);
+			}
+			else
+			{
+				table.bake(make_limit(character, key.top_limit, key.bottom_limit));
+			}
+			}, make_curve(key.mode, xs, ys));
+	}
 }
\ No newline at end of file
@@ -1,142 +1,191 @@
-/*
-	Copyright(c) 2023 SoseiGocho
-	This Source Code Form is subject to the terms of the Mozilla Public License,
-	v. 2.0.If a copy of the MPL was not distributed with this file, You can
-	obtain one at https ://mozilla.org/MPL/2.0/.
-*/
-
-
-#pragma once
-
-#include "luminance_limiter_sg.h"
-
-#include <algorithm>
-#include <functional>
-
-#include "buffer.h"
-#include "interpolation.h"
-#include "luminance.h"
-#include "peak_envelope_generator.h"
-
-
-namespace luminance_limiter_sg {
-	template<typename F>
-	constexpr static inline auto make_some_charactors(
-		const double top_limit, const double top_threshold,
-		const double bottom_limit, const double bottom_threshold,
-		const double top_peak, const double bottom_peak,
-		const F&& interp_method)
-	{
-		const auto x0 = bottom_peak <= bottom_limit ? bottom_peak : bottom_limit;
-		const auto x3 = top_peak >= top_limit ? top_peak : top_limit;
-		auto xs = std::vector{ x0, bottom_threshold, top_threshold, x3};
-		std::sort(xs.begin(), xs.end());
-		auto ys = std::vector{ bottom_limit, bottom_threshold, top_threshold, top_limit };
-		std::sort(ys.begin(), ys.end());
-		return interp_method(std::move(xs), std::move(ys));
-	}
-
-	constexpr static inline auto make_linear_character = [](
-		const double top_limit, const double top_threshold,
-		const double bottom_limit, const double bottom_threshold,
-		const double top_peak, const double bottom_peak)
-		{
-			return make_some_charactors(
-				top_limit, top_threshold,
-				bottom_limit, bottom_threshold,
-				top_peak, bottom_peak,
-				linear_interp);
-		};
-
-	constexpr static inline auto make_lagrange_character = [](
-		const double top_limit, const double top_threshold,
-		const double bottom_limit, const double bottom_threshold,
-		const double top_peak, const double bottom_peak)
-		{
-			return make_some_charactors(
-				top_limit, top_threshold,
-				bottom_limit, bottom_threshold,
-				top_peak, bottom_peak,
-				lagrange_interp);
-		};
-
-	constexpr static inline auto make_spline_character = [](
-		const double top_limit, const double top_threshold,
-		const double bottom_limit, const double bottom_threshold,
-		const double top_peak, const double bottom_peak)
-		{
-			return make_some_charactors(
-				top_limit, top_threshold,
-				bottom_limit, bottom_threshold,
-				top_peak, bottom_peak,
-				spline_interp);
-		};
-
-	const static inline std::function<
-		std::function<double(double)>(
-			double, double,
-			double, double,
-			double, double)> select_character(InterpolationMode mode);
-
-	template<typename F>
-	const static inline std::function<double(double)> make_character(
-		const double top_limit, const double top_threshold,
-		const double bottom_limit, const double bottom_threshold,
-		const double top_peak, const double bottom_peak,
-		const F&& character)
-	{
-		return character(top_limit, top_threshold, bottom_limit, bottom_threshold, top_peak, bottom_peak);
-	}
-
-	template<typename F>
-	constexpr static inline auto make_limit(
-		const F&& character,
-		const double top_limit,
-		const double bottom_limit)
-	{
-		return [=, character = std::move(character)](const double y) -> double {
-			const auto charactered = character(y);
-			if (charactered > top_limit)
-			{
-				return top_limit;
-			}
-			else if (charactered < bottom_limit)
-			{
-				return bottom_limit;
-			}
-			else
-			{
-				return charactered;
-			}
-		};
-	}
-
-	class Limiter
-	{
-	public:
-		Limiter(const AviUtl::FilterPlugin* const fp);
-
-		const std::function<double(double)> effect() const noexcept;
-		const void fetch_trackbar_and_buffer(const AviUtl::FilterPlugin* const fp, const Buffer& buffer);
-		const void update_from_trackbar(const AviUtl::FilterPlugin* const fp, const uint32_t track) noexcept;
-
-		const void used() noexcept ;
-		const void reset() noexcept ;
-
-		const bool is_using() const noexcept ;
-	private:
-		bool use = false;
-
-		PeakEnvelopeGenerator peak_envelope_generator;
-
-		std::function<double(double)> limiter = id;
-
-		BOOL update_limiter(
-			const double top_limit, const double top_threshold,
-			const double bottom_limit, const double bottom_threshold,
-			const double top_peak, const double bottom_peak,
-			InterpolationMode mode);
-		double limit(const double y) const;
-
-	};
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#pragma once
+
+#include "luminance_limiter_sg.h"
+
+#include <algorithm>
+#include <array>
+#include <optional>
+
+#include "buffer.h"
+#include "curve_cache.h"
+#include "envelope_checkpoints.h"
+#include "frame_peak_source.h"
+#include "histogram.h"
+#include "interpolation.h"
+#include "look_ahead.h"
+#include "luminance.h"
+#include "parameters.h"
+#include "peak_envelope_generator.h"
+#include "stage_profile.h"
+#include "telemetry.h"
+#include "transfer_table.h"
+
+
+namespace luminance_limiter_sg {
+	// Knots of the limiter character: the peaks (or limits beyond them) map to the limits
+	// and the thresholds stay put.
+	constexpr static inline auto make_some_charactors(
+		const double top_limit, const double top_threshold,
+		const double bottom_limit, const double bottom_threshold,
+		const double top_peak, const double bottom_peak) noexcept
+	{
+		const auto x0 = bottom_peak <= bottom_limit ? bottom_peak : bottom_limit;
+		const auto x3 = top_peak >= top_limit ? top_peak : top_limit;
+		auto xs = Knots<4>{ x0, bottom_threshold, top_threshold, x3 };
+		std::sort(xs.begin(), xs.end());
+		auto ys = Knots<4>{ bottom_limit, bottom_threshold, top_threshold, top_limit };
+		std::sort(ys.begin(), ys.end());
+		return std::array<Knots<4>, 2>{ xs, ys };
+	}
+
+	template<typename F>
+	constexpr static inline auto make_limit(
+		const F& character,
+		const double top_limit,
+		const double bottom_limit) noexcept
+	{
+		return [=](const double y) -> double {
+			const auto charactered = character(y);
+			if (charactered > top_limit)
+			{
+				return top_limit;
+			}
+			else if (charactered < bottom_limit)
+			{
+				return bottom_limit;
+			}
+			else
+			{
+				return charactered;
+			}
+		};
+	}
+
+	// Curve inputs parameters give for the enveloped peaks.
+	const CurveKey limiter_key(const Parameters& parameters, const double top_peak, const double bottom_peak) noexcept;
+	// Bakes the limiter curve of key; step > 1 samples it with TransferTable::bake_sampled,
+	// breaking at the knots.
+	const void bake_limiter(TransferTable& table, const CurveKey& key, const size_t step = 1u);
+
+	// Every call takes the Parameters snapshot of the frame at hand; the envelope and
+	// the look-ahead pick up a new one when its version differs from the last seen.
+	class Limiter
+	{
+	public:
+		Limiter(const Parameters& parameters);
+
+		const TransferTable& effect() const noexcept;
+		template<typename T>
+		inline const void fetch_trackbar_and_buffer(const Parameters& parameters, const Buffer<T>& buffer)
+		{
+			auto peaks = std::array<double, 2>();
+			{
+				LUMINANCE_LIMITER_SG_TIME_STAGE(Stage::Reduce);
+				peaks = { buffer.maximum(), buffer.minimum() };
+			}
+			fetch_trackbar_and_peaks(parameters, peaks);
+		}
+		const void fetch_trackbar_and_peaks(const Parameters& parameters, const std::array<double, 2>& peaks);
+		const void fetch_trackbar_and_histogram(const Parameters& parameters, const Histogram& histogram);
+		const std::array<double, 2> peaks_of(const Parameters& parameters, const Histogram& histogram) const noexcept;
+		const std::array<double, 2>& raw_peaks() const noexcept;
+		// The envelope and knots of the last frame, kept only while TelemetryLog::global() is open.
+		const FrameRecord& last_record() const noexcept;
+
+		// Rebuilds the envelope for frame, whose image measured peaks, when frame does not
+		// follow the last one processed: from the nearest checkpoint when there is one, or
+		// else from the raw peaks of the frames before it. Frames the source cannot
+		// provide are skipped.
+		template<FramePeakSource S>
+		inline const void seek(const Parameters& parameters, const int32_t frame, const std::array<double, 2>& peaks, const S& source)
+		{
+			seek(parameters, frame, peaks, source, source);
+		}
+
+		// seek, with the look-ahead window of every frame replayed read from ahead.
+		template<FramePeakSource S, FramePeakSource A>
+		inline const void seek(const Parameters& parameters, const int32_t frame, const std::array<double, 2>& peaks, const S& source, const A& ahead)
+		{
+			if (frame == next_frame)
+			{
+				return;
+			}
+
+			configure(parameters);
+			if (checkpoints.restore(frame, peak_envelope_generator))
+			{
+				// The image may have changed upstream since the checkpoint was recorded: it
+				// must still agree with frame and with the frame its replay starts from.
+				const auto start = checkpoints.start_of(frame);
+				if (checkpoints.agrees(frame, peaks) && (start == frame || checkpoints.agrees(start, source.peaks(start))))
+				{
+					next_frame = frame;
+					return;
+				}
+				checkpoints.clear();
+			}
+
+			peak_envelope_generator.reset();
+			const auto history = static_cast<int32_t>(peak_envelope_generator.history());
+			for (auto past = frame > history ? frame - history : 0; past < frame; ++past)
+			{
+				if (const auto peaks = source.peaks(past))
+				{
+					look_ahead.advance(past, ahead);
+					const auto [top, bottom] = look_ahead.peaks(peaks.value());
+					peak_envelope_generator.update_and_get_envelope_peaks(top, bottom);
+				}
+			}
+			next_frame = frame;
+		}
+
+		// Reads the frames inside the look-ahead window of frame from source.
+		template<FramePeakSource S>
+		inline const void anticipate(const Parameters& parameters, const int32_t frame, const S& source)
+		{
+			configure(parameters);
+			look_ahead.advance(frame, source);
+		}
+
+		// The image changed upstream: the next seek rebuilds the envelope and the
+		// look-ahead window instead of going on from peaks measured before.
+		const void rewind() noexcept;
+
+		// Cache used instead of the slot's own one when the share check box is on.
+		const void share(CurveCache* const cache) noexcept;
+		const CurveCache& curve_cache() const noexcept;
+
+		const void used() noexcept ;
+		const void reset() noexcept ;
+
+		const bool is_using() const noexcept ;
+	private:
+		bool use = false;
+		int32_t next_frame = 0;
+		std::array<double, 2> raw = { 0.0, 0.0 };
+
+		PeakEnvelopeGenerator peak_envelope_generator;
+		LookAhead look_ahead;
+		EnvelopeCheckpoints checkpoints;
+		// The snapshot the envelope, the look-ahead and the checkpoints were set up for.
+		Parameters applied;
+		FrameRecord record;
+
+		TransferTable table;
+		std::optional<CurveKey> held = std::nullopt;
+		CurveCache own_cache;
+		CurveCache* shared_cache = nullptr;
+
+		BOOL update_limiter(const CurveKey& key, CurveCache& cache);
+		const void configure(const Parameters& parameters);
+
+	};
 }
\ No newline at end of file
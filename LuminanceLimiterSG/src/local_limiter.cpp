@@ -0,0 +1,243 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#include "local_limiter.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "kernel.h"
+#include "limiter.h"
+
+
+namespace luminance_limiter_sg
+{
+	LocalLimiter::LocalLimiter(const Parameters& parameters)
+		: max_sustain(parameters.max_sustain)
+	{
+	}
+
+	const bool LocalLimiter::is_local(const Parameters& parameters) noexcept
+	{
+		return parameters.grid[0] * parameters.grid[1] > 1u;
+	}
+
+	const void LocalLimiter::seek(const int32_t frame) noexcept
+	{
+		if (frame == next_frame)
+		{
+			return;
+		}
+		for (auto&& tile : tiles)
+		{
+			tile.envelope.reset();
+		}
+		next_frame = frame;
+	}
+
+	const std::array<uint32_t, 2> LocalLimiter::grid() const noexcept
+	{
+		return { columns, rows };
+	}
+
+	const TransferTable& LocalLimiter::effect(const uint32_t column, const uint32_t row) const noexcept
+	{
+		return tables[row * columns + column];
+	}
+
+	const std::array<double, 2>& LocalLimiter::raw_peaks(const uint32_t column, const uint32_t row) const noexcept
+	{
+		return tiles[row * columns + column].raw;
+	}
+
+	const void LocalLimiter::configure(const Parameters& parameters, const uint32_t width, const uint32_t height)
+	{
+		const auto [wanted_columns, wanted_rows] = parameters.grid;
+		const auto new_columns = std::min(wanted_columns, std::max(width, 1u));
+		const auto new_rows = std::min(wanted_rows, std::max(height, 1u));
+
+		const auto new_sustain = parameters.sustain;
+		const auto new_release = parameters.release;
+		const auto new_limits = std::array<double, 2>{ parameters.top_limit, parameters.bottom_limit };
+		const auto envelope_changed = new_sustain != sustain || new_release != release || new_limits != limits;
+		sustain = new_sustain;
+		release = new_release;
+		limits = new_limits;
+
+		if (new_columns == columns && new_rows == rows && width == this->width && height == this->height)
+		{
+			if (envelope_changed)
+			{
+				for (auto&& tile : tiles)
+				{
+					set_envelope(tile.envelope);
+				}
+			}
+			return;
+		}
+
+		columns = new_columns;
+		rows = new_rows;
+		this->width = width;
+		this->height = height;
+
+		tiles.resize(static_cast<size_t>(columns) * rows);
+		tables.resize(tiles.size());
+		for (auto row = 0u; row < rows; ++row)
+		{
+			for (auto column = 0u; column < columns; ++column)
+			{
+				auto& tile = tiles[row * columns + column];
+				tile.region = Region{
+					static_cast<uint32_t>(static_cast<uint64_t>(width) * column / columns),
+					static_cast<uint32_t>(static_cast<uint64_t>(height) * row / rows),
+					static_cast<uint32_t>(static_cast<uint64_t>(width) * (column + 1u) / columns),
+					static_cast<uint32_t>(static_cast<uint64_t>(height) * (row + 1u) / rows) };
+				tile.raw = { 0.0, 0.0 };
+				tile.held = std::nullopt;
+				set_envelope(tile.envelope);
+				tile.envelope.reset();
+			}
+		}
+		pair_rows = std::max(rows, 2u) - 1u;
+		pairs.assign(static_cast<size_t>(pair_rows) * columns * TransferTable::size * 2u, 0);
+
+		const auto column_blend = blend_of(columns, width);
+		spans.clear();
+		column_weights.resize(width);
+		for (auto x = 0u; x < width; ++x)
+		{
+			const auto& blend = column_blend[x];
+			if (spans.empty() || spans.back().left != blend.first || spans.back().right != blend.second)
+			{
+				spans.push_back(Span{ x, x, blend.first, blend.second });
+			}
+			spans.back().end = x + 1u;
+			column_weights[x] = static_cast<int16_t>(blend.weight);
+		}
+
+		// Rows outside the tile centers take the pair holding their tile with all weight on it.
+		row_pairs = blend_of(rows, height);
+		for (auto&& blend : row_pairs)
+		{
+			if (blend.first != blend.second || rows == 1u)
+			{
+				continue;
+			}
+			blend = blend.first == 0u
+				? Blend{ 0u, 1u, 0 }
+				: Blend{ static_cast<uint16_t>(rows - 2u), static_cast<uint16_t>(rows - 1u), Kernels::blend_one };
+		}
+	}
+
+	const void LocalLimiter::update_tile(const Parameters& parameters, const Frame& frame, const uint32_t index, const uint32_t step)
+	{
+		auto& tile = tiles[index];
+		{
+			LUMINANCE_LIMITER_SG_TIME_STAGE(Stage::Reduce);
+			tile.raw = frame.peaks(tile.region, step);
+		}
+
+		auto enveloped = std::array<double, 2>();
+		{
+			LUMINANCE_LIMITER_SG_TIME_STAGE(Stage::Envelope);
+			enveloped = tile.envelope.update_and_get_envelope_peaks(tile.raw[0], tile.raw[1]);
+		}
+
+		const auto key = limiter_key(parameters, enveloped[0], enveloped[1]);
+		if (tile.held != key)
+		{
+			LUMINANCE_LIMITER_SG_TIME_STAGE(Stage::Curve);
+			bake_limiter(tables[index], key, bake_step);
+			interleave(index);
+			tile.held = key;
+		}
+	}
+
+	const void LocalLimiter::apply_row(AviUtl::PixelYC* const line, const uint32_t width, const uint32_t row) const noexcept
+	{
+		const auto& kernel = kernels();
+		const auto& vertical = row_pairs[row];
+		for (const auto& span : spans)
+		{
+			kernel.blend_tables_y(line + span.begin, std::min(span.end, width) - span.begin,
+				pair_table(vertical.first, span.left), pair_table(vertical.first, span.right),
+				column_weights.data() + span.begin, vertical.weight);
+		}
+	}
+
+	const void LocalLimiter::set_envelope(PeakEnvelopeGenerator& envelope) const
+	{
+		envelope.set_limit(limits[0], limits[1]);
+		envelope.reserve(max_sustain);
+		envelope.set_sustain(sustain);
+		envelope.set_release(release);
+	}
+
+	// Tiles write disjoint halves of the pair tables, so they interleave in parallel.
+	const void LocalLimiter::interleave(const uint32_t index) noexcept
+	{
+		const auto row = index / columns;
+		const auto column = index % columns;
+		const auto* const table = tables[index].data();
+		for (auto pair_row = 0u; pair_row < pair_rows; ++pair_row)
+		{
+			auto* const pair = pair_table(pair_row, column);
+			if (pair_row == row)
+			{
+				for (auto i = size_t{ 0 }; i < TransferTable::size; ++i)
+				{
+					pair[i * 2u] = table[i];
+				}
+			}
+			if (std::min(pair_row + 1u, rows - 1u) == row)
+			{
+				for (auto i = size_t{ 0 }; i < TransferTable::size; ++i)
+				{
+					pair[i * 2u + 1u] = table[i];
+				}
+			}
+		}
+	}
+
+	int16_t* LocalLimiter::pair_table(const uint32_t pair_row, const uint32_t column) noexcept
+	{
+		return pairs.data() + (static_cast<size_t>(pair_row) * columns + column) * TransferTable::size * 2u;
+	}
+
+	const int16_t* LocalLimiter::pair_table(const uint32_t pair_row, const uint32_t column) const noexcept
+	{
+		return pairs.data() + (static_cast<size_t>(pair_row) * columns + column) * TransferTable::size * 2u;
+	}
+
+	// Pixels before the first tile center or past the last one take that tile alone.
+	const std::vector<LocalLimiter::Blend> LocalLimiter::blend_of(const uint32_t tiles, const uint32_t pixels)
+	{
+		auto result = std::vector<Blend>(pixels);
+		for (auto i = 0u; i < pixels; ++i)
+		{
+			const auto position = (static_cast<double>(i) + 0.5) * tiles / pixels - 0.5;
+			if (position <= 0.0)
+			{
+				result[i] = Blend{ 0u, 0u, 0 };
+			}
+			else if (position >= static_cast<double>(tiles - 1u))
+			{
+				result[i] = Blend{ static_cast<uint16_t>(tiles - 1u), static_cast<uint16_t>(tiles - 1u), 0 };
+			}
+			else
+			{
+				const auto first = static_cast<uint32_t>(position);
+				result[i] = Blend{
+					static_cast<uint16_t>(first), static_cast<uint16_t>(first + 1u),
+					static_cast<int32_t>(std::lround((position - first) * Kernels::blend_one)) };
+			}
+		}
+		return result;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,125 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "aviutl/filter.hpp"
+#include "curve_cache.h"
+#include "executor.h"
+#include "frame.h"
+#include "parameters.h"
+#include "peak_envelope_generator.h"
+#include "stage_profile.h"
+#include "transfer_table.h"
+
+
+namespace luminance_limiter_sg
+{
+	// Local mode: the frame is split into a grid of tiles that each keep their own
+	// peaks, envelope and limiter table, and every pixel takes the bilinear blend of
+	// the tables of the four tile centers around it, as in CLAHE. Tiles are measured
+	// and baked in parallel; the blend is one pass over the rows. Each table is also
+	// kept interleaved with the one below it, so one lookup reads both rows of tiles.
+	class LocalLimiter
+	{
+	public:
+		// Y codes between the knots tile tables are sampled on.
+		constexpr static inline size_t bake_step = 16u;
+
+		LocalLimiter(const Parameters& parameters);
+
+		static const bool is_local(const Parameters& parameters) noexcept;
+
+		// Forgets the envelopes when frame does not follow the last one processed.
+		const void seek(const int32_t frame) noexcept;
+
+		template<Executor E>
+		inline const void fetch_trackbar_and_frame(const Parameters& parameters, const Frame& frame, const uint32_t width, const uint32_t height, E& executor, const uint32_t step)
+		{
+			configure(parameters, width, height);
+			executor.parallel_for(static_cast<uint32_t>(tiles.size()), [&](const uint32_t index) {
+				update_tile(parameters, frame, index, step);
+				});
+			next_frame++;
+		}
+
+		template<Executor E>
+		inline const void apply(Frame& frame, E& executor) const
+		{
+			frame.map_rows([this](AviUtl::PixelYC* const line, const uint32_t width, const uint32_t row) {
+				apply_row(line, width, row);
+				}, executor);
+		}
+
+		const std::array<uint32_t, 2> grid() const noexcept;
+		const TransferTable& effect(const uint32_t column, const uint32_t row) const noexcept;
+		const std::array<double, 2>& raw_peaks(const uint32_t column, const uint32_t row) const noexcept;
+	private:
+		struct Tile
+		{
+			Region region;
+			std::array<double, 2> raw = { 0.0, 0.0 };
+			PeakEnvelopeGenerator envelope;
+			std::optional<CurveKey> held = std::nullopt;
+		};
+
+		// The two tiles whose centers surround a column or row, and the weight of the second.
+		struct Blend
+		{
+			uint16_t first = 0;
+			uint16_t second = 0;
+			int32_t weight = 0;
+		};
+
+		// Columns [begin, end) blended between the same two tile columns.
+		struct Span
+		{
+			uint32_t begin = 0;
+			uint32_t end = 0;
+			uint16_t left = 0;
+			uint16_t right = 0;
+		};
+
+		uint32_t columns = 0;
+		uint32_t rows = 0;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		int32_t next_frame = 0;
+
+		uint32_t max_sustain = 0;
+		uint32_t sustain = 0;
+		double release = 0.0;
+		std::array<double, 2> limits = { 0.0, 0.0 };
+
+		std::vector<Tile> tiles;
+		std::vector<TransferTable> tables;
+		// Pair tables of tile rows k and k + 1 (the last row with itself for one row of
+		// tiles), one per column, as blend_tables_y reads them.
+		uint32_t pair_rows = 0;
+		std::vector<int16_t> pairs;
+		std::vector<Span> spans;
+		std::vector<int16_t> column_weights;
+		// Pair row and the weight of its lower tile row, per image row.
+		std::vector<Blend> row_pairs;
+
+		const void configure(const Parameters& parameters, const uint32_t width, const uint32_t height);
+		const void update_tile(const Parameters& parameters, const Frame& frame, const uint32_t index, const uint32_t step);
+		const void apply_row(AviUtl::PixelYC* const line, const uint32_t width, const uint32_t row) const noexcept;
+		const void set_envelope(PeakEnvelopeGenerator& envelope) const;
+		const void interleave(const uint32_t index) noexcept;
+		int16_t* pair_table(const uint32_t pair_row, const uint32_t column) noexcept;
+		const int16_t* pair_table(const uint32_t pair_row, const uint32_t column) const noexcept;
+
+		static const std::vector<Blend> blend_of(const uint32_t tiles, const uint32_t pixels);
+	};
+}
\ No newline at end of file
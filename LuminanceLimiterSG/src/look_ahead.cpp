@@ -0,0 +1,97 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#include "look_ahead.h"
+
+
+namespace luminance_limiter_sg
+{
+	BOOL LookAhead::set_limit(const double top, const double bottom) noexcept
+	{
+		if (top_limit != top || bottom_limit != bottom)
+		{
+			primed = false;
+		}
+		top_limit = top;
+		bottom_limit = bottom;
+		return true;
+	}
+
+	BOOL LookAhead::set_window(const uint32_t frames)
+	{
+		if (this->frames == frames)
+		{
+			return true;
+		}
+
+		this->frames = frames;
+		tops.reserve(frames);
+		bottoms.reserve(frames);
+		primed = false;
+		return true;
+	}
+
+	const uint32_t LookAhead::window() const noexcept
+	{
+		return frames;
+	}
+
+	const void LookAhead::reset() noexcept
+	{
+		tops.clear();
+		bottoms.clear();
+		primed = false;
+	}
+
+	const std::array<double, 2> LookAhead::peaks(const std::array<double, 2>& current_peaks) const noexcept
+	{
+		auto [top, bottom] = current_peaks;
+		if (frames == 0u || !primed)
+		{
+			return { top, bottom };
+		}
+
+		const auto offset = slope() * current;
+		if (!tops.empty())
+		{
+			const auto ahead = tops.front().key + offset;
+			top = ahead > top ? ahead : top;
+		}
+		if (!bottoms.empty())
+		{
+			const auto ahead = bottoms.front().key - offset;
+			bottom = ahead < bottom ? ahead : bottom;
+		}
+		return { top, bottom };
+	}
+
+	const double LookAhead::slope() const noexcept
+	{
+		return (top_limit - bottom_limit) / static_cast<double>(frames + 1u);
+	}
+
+	const void LookAhead::push(const int32_t frame, const std::array<double, 2>& peaks) noexcept
+	{
+		const auto [top, bottom] = peaks;
+		const auto offset = slope() * frame;
+
+		const auto top_key = top - offset;
+		while (!tops.empty() && tops.back().key <= top_key)
+		{
+			tops.pop_back();
+		}
+		tops.push_back({ frame, top_key });
+
+		const auto bottom_key = bottom + offset;
+		while (!bottoms.empty() && bottoms.back().key >= bottom_key)
+		{
+			bottoms.pop_back();
+		}
+		bottoms.push_back({ frame, bottom_key });
+	}
+}
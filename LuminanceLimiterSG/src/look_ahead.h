@@ -0,0 +1,95 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#pragma once
+
+#include "luminance_limiter_sg.h"
+
+#include <array>
+#include <cstdint>
+
+#include "aviutl/filter.hpp"
+#include "frame_peak_source.h"
+#include "ring_buffer.h"
+
+namespace luminance_limiter_sg
+{
+	// Raises the top peak and lowers the bottom peak ahead of upcoming frames, so the
+	// envelope has already moved when a flash or a cut arrives. A peak k frames
+	// ahead counts as the peak less k steps of (top_limit - bottom_limit) / (window + 1).
+	// The upcoming frames sit in monotonic ring queues, so sliding by one frame reads
+	// one new frame from the source and costs O(1) amortized.
+	class LookAhead
+	{
+	public:
+		BOOL set_limit(const double top, const double bottom) noexcept;
+		BOOL set_window(const uint32_t frames);
+		const uint32_t window() const noexcept;
+
+		template<FramePeakSource S>
+		inline const void advance(const int32_t frame, const S& source)
+		{
+			if (frames == 0u)
+			{
+				return;
+			}
+
+			if (!primed || frame != current + 1)
+			{
+				tops.clear();
+				bottoms.clear();
+				filled = frame;
+				primed = true;
+			}
+			current = frame;
+
+			while (!tops.empty() && tops.front().frame <= frame)
+			{
+				tops.pop_front();
+			}
+			while (!bottoms.empty() && bottoms.front().frame <= frame)
+			{
+				bottoms.pop_front();
+			}
+
+			const auto last = frame + static_cast<int32_t>(frames);
+			while (filled < last)
+			{
+				filled++;
+				if (const auto peaks = source.peaks(filled))
+				{
+					push(filled, peaks.value());
+				}
+			}
+		}
+
+		// Forgets the window; the next advance reads it again.
+		const void reset() noexcept;
+
+		// Combines the peaks of the frame last advanced to with the ones ahead of it.
+		const std::array<double, 2> peaks(const std::array<double, 2>& current_peaks) const noexcept;
+	private:
+		struct Candidate
+		{
+			int32_t frame;
+			double key;
+		};
+
+		uint32_t frames = 0u;
+		double top_limit = 0.0;
+		double bottom_limit = 0.0;
+		bool primed = false;
+		int32_t current = 0;
+		int32_t filled = 0;
+		RingBuffer<Candidate> tops;
+		RingBuffer<Candidate> bottoms;
+
+		const double slope() const noexcept;
+		const void push(const int32_t frame, const std::array<double, 2>& peaks) noexcept;
+	};
+}
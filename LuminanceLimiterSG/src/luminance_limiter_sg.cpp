@@ -1,127 +1,156 @@
-/*
-	Copyright(c) 2023 SoseiGocho
-	This Source Code Form is subject to the terms of the Mozilla Public License,
-	v. 2.0.If a copy of the MPL was not distributed with this file, You can
-	obtain one at https ://mozilla.org/MPL/2.0/.
-*/
-
-
-//#include "luminance_limiter_sg.h"
-
-#include <array>
-#include <optional>
-
-#include "luminance.h"
-#include "project_parameter.h"
-#include "rack.h"
-
-
-namespace luminance_limiter_sg {
-	constexpr static inline auto name = "LuminanceLimiterSG";
-	
-	constexpr static inline auto track_n = 8u;
-	constexpr static inline auto track_name = std::array<const char*, track_n>
-	{
-		"ID",
-		"(L)", "臒l1", "臒l2", "(L)",
-		"S[ms]", "R[ms]",
-		"Ӱ"
-	};
-	constexpr static inline auto track_default = std::array<int32_t, track_n>
-	{
-		0,
-		4096,4095, 1, 0,
-		1, 0,
-		0
-	};
-	constexpr static inline auto track_s = std::array<int32_t, track_n>
-	{
-		0,
-		3, 2, 1, 0,
-		1, 0,
-		0
-	};
-	constexpr static inline auto track_e = std::array<int32_t, track_n>
-	{
-		num_or_racks,
-		4096, 4095, 4094, 4093,
-		4096, 4096,
-		2
-	};
-
-	constexpr static inline auto information = "LuminanceLimiterSG v0.2.0 by eޒ";
-
-	static Rack rack = Rack();
-	static std::optional<Buffer> processing_buffer = std::nullopt;
-
-	static inline BOOL func_proc(AviUtl::FilterPlugin* fp, AviUtl::FilterProcInfo* fpip)
-	{
-		if (!ProjectParameter::fps())
-		{
-			AviUtl::FileInfo fi;
-			fp->exfunc->get_file_info(fpip->editp, &fi);
-			ProjectParameter::fps() = static_cast<double>(fi.video_rate);
-		}
-
-		if (!processing_buffer)
-		{
-			processing_buffer = Buffer(fpip->max_w, fpip->max_h);
-		}
-
-		if (rack.is_first_time(static_cast<uint32_t>(fpip->frame)))
-		{
-			rack.gc();
-		}
-
-		auto effector_id = static_cast<unsigned int>(fp->track[0]);
-
-		if (!rack[effector_id])
-		{
-			rack.set_effector(effector_id, fp);
-		}
-
-		rack[effector_id]->used();
-
-		processing_buffer.value().fetch_image(fpip->w, fpip->h, static_cast<AviUtl::PixelYC*>(fpip->ycp_edit));
-
-		rack[effector_id]->fetch_trackbar_and_buffer(fp, processing_buffer.value());
-
-		processing_buffer.value().pixelwise_map(rack[effector_id]->effect());
-		processing_buffer.value().render(fpip->w, fpip->h, static_cast<AviUtl::PixelYC*>(fpip->ycp_edit));
-
-		return true;
-	} 
-
-	static inline BOOL func_update(AviUtl::FilterPlugin* fp, AviUtl::FilterPluginDLL::UpdateStatus status)
-	{
-		if (AviUtl::detail::FilterPluginUpdateStatus::Track <= status &&
-			status < AviUtl::detail::FilterPluginUpdateStatus::Check)
-		{
-			const auto track =
-				static_cast<std::underlying_type<AviUtl::FilterPluginDLL::UpdateStatus>::type>(status)
-				- static_cast<std::underlying_type<AviUtl::detail::FilterPluginUpdateStatus>::type>(AviUtl::detail::FilterPluginUpdateStatus::Track);
-
-			const auto effector_id = static_cast<uint32_t>(fp->track[0]);
-			rack[effector_id]->update_from_trackbar(fp, track);
-		}
-		return true;
-	}
-}
-
-
-constexpr AviUtl::FilterPluginDLL filter{
-	.flag = AviUtl::FilterPlugin::Flag::ExInformation,
-	.name = luminance_limiter_sg::name,
-	.track_n = luminance_limiter_sg::track_n,
-	.track_name = const_cast<const char**>(std::data(luminance_limiter_sg::track_name)),
-	.track_default = const_cast<int32_t*>(std::data(luminance_limiter_sg::track_default)),
-	.track_s = const_cast<int32_t*>(std::data(luminance_limiter_sg::track_s)),
-	.track_e = const_cast<int32_t*>(std::data(luminance_limiter_sg::track_e)),
-	.func_proc = &luminance_limiter_sg::func_proc,
-	.func_update = &luminance_limiter_sg::func_update,
-	.information = luminance_limiter_sg::information,
-};
-
-auto __stdcall GetFilterTable(void) {
-	return &filter;
-}
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+//#include "luminance_limiter_sg.h"
+
+#include <array>
+#include <cstdio>
+#include <filesystem>
+#include <optional>
+#include <string>
+
+#include "aviutl_executor.h"
+#include "aviutl_peak_source.h"
+#include "cache_directory.h"
+#include "peak_index.h"
+#include "processing_mode.h"
+#include "processor.h"
+#include "project_parameter.h"
+#include "stage_profile.h"
+#include "telemetry.h"
+#include "trackbar.h"
+
+
+namespace luminance_limiter_sg {
+	constexpr static inline auto name = "LuminanceLimiterSG";
+	
+	constexpr static inline auto track_name = std::array<const char*, track_n>
+	{
+		"ID",
+		"上限(L)", "閾値1", "閾値2", "下限(L)",
+		"S[ms]", "R[ms]",
+		"補間ﾓｰﾄﾞ",
+		"除外[.01%]",
+		"先読み[ms]",
+		"量子化[Y]",
+		"ﾀｲﾙ横", "ﾀｲﾙ縦"
+	};
+	constexpr static inline auto check_name = std::array<const char*, check_n>
+	{
+		"ﾊﾟｰｾﾝﾀｲﾙﾋﾟｰｸ",
+		"ｶｰﾌﾞｷｬｯｼｭ共有"
+	};
+	constexpr static inline auto information = "LuminanceLimiterSG v0.2.0 by 粗製伍長";
+
+	constexpr static inline auto processing_path = ProcessingPath::InPlace;
+
+	static Processor processor = Processor();
+
+	// What debug builds record about the source goes to the cache directory, named
+	// after the source and the hash of its path, never beside the user's media.
+	static inline const std::filesystem::path debug_output(const char* const extension)
+	{
+		const auto& source = ProjectParameter::source().value();
+		char hash[20] = {};
+		std::snprintf(hash, sizeof(hash), ".%016llx", static_cast<unsigned long long>(PeakIndex::source_hash(source)));
+		return cache_directory() / (std::filesystem::path(source).filename().string() + hash + extension);
+	}
+
+	// Whether fi names another source than the one the peaks so far were measured on.
+	static inline const bool is_new_source(const AviUtl::FileInfo& fi)
+	{
+		const auto& source = ProjectParameter::source();
+		return fi.name && *fi.name ? !source || source.value() != fi.name : source.has_value();
+	}
+
+	static inline BOOL func_proc(AviUtl::FilterPlugin* fp, AviUtl::FilterProcInfo* fpip)
+	{
+		// The project can be closed and another opened without unloading the plugin.
+		AviUtl::FileInfo fi;
+		fp->exfunc->get_file_info(fpip->editp, &fi);
+		if (!ProjectParameter::fps() || is_new_source(fi))
+		{
+			LUMINANCE_LIMITER_SG_TIME_STAGE(Stage::Init);
+			if (ProjectParameter::fps())
+			{
+				processor.change_source();
+			}
+			else
+			{
+				ProjectParameter::fps() = static_cast<double>(fi.video_rate);
+			}
+			ProjectParameter::source() = fi.name && *fi.name ? std::optional<std::string>(fi.name) : std::nullopt;
+#if defined(LUMINANCE_LIMITER_SG_TELEMETRY)
+			TelemetryLog::global().close();
+			if (ProjectParameter::source() && !cache_directory().empty())
+			{
+				TelemetryLog::global().open(debug_output(".llsgtelemetry"), TelemetryFormat::Binary);
+			}
+#endif
+		}
+
+		auto executor = AviUtlExecutor(fp->exfunc);
+		const auto request = FrameRequest{
+			static_cast<AviUtl::PixelYC*>(fpip->ycp_edit),
+			static_cast<uint32_t>(fpip->w), static_cast<uint32_t>(fpip->h),
+			static_cast<uint32_t>(fpip->max_w), static_cast<uint32_t>(fpip->max_h),
+			fpip->frame, fpip->frame_n,
+			fp->exfunc->is_saving(fpip->editp) ? StatisticsQuality::Exact : StatisticsQuality::Draft };
+
+		processor.process<processing_path>(fp, request, executor, [&](PeakIndex* index, const auto& measure) {
+			return AviUtlPeakSource(fp, fpip, index, measure);
+			});
+
+		return true;
+	} 
+
+	// Profiling builds leave the stage latencies in the cache directory on exit, and
+	// telemetry builds finish the log they keep there.
+	static inline BOOL func_exit(AviUtl::FilterPlugin* fp)
+	{
+#if defined(LUMINANCE_LIMITER_SG_TELEMETRY)
+		TelemetryLog::global().close();
+#endif
+#if defined(LUMINANCE_LIMITER_SG_PROFILE)
+		if (ProjectParameter::source() && !cache_directory().empty())
+		{
+			StageProfile::global().dump(debug_output(".llsgprofile.json"));
+		}
+#endif
+		return true;
+	}
+
+	static inline BOOL func_update(AviUtl::FilterPlugin* fp, AviUtl::FilterPluginDLL::UpdateStatus status)
+	{
+		// Any trackbar or check box: the render thread applies the new snapshot itself.
+		processor.update(fp);
+		return true;
+	}
+}
+
+
+constexpr AviUtl::FilterPluginDLL filter{
+	.flag = AviUtl::FilterPlugin::Flag::ExInformation,
+	.name = luminance_limiter_sg::name,
+	.track_n = luminance_limiter_sg::track_n,
+	.track_name = const_cast<const char**>(std::data(luminance_limiter_sg::track_name)),
+	.track_default = const_cast<int32_t*>(std::data(luminance_limiter_sg::track_default)),
+	.track_s = const_cast<int32_t*>(std::data(luminance_limiter_sg::track_s)),
+	.track_e = const_cast<int32_t*>(std::data(luminance_limiter_sg::track_e)),
+	.check_n = luminance_limiter_sg::check_n,
+	.check_name = const_cast<const char**>(std::data(luminance_limiter_sg::check_name)),
+	.check_default = const_cast<int32_t*>(std::data(luminance_limiter_sg::check_default)),
+	.func_proc = &luminance_limiter_sg::func_proc,
+	.func_exit = &luminance_limiter_sg::func_exit,
+	.func_update = &luminance_limiter_sg::func_update,
+	.information = luminance_limiter_sg::information,
+};
+
+auto __stdcall GetFilterTable(void) {
+	return &filter;
+}
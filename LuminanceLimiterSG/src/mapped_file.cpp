@@ -0,0 +1,182 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#include "mapped_file.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace luminance_limiter_sg
+{
+#ifdef _WIN32
+	std::optional<MappedFile> MappedFile::open(const std::filesystem::path& path, const size_t size) noexcept
+	{
+		auto mapped = MappedFile();
+		const auto file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return std::nullopt;
+		}
+		mapped.file = file;
+
+		auto current = LARGE_INTEGER();
+		if (!GetFileSizeEx(file, &current))
+		{
+			return std::nullopt;
+		}
+		mapped.fresh = static_cast<size_t>(current.QuadPart) != size;
+
+		const auto mapping = CreateFileMappingW(file, nullptr, PAGE_READWRITE,
+			static_cast<DWORD>(static_cast<uint64_t>(size) >> 32), static_cast<DWORD>(size & 0xFFFFFFFFu), nullptr);
+		if (!mapping)
+		{
+			return std::nullopt;
+		}
+		mapped.mapping = mapping;
+
+		mapped.view = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, size));
+		if (!mapped.view)
+		{
+			return std::nullopt;
+		}
+		mapped.length = size;
+		return mapped;
+	}
+
+	const void MappedFile::flush() const noexcept
+	{
+		if (view)
+		{
+			FlushViewOfFile(view, length);
+		}
+	}
+
+	const void MappedFile::close() noexcept
+	{
+		if (view)
+		{
+			UnmapViewOfFile(view);
+		}
+		if (mapping)
+		{
+			CloseHandle(mapping);
+		}
+		if (file)
+		{
+			CloseHandle(file);
+		}
+		view = nullptr;
+		mapping = nullptr;
+		file = nullptr;
+	}
+#else
+	std::optional<MappedFile> MappedFile::open(const std::filesystem::path& path, const size_t size) noexcept
+	{
+		auto mapped = MappedFile();
+		mapped.descriptor = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+		if (mapped.descriptor < 0)
+		{
+			return std::nullopt;
+		}
+
+		struct stat status {};
+		if (fstat(mapped.descriptor, &status) != 0)
+		{
+			return std::nullopt;
+		}
+		mapped.fresh = static_cast<size_t>(status.st_size) != size;
+		if (mapped.fresh && ftruncate(mapped.descriptor, static_cast<off_t>(size)) != 0)
+		{
+			return std::nullopt;
+		}
+
+		const auto view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, mapped.descriptor, 0);
+		if (view == MAP_FAILED)
+		{
+			return std::nullopt;
+		}
+		mapped.view = static_cast<uint8_t*>(view);
+		mapped.length = size;
+		return mapped;
+	}
+
+	const void MappedFile::flush() const noexcept
+	{
+		if (view)
+		{
+			msync(view, length, MS_ASYNC);
+		}
+	}
+
+	const void MappedFile::close() noexcept
+	{
+		if (view)
+		{
+			munmap(view, length);
+		}
+		if (descriptor >= 0)
+		{
+			::close(descriptor);
+		}
+		view = nullptr;
+		descriptor = -1;
+	}
+#endif
+
+	MappedFile::MappedFile(MappedFile&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+	{
+		if (this != &other)
+		{
+			close();
+			view = std::exchange(other.view, nullptr);
+			length = std::exchange(other.length, 0);
+			fresh = std::exchange(other.fresh, false);
+#ifdef _WIN32
+			file = std::exchange(other.file, nullptr);
+			mapping = std::exchange(other.mapping, nullptr);
+#else
+			descriptor = std::exchange(other.descriptor, -1);
+#endif
+		}
+		return *this;
+	}
+
+	MappedFile::~MappedFile()
+	{
+		close();
+	}
+
+	uint8_t* MappedFile::data() const noexcept
+	{
+		return view;
+	}
+
+	const size_t MappedFile::size() const noexcept
+	{
+		return length;
+	}
+
+	const bool MappedFile::created() const noexcept
+	{
+		return fresh;
+	}
+}
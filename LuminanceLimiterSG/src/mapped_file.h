@@ -0,0 +1,48 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+
+namespace luminance_limiter_sg
+{
+	// Read-write file mapping of a fixed size. The file is created or resized on open.
+	class MappedFile
+	{
+	public:
+		static std::optional<MappedFile> open(const std::filesystem::path& path, const size_t size) noexcept;
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+		~MappedFile();
+
+		uint8_t* data() const noexcept;
+		const size_t size() const noexcept;
+		const bool created() const noexcept;
+		const void flush() const noexcept;
+	private:
+		MappedFile() noexcept = default;
+		const void close() noexcept;
+
+		uint8_t* view = nullptr;
+		size_t length = 0;
+		bool fresh = false;
+#ifdef _WIN32
+		void* file = nullptr;
+		void* mapping = nullptr;
+#else
+		int descriptor = -1;
+#endif
+	};
+}
@@ -0,0 +1,209 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#include "parameters.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+#include "luminance.h"
+#include "project_parameter.h"
+
+
+namespace luminance_limiter_sg
+{
+	static std::atomic<uint64_t> next_version = 1u;
+
+	const Parameters Parameters::of(const AviUtl::FilterPlugin* const fp)
+	{
+		if (!ProjectParameter::fps())
+		{
+			throw std::runtime_error("Fps has not initialized.");
+		}
+		const auto frames_per_ms = ProjectParameter::fps().value() / 1000.0;
+
+		auto parameters = Parameters();
+		parameters.version = next_version.fetch_add(1u, std::memory_order_relaxed);
+		std::copy_n(fp->track, track_n, parameters.track.begin());
+		std::copy_n(fp->check, check_n, parameters.check.begin());
+
+		const auto& track = parameters.track;
+		parameters.effector_id = static_cast<uint32_t>(track[0]);
+		parameters.top_limit = Luminance::normalize_y(track[1]);
+		parameters.bottom_limit = Luminance::normalize_y(track[4]);
+		parameters.top_threshold = Luminance::normalize_y(std::max(track[2], track[3]));
+		parameters.bottom_threshold = Luminance::normalize_y(std::min(track[2], track[3]));
+		parameters.sustain = static_cast<uint32_t>(std::floor(static_cast<double>(track[5]) * frames_per_ms));
+		parameters.max_sustain = static_cast<uint32_t>(std::floor(static_cast<double>(fp->track_e[5]) * frames_per_ms));
+		parameters.release = std::ceil(static_cast<double>(track[6]) * frames_per_ms);
+		parameters.look_ahead = static_cast<uint32_t>(std::ceil(static_cast<double>(track[9]) * frames_per_ms));
+		parameters.mode = static_cast<InterpolationMode>(track[7]);
+		parameters.quantization_step = static_cast<uint32_t>(track[10]);
+		parameters.percentile = parameters.check[0] != 0;
+		parameters.exclusion = parameters.percentile ? static_cast<double>(track[8]) / 10000.0 : 0.0;
+		parameters.share_cache = parameters.check[1] != 0;
+		parameters.grid = { static_cast<uint32_t>(std::max(track[11], 1)), static_cast<uint32_t>(std::max(track[12], 1)) };
+		return parameters;
+	}
+
+	const bool Parameters::reads(const AviUtl::FilterPlugin* const fp) const noexcept
+	{
+		return std::equal(track.begin(), track.end(), fp->track) && std::equal(check.begin(), check.end(), fp->check);
+	}
+
+	const bool Parameters::same_envelope(const Parameters& other) const noexcept
+	{
+		return top_limit == other.top_limit && bottom_limit == other.bottom_limit
+			&& sustain == other.sustain && release == other.release
+			&& look_ahead == other.look_ahead
+			&& percentile == other.percentile && exclusion == other.exclusion;
+	}
+
+	ParameterSnapshots::Pin::Pin(Pin&& other) noexcept
+		: reader(other.reader), parameters(other.parameters)
+	{
+		other.reader = nullptr;
+		other.parameters = nullptr;
+	}
+
+	ParameterSnapshots::Pin& ParameterSnapshots::Pin::operator=(Pin&& other) noexcept
+	{
+		if (this != &other)
+		{
+			release();
+			reader = other.reader;
+			parameters = other.parameters;
+			other.reader = nullptr;
+			other.parameters = nullptr;
+		}
+		return *this;
+	}
+
+	ParameterSnapshots::Pin::~Pin()
+	{
+		release();
+	}
+
+	const void ParameterSnapshots::Pin::release() noexcept
+	{
+		if (reader)
+		{
+			reader->store(0u, std::memory_order_release);
+			reader = nullptr;
+		}
+		parameters = nullptr;
+	}
+
+	ParameterSnapshots::ParameterSnapshots(const size_t slots)
+		: current(slots)
+	{
+	}
+
+	ParameterSnapshots::~ParameterSnapshots()
+	{
+		for (auto&& snapshot : current)
+		{
+			delete snapshot.load();
+		}
+		for (const auto& retired : retired_snapshots)
+		{
+			delete retired.parameters;
+		}
+	}
+
+	ParameterSnapshots::Pin ParameterSnapshots::pin(const size_t slot) const noexcept
+	{
+		auto pin = Pin();
+		while (true)
+		{
+			for (auto&& reader : readers)
+			{
+				// Announce before loading: a snapshot retired after this load is only
+				// freed once the announcement is withdrawn.
+				auto free = uint64_t{ 0 };
+				if (reader.compare_exchange_strong(free, epoch.load()))
+				{
+					pin.reader = &reader;
+					pin.parameters = current[slot].load();
+					return pin;
+				}
+			}
+			std::this_thread::yield();
+		}
+	}
+
+	const void ParameterSnapshots::publish(const size_t slot, const Parameters& parameters)
+	{
+		auto* const snapshot = new Parameters(parameters);
+		std::lock_guard lock(writer);
+		if (const auto* const previous = current[slot].exchange(snapshot))
+		{
+			try
+			{
+				retired_snapshots.push_back(Retired{ previous, epoch.fetch_add(1u) });
+			}
+			catch (const std::bad_alloc&)
+			{
+				// Nowhere to keep it: leak rather than free a snapshot a pin may hold.
+			}
+		}
+		reclaim_locked();
+	}
+
+	const void ParameterSnapshots::reclaim() noexcept
+	{
+		std::lock_guard lock(writer);
+		reclaim_locked();
+	}
+
+	const size_t ParameterSnapshots::retired() const noexcept
+	{
+		std::lock_guard lock(writer);
+		return retired_snapshots.size();
+	}
+
+	const void ParameterSnapshots::reclaim_locked() noexcept
+	{
+		auto oldest = std::numeric_limits<uint64_t>::max();
+		for (const auto& reader : readers)
+		{
+			const auto started = reader.load();
+			oldest = started != 0u && started < oldest ? started : oldest;
+		}
+
+		const auto kept = std::remove_if(retired_snapshots.begin(), retired_snapshots.end(), [&](const Retired& retired) {
+			if (retired.epoch < oldest)
+			{
+				delete retired.parameters;
+				return true;
+			}
+			return false;
+			});
+		retired_snapshots.erase(kept, retired_snapshots.end());
+	}
+
+	const Parameters& ObjectParameters::of(const AviUtl::FilterPlugin* const fp)
+	{
+		// Every snapshot built has a version, so an unused slot reads nothing.
+		auto slot = std::find_if(slots.begin(), slots.end(), [fp](const Slot& held) {
+			return held.parameters.version != 0u && held.parameters.reads(fp);
+			});
+		if (slot == slots.end())
+		{
+			slot = std::min_element(slots.begin(), slots.end(), [](const Slot& a, const Slot& b) {
+				return a.last_use < b.last_use;
+				});
+			slot->parameters = Parameters::of(fp);
+		}
+		slot->last_use = ++uses;
+		return slot->parameters;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,165 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "aviutl/filter.hpp"
+#include "interpolation.h"
+#include "trackbar.h"
+
+
+namespace luminance_limiter_sg
+{
+	// Everything the core reads from the trackbars of one instance, derived once when
+	// they change: times in frames, normalized limits and sorted thresholds. Immutable
+	// once built; version tells snapshots apart without comparing them.
+	struct Parameters
+	{
+		uint64_t version = 0;
+		// The trackbars and check boxes the rest is derived from.
+		std::array<int32_t, track_n> track = {};
+		std::array<int32_t, check_n> check = {};
+
+		uint32_t effector_id = 0;
+		double top_limit = 0.0;
+		double bottom_limit = 0.0;
+		// top_threshold >= bottom_threshold whichever trackbar holds which.
+		double top_threshold = 0.0;
+		double bottom_threshold = 0.0;
+		uint32_t sustain = 0;
+		uint32_t max_sustain = 0;
+		double release = 0.0;
+		uint32_t look_ahead = 0;
+		InterpolationMode mode = InterpolationMode::Linear;
+		uint32_t quantization_step = 0;
+		bool percentile = false;
+		// Fraction of the pixels left out of each tail for percentile peaks, else 0.
+		double exclusion = 0.0;
+		bool share_cache = false;
+		std::array<uint32_t, 2> grid = { 1, 1 };
+
+		// Throws std::runtime_error until the frame rate is known.
+		static const Parameters of(const AviUtl::FilterPlugin* const fp);
+
+		// Whether fp still holds the trackbars and check boxes this was derived from.
+		const bool reads(const AviUtl::FilterPlugin* const fp) const noexcept;
+		// Whether the raw peaks fed to the envelope and the envelope itself are the same.
+		const bool same_envelope(const Parameters& other) const noexcept;
+	};
+
+	// The latest Parameters of every rack slot, read without locks.
+	// publish swaps a new snapshot in with one atomic exchange and retires the old one.
+	// A Pin announces the epoch it started in before loading the snapshot, and a retired
+	// snapshot is freed only once every pin still held started after it was retired, so
+	// a reader never waits and never sees a snapshot freed or half written. The only
+	// writer is func_update; writers are rare and take a mutex between themselves.
+	class ParameterSnapshots
+	{
+	public:
+		// Threads that can hold pins at once; any further reader spins until one is dropped.
+		constexpr static inline size_t max_readers = 8u;
+
+		class Pin
+		{
+		public:
+			Pin() noexcept = default;
+			Pin(Pin&& other) noexcept;
+			Pin& operator=(Pin&& other) noexcept;
+			Pin(const Pin&) = delete;
+			Pin& operator=(const Pin&) = delete;
+			~Pin();
+
+			// Null when nothing was published for the slot yet.
+			inline const Parameters* get() const noexcept
+			{
+				return parameters;
+			}
+
+			inline const Parameters* operator->() const noexcept
+			{
+				return parameters;
+			}
+
+			inline const Parameters& operator*() const noexcept
+			{
+				return *parameters;
+			}
+
+			inline explicit operator bool() const noexcept
+			{
+				return parameters != nullptr;
+			}
+		private:
+			friend class ParameterSnapshots;
+
+			std::atomic<uint64_t>* reader = nullptr;
+			const Parameters* parameters = nullptr;
+
+			const void release() noexcept;
+		};
+
+		explicit ParameterSnapshots(const size_t slots);
+		ParameterSnapshots(const ParameterSnapshots&) = delete;
+		ParameterSnapshots& operator=(const ParameterSnapshots&) = delete;
+		~ParameterSnapshots();
+
+		Pin pin(const size_t slot) const noexcept;
+		// Makes parameters the snapshot of slot; the version is left as given.
+		const void publish(const size_t slot, const Parameters& parameters);
+		// Frees every retired snapshot no pin can still see.
+		const void reclaim() noexcept;
+		// Snapshots retired but not freed yet.
+		const size_t retired() const noexcept;
+	private:
+		struct Retired
+		{
+			const Parameters* parameters;
+			uint64_t epoch;
+		};
+
+		std::vector<std::atomic<const Parameters*>> current;
+		// Epoch each pin started in, or 0 for a free reader.
+		mutable std::array<std::atomic<uint64_t>, max_readers> readers = {};
+		std::atomic<uint64_t> epoch = 1u;
+
+		mutable std::mutex writer;
+		std::vector<Retired> retired_snapshots;
+
+		const void reclaim_locked() noexcept;
+	};
+
+	// Parameters of trackbars nobody published: the objects of the extended editor
+	// share one FilterPlugin and never reach func_update, and nothing is published
+	// before the first frame. A fixed set of snapshots, used by the render thread only,
+	// is keyed by the trackbars they read; a miss rebuilds the least recently used one
+	// in place, so frames are processed without allocating whichever object they are of.
+	class ObjectParameters
+	{
+	public:
+		constexpr static inline size_t capacity = 32u;
+
+		// The snapshot reading fp, valid until capacity other trackbars are asked for.
+		const Parameters& of(const AviUtl::FilterPlugin* const fp);
+	private:
+		struct Slot
+		{
+			Parameters parameters;
+			uint64_t last_use = 0;
+		};
+
+		std::array<Slot, capacity> slots = {};
+		uint64_t uses = 0;
+	};
+}
\ No newline at end of file
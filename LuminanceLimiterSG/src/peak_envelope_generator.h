@@ -1,43 +1,67 @@
-/*
-	Copyright(c) 2023 SoseiGocho
-	This Source Code Form is subject to the terms of the Mozilla Public License,
-	v. 2.0.If a copy of the MPL was not distributed with this file, You can
-	obtain one at https ://mozilla.org/MPL/2.0/.
-*/
-
-#pragma once
-
-#include "luminance_limiter_sg.h"
-
-#include <array>
-#include <deque>
-#include <optional>
-
-#include "buffer.h"
-
-namespace luminance_limiter_sg {
-	class PeakEnvelopeGenerator {
-	public:
-		BOOL set_limit(const double top, const double bottom) noexcept;
-		BOOL set_sustain(const uint32_t sustain);
-		BOOL set_release(const double release);
-		std::array<double, 2> hold_peaks(const double top_peak, const double bottom_peak) noexcept;
-		std::array<double, 2> wrap_peaks(const double top_peak, const double bottom_peak) noexcept;
-		std::array<double, 2> update_and_get_envelope_peaks(const double top_peak, const double bottom_peak) noexcept;
-
-	private:
-		std::optional<std::deque<double>> top_peak_lifetime_buffer = std::nullopt;
-		std::optional<std::deque<double>> bottom_peak_lifetime_buffer = std::nullopt;
-		std::optional<std::deque<double>> active_top_peak_buffer = std::nullopt;
-		std::optional<std::deque<double>> active_bottom_peak_buffer = std::nullopt;
-		uint32_t sustain = 0u;
-		double release = 0.0;
-		double ongoing_top_peak = 0.0;
-		double top_peak_duration = 0.0;
-		double ongoing_bottom_peak = 0.0;
-		double bottom_peak_duration = 0.0;
-
-		double top_limit = 0.0;
-		double bottom_limit = 0.0;
-	};
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+#pragma once
+
+#include "luminance_limiter_sg.h"
+
+#include <array>
+#include <cstdint>
+#include <span>
+
+#include "aviutl/filter.hpp"
+#include "ring_buffer.h"
+
+namespace luminance_limiter_sg {
+	// Holds each peak for sustain frames, then releases it linearly toward the opposite limit.
+	// The held peaks come from monotonic ring queues over the last sustain + 1 frames, and
+	// the raw peaks of those frames are kept so that sustain can change mid-clip.
+	// Nothing is allocated per frame; storage only grows when sustain exceeds what was reserved.
+	class PeakEnvelopeGenerator {
+	public:
+		PeakEnvelopeGenerator();
+
+		BOOL set_limit(const double top, const double bottom) noexcept;
+		BOOL set_sustain(const uint32_t sustain);
+		BOOL set_release(const double release);
+		BOOL reserve(const uint32_t max_sustain);
+		std::array<double, 2> hold_peaks(const double top_peak, const double bottom_peak) noexcept;
+		std::array<double, 2> wrap_peaks(const double top_peak, const double bottom_peak) noexcept;
+		std::array<double, 2> update_and_get_envelope_peaks(const double top_peak, const double bottom_peak) noexcept;
+		// Envelope of consecutive frames; envelope must be at least as long as peaks.
+		const void process(std::span<const std::array<double, 2>> peaks, std::span<std::array<double, 2>> envelope) noexcept;
+
+		// Forgets every peak seen so far but keeps limit, sustain and release.
+		const void reset() noexcept;
+		// Frames of raw peaks that fully determine the envelope of the next frame.
+		const uint32_t history() const noexcept;
+
+	private:
+		struct Candidate
+		{
+			uint64_t frame;
+			double peak;
+		};
+
+		RingBuffer<std::array<double, 2>> recent_peaks;
+		RingBuffer<Candidate> active_top_peaks;
+		RingBuffer<Candidate> active_bottom_peaks;
+		uint64_t elapsed = 0u;
+		uint32_t sustain = 0u;
+		double release = 0.0;
+		double ongoing_top_peak = 0.0;
+		double top_peak_duration = 0.0;
+		double ongoing_bottom_peak = 0.0;
+		double bottom_peak_duration = 0.0;
+
+		double top_limit = 0.0;
+		double bottom_limit = 0.0;
+
+		const void push_active(const uint64_t frame, const double top_peak, const double bottom_peak) noexcept;
+		const void expire_active() noexcept;
+	};
 }
\ No newline at end of file
@@ -0,0 +1,151 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#include "peak_index.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <utility>
+
+#include "luminance.h"
+
+
+namespace luminance_limiter_sg
+{
+	static inline const uint64_t fnv1a(uint64_t hash, const void* data, const size_t size) noexcept
+	{
+		const auto bytes = static_cast<const uint8_t*>(data);
+		for (auto i = size_t{ 0 }; i < size; ++i)
+		{
+			hash = (hash ^ bytes[i]) * 1099511628211u;
+		}
+		return hash;
+	}
+
+	constexpr static inline uint64_t fnv1a_basis = 14695981039346656037u;
+
+	const uint64_t PeakIndex::Key::hash() const noexcept
+	{
+		auto hash = fnv1a_basis;
+		hash = fnv1a(hash, &source, sizeof(source));
+		hash = fnv1a(hash, &frames, sizeof(frames));
+		hash = fnv1a(hash, &width, sizeof(width));
+		hash = fnv1a(hash, &height, sizeof(height));
+		hash = fnv1a(hash, &step, sizeof(step));
+		hash = fnv1a(hash, &exclusion, sizeof(exclusion));
+		hash = fnv1a(hash, &effector, sizeof(effector));
+		return hash;
+	}
+
+	std::optional<PeakIndex> PeakIndex::open(const std::filesystem::path& path, const Key& key) noexcept
+	{
+		if (key.frames == 0)
+		{
+			return std::nullopt;
+		}
+
+		auto file = MappedFile::open(path, sizeof(Header) + sizeof(Entry) * key.frames);
+		if (!file)
+		{
+			return std::nullopt;
+		}
+
+		auto index = PeakIndex(std::move(file.value()), key);
+		auto header = reinterpret_cast<Header*>(index.file.data());
+		if (index.file.created() || header->magic != magic || header->version != version
+			|| header->frames != key.frames || header->key != key.hash())
+		{
+			*header = Header{ magic, version, key.frames, key.hash() };
+			index.clear();
+		}
+		return index;
+	}
+
+	const std::filesystem::path PeakIndex::cache_path(const std::filesystem::path& directory, const Key& key)
+	{
+		char name[32] = {};
+		std::snprintf(name, sizeof(name), "%016llx.llsgpeaks", static_cast<unsigned long long>(key.hash()));
+		return directory / name;
+	}
+
+	const uint64_t PeakIndex::source_hash(const std::string_view name) noexcept
+	{
+		return fnv1a(fnv1a_basis, name.data(), name.size());
+	}
+
+	PeakIndex::PeakIndex(MappedFile&& file, const Key& key) noexcept
+		: file(std::move(file)), index_key(key)
+	{
+	}
+
+	const PeakIndex::Key& PeakIndex::key() const noexcept
+	{
+		return index_key;
+	}
+
+	const uint32_t PeakIndex::frames() const noexcept
+	{
+		return index_key.frames;
+	}
+
+	const std::optional<std::array<double, 2>> PeakIndex::peaks(const int32_t frame) const noexcept
+	{
+		if (frame < 0 || static_cast<uint32_t>(frame) >= frames())
+		{
+			return std::nullopt;
+		}
+
+		const auto entry = entries()[frame];
+		if (entry.top < entry.bottom)
+		{
+			return std::nullopt;
+		}
+		return std::array<double, 2>{ Luminance::normalize_y(entry.top), Luminance::normalize_y(entry.bottom) };
+	}
+
+	const void PeakIndex::store(const int32_t frame, const std::array<double, 2>& peaks) noexcept
+	{
+		if (frame < 0 || static_cast<uint32_t>(frame) >= frames())
+		{
+			return;
+		}
+
+		entries()[frame] = quantize(peaks);
+	}
+
+	const bool PeakIndex::agrees(const int32_t frame, const std::array<double, 2>& peaks) const noexcept
+	{
+		if (frame < 0 || static_cast<uint32_t>(frame) >= frames())
+		{
+			return true;
+		}
+
+		const auto entry = entries()[frame];
+		const auto measured = quantize(peaks);
+		return entry.top < entry.bottom || (entry.top == measured.top && entry.bottom == measured.bottom);
+	}
+
+	const void PeakIndex::clear() noexcept
+	{
+		std::fill(entries(), entries() + frames(), Entry{ INT16_MIN, INT16_MAX });
+		file.flush();
+	}
+
+	PeakIndex::Entry* PeakIndex::entries() const noexcept
+	{
+		return reinterpret_cast<Entry*>(file.data() + sizeof(Header));
+	}
+
+	const PeakIndex::Entry PeakIndex::quantize(const std::array<double, 2>& peaks) noexcept
+	{
+		const auto [top, bottom] = peaks;
+		return Entry{
+			Luminance::quantize_y(Luminance::denormalize_y(top)),
+			Luminance::quantize_y(Luminance::denormalize_y(bottom)) };
+	}
+}
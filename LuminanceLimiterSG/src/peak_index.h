@@ -0,0 +1,101 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string_view>
+
+#include "executor.h"
+#include "mapped_file.h"
+
+namespace luminance_limiter_sg
+{
+	// Raw top/bottom peaks of every frame of a source, kept in a memory-mapped file in
+	// the cache directory so that the envelope of any frame can be rebuilt from the
+	// frames before it.
+	class PeakIndex
+	{
+	public:
+		// Everything the raw peaks depend on that is known up front. A file written under
+		// another key is discarded. Upstream filters and earlier stacked instances are not
+		// part of it: check each frame measured against what the index holds instead.
+		struct Key
+		{
+			uint64_t source = 0;
+			uint32_t frames = 0;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			uint32_t step = 0;
+			int32_t exclusion = 0;
+			uint32_t effector = 0;
+
+			bool operator==(const Key&) const = default;
+			const uint64_t hash() const noexcept;
+		};
+
+		constexpr static inline uint64_t magic = 0x5844495047534C4Cu;
+		constexpr static inline uint32_t version = 1u;
+
+		static std::optional<PeakIndex> open(const std::filesystem::path& path, const Key& key) noexcept;
+		static const std::filesystem::path cache_path(const std::filesystem::path& directory, const Key& key);
+		static const uint64_t source_hash(const std::string_view name) noexcept;
+
+		const Key& key() const noexcept;
+		const uint32_t frames() const noexcept;
+		const std::optional<std::array<double, 2>> peaks(const int32_t frame) const noexcept;
+		const void store(const int32_t frame, const std::array<double, 2>& peaks) noexcept;
+		// False when frame is stored with other peaks than the ones just measured: the
+		// image changed upstream since the index was written.
+		const bool agrees(const int32_t frame, const std::array<double, 2>& peaks) const noexcept;
+		// Forgets the peaks of every frame.
+		const void clear() noexcept;
+
+		// Fills every frame not yet in the index; measure(frame) returns std::optional peaks
+		// and must be safe to call from several threads at once.
+		template<Executor E, typename F>
+		inline const void scan(E& executor, const F& measure)
+		{
+			executor.parallel_for(frames(), [&](const uint32_t frame) {
+				if (peaks(static_cast<int32_t>(frame)))
+				{
+					return;
+				}
+				if (const auto measured = measure(static_cast<int32_t>(frame)))
+				{
+					store(static_cast<int32_t>(frame), *measured);
+				}
+				});
+			file.flush();
+		}
+	private:
+		struct Header
+		{
+			uint64_t magic;
+			uint32_t version;
+			uint32_t frames;
+			uint64_t key;
+		};
+
+		struct Entry
+		{
+			int16_t top;
+			int16_t bottom;
+		};
+
+		PeakIndex(MappedFile&& file, const Key& key) noexcept;
+		Entry* entries() const noexcept;
+		static const Entry quantize(const std::array<double, 2>& peaks) noexcept;
+
+		MappedFile file;
+		Key index_key;
+	};
+}
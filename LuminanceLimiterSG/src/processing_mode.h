@@ -1,19 +1,31 @@
-/*
-	Copyright(c) 2023 SoseiGocho
-	This Source Code Form is subject to the terms of the Mozilla Public License,
-	v. 2.0.If a copy of the MPL was not distributed with this file, You can
-	obtain one at https ://mozilla.org/MPL/2.0/.
-*/
-
-
-#pragma once
-
-
-namespace luminance_limiter_sg
-{
-	enum class ProcessingMode
-	{
-		Compressor,
-		Limiter
-	};
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#pragma once
+
+
+namespace luminance_limiter_sg
+{
+	enum class ProcessingMode
+	{
+		Compressor,
+		Limiter
+	};
+
+	enum class ProcessingPath
+	{
+		Staged,
+		InPlace
+	};
+
+	enum class StatisticsQuality
+	{
+		Exact,
+		Draft
+	};
 }
\ No newline at end of file
@@ -0,0 +1,54 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#include "processor.h"
+
+#include "cache_directory.h"
+
+
+namespace luminance_limiter_sg
+{
+	const void Processor::update(const AviUtl::FilterPlugin* const fp)
+	{
+		// Times are derived in frames, so nothing can be published before the first frame.
+		if (!ProjectParameter::fps() || !has_slot(fp))
+		{
+			return;
+		}
+		snapshots.publish(static_cast<uint32_t>(fp->track[0]), Parameters::of(fp));
+	}
+
+	const void Processor::change_source() noexcept
+	{
+		for (auto id = 0u; id < num_or_racks; ++id)
+		{
+			rack[id].reset();
+			local_limiters[id].reset();
+			peak_indices[id].reset();
+		}
+	}
+
+	PeakIndex* Processor::peak_index(const Parameters& parameters, const FrameRequest& request, const uint32_t effector_id, const uint32_t step)
+	{
+		auto& index = peak_indices[effector_id];
+		if (!ProjectParameter::source() || request.frame_count <= 0 || cache_directory().empty())
+		{
+			return nullptr;
+		}
+
+		const auto key = PeakIndex::Key{
+			PeakIndex::source_hash(ProjectParameter::source().value()),
+			static_cast<uint32_t>(request.frame_count), request.width, request.height, step,
+			parameters.percentile ? parameters.track[8] : 0, effector_id };
+		if (!index || !(index->key() == key))
+		{
+			index = PeakIndex::open(PeakIndex::cache_path(cache_directory(), key), key);
+		}
+		return index ? &index.value() : nullptr;
+	}
+}
@@ -0,0 +1,291 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <variant>
+#include <vector>
+
+#include "aviutl/filter.hpp"
+#include "buffer.h"
+#include "effector.h"
+#include "executor.h"
+#include "frame.h"
+#include "frame_peak_source.h"
+#include "histogram.h"
+#include "local_limiter.h"
+#include "parameters.h"
+#include "peak_index.h"
+#include "processing_mode.h"
+#include "project_parameter.h"
+#include "rack.h"
+#include "scratch_pool.h"
+#include "stage_profile.h"
+#include "telemetry.h"
+
+
+namespace luminance_limiter_sg
+{
+	// The image one call of the filter processes, in place.
+	struct FrameRequest
+	{
+		AviUtl::PixelYC* pixels = nullptr;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t max_width = 0;
+		uint32_t max_height = 0;
+		int32_t frame = 0;
+		// Frames in the clip, or 0 when the length is not known up front.
+		int32_t frame_count = 0;
+		StatisticsQuality quality = StatisticsQuality::Exact;
+	};
+
+	// Everything func_proc does that does not depend on AviUtl: the rack of effectors,
+	// the statistics of the frame and the peak index of every instance. The host
+	// provides the image, an Executor and a FramePeakSource for the other frames.
+	class Processor
+	{
+	public:
+		// make_source(PeakIndex* index, measure) returns the FramePeakSource used to seek
+		// and look ahead; measure(const Frame&) gives the raw peaks of any frame the way
+		// this instance measures its own. index may be null.
+		template<ProcessingPath P, Executor E, typename F>
+		inline const void process(const AviUtl::FilterPlugin* const fp, const FrameRequest& request, E& executor, const F& make_source)
+		{
+			LUMINANCE_LIMITER_SG_TIME_STAGE(Stage::Frame);
+
+			if (!has_slot(fp))
+			{
+				return;
+			}
+
+			if (rack.is_first_time(static_cast<uint32_t>(request.frame)))
+			{
+				LUMINANCE_LIMITER_SG_TIME_STAGE(Stage::Gc);
+				rack.gc();
+				scratch.release_idle();
+				snapshots.reclaim();
+				for (auto id = 0u; id < num_or_racks; ++id)
+				{
+					if (!rack[id])
+					{
+						local_limiters[id].reset();
+					}
+				}
+			}
+
+			const auto effector_id = static_cast<uint32_t>(fp->track[0]);
+			rack.enter(effector_id, request.frame);
+
+			// Objects of the extended editor share one FilterPlugin and never reach
+			// update, so trackbars other than the published ones have snapshots of their own.
+			const auto published = snapshots.pin(effector_id);
+			const auto& parameters = published && published->reads(fp) ? *published : objects.of(fp);
+
+			if (!rack[effector_id])
+			{
+				rack.set_effector(effector_id, parameters);
+			}
+
+			std::visit([&](auto& effector) {
+				process_with<P>(parameters, request, executor, make_source, effector_id, effector);
+				}, rack[effector_id].value());
+		}
+
+		// Publishes the trackbars of fp as the snapshot of its instance; the effector
+		// picks it up on the next frame it processes.
+		const void update(const AviUtl::FilterPlugin* const fp);
+		// The project now renders another source: nothing measured from the last one
+		// applies, so every instance starts over and its index is reopened for the new one.
+		const void change_source() noexcept;
+	private:
+		Rack rack = Rack();
+		ParameterSnapshots snapshots = ParameterSnapshots(num_or_racks);
+		ObjectParameters objects = ObjectParameters();
+		// Per-frame planes, sized to the frame at hand and released once idle.
+		ScratchPool scratch = ScratchPool();
+		Histogram frame_histogram = Histogram();
+		std::vector<Histogram> histogram_partials = std::vector<Histogram>();
+		std::array<std::optional<PeakIndex>, num_or_racks> peak_indices;
+		std::array<std::optional<LocalLimiter>, num_or_racks> local_limiters;
+
+		// Scripts of the extended editor can set trackbar 0 past its range; the frame of
+		// an instance with no slot is left as it is.
+		static inline const bool has_slot(const AviUtl::FilterPlugin* const fp) noexcept
+		{
+			return fp->track[0] >= 0 && static_cast<uint32_t>(fp->track[0]) < num_or_racks;
+		}
+
+		// The rest of process for the effector type held in the slot.
+		template<ProcessingPath P, Executor E, typename F, Effector T>
+		inline const void process_with(const Parameters& parameters, const FrameRequest& request, E& executor, const F& make_source, const uint32_t effector_id, T& effector)
+		{
+			effector.used();
+
+			auto frame = Frame(request.pixels, request.width, request.height, request.max_width);
+
+			if constexpr (P == ProcessingPath::Staged)
+			{
+				auto buffer = Buffer<int16_t>(request.width, request.height, request.max_width, scratch);
+				{
+					LUMINANCE_LIMITER_SG_TIME_STAGE(Stage::Fetch);
+					buffer.fetch_image(request.width, request.height, request.pixels);
+				}
+				effector.fetch_trackbar_and_buffer(parameters, buffer);
+				if (TelemetryLog::global().enabled())
+				{
+					log_frame(effector_id, effector, nullptr);
+				}
+				{
+					LUMINANCE_LIMITER_SG_TIME_STAGE(Stage::Apply);
+					frame.apply(effector.effect(), executor);
+				}
+			}
+			else
+			{
+				const auto step = frame.sampling_step(request.quality);
+
+				if (LocalLimiter::is_local(parameters))
+				{
+					auto& local = local_limiters[effector_id];
+					if (!local)
+					{
+						local.emplace(parameters);
+					}
+					local->seek(request.frame);
+					local->fetch_trackbar_and_frame(parameters, frame, request.width, request.height, executor, step);
+					{
+						LUMINANCE_LIMITER_SG_TIME_STAGE(Stage::Apply);
+						local->apply(frame, executor);
+					}
+					// Tiles blend several tables, so no histogram can be derived for the next
+					// instance.
+					rack.break_chain();
+					return;
+				}
+
+				auto stamp = FrameStamp{ request.frame, request.pixels, request.width, request.height, step };
+
+				auto* const index = peak_index(parameters, request, effector_id, step);
+
+				const auto measure = [&](const Frame& other) {
+					if (parameters.percentile)
+					{
+						other.histogram(frame_histogram, histogram_partials, executor, step);
+						return effector.peaks_of(parameters, frame_histogram);
+					}
+					return other.peaks(executor, step);
+					};
+				// The frame is measured before the seek, so that an index or checkpoints written
+				// before an upstream change are caught before any of them is replayed.
+				// Min/max peaks cost less to rescan than a histogram costs to count, so only
+				// percentile instances read the chain, and only stacked ones that another
+				// instance follows extend it.
+				auto peaks = std::array<double, 2>();
+				if (parameters.percentile)
+				{
+					if (!rack.continues_chain(stamp, [&]() { return frame.hash(executor, step); }))
+					{
+						LUMINANCE_LIMITER_SG_TIME_STAGE(Stage::Reduce);
+						frame.histogram(frame_histogram, histogram_partials, executor, step);
+						rack.begin_chain(frame_histogram);
+					}
+					peaks = effector.peaks_of(parameters, rack.chain_histogram());
+				}
+				else
+				{
+					LUMINANCE_LIMITER_SG_TIME_STAGE(Stage::Reduce);
+					peaks = frame.peaks(executor, step);
+				}
+				if (index && !index->agrees(request.frame, peaks))
+				{
+					index->clear();
+					effector.rewind();
+				}
+
+				{
+					LUMINANCE_LIMITER_SG_TIME_STAGE(Stage::Seek);
+					if (rack.is_first_in_pass())
+					{
+						const auto source = make_source(index, measure);
+						effector.seek(parameters, request.frame, peaks, source);
+						effector.anticipate(parameters, request.frame, source);
+					}
+					// The host only hands out the input of the filter, not what the instances
+					// before this one made of it: replay only what this instance measured,
+					// and look ahead at nothing.
+					else
+					{
+						const auto none = EmptyPeakSource();
+						if (index)
+						{
+							effector.seek(parameters, request.frame, peaks, *index, none);
+						}
+						else
+						{
+							effector.seek(parameters, request.frame, peaks, none);
+						}
+						effector.anticipate(parameters, request.frame, none);
+					}
+				}
+				effector.fetch_trackbar_and_peaks(parameters, peaks);
+
+				if (index)
+				{
+					index->store(request.frame, effector.raw_peaks());
+				}
+				if (TelemetryLog::global().enabled())
+				{
+					log_frame(effector_id, effector, parameters.percentile ? &rack.chain_histogram() : nullptr);
+				}
+
+				if (parameters.percentile && rack.is_stacked() && !rack.is_last_in_pass())
+				{
+					{
+						LUMINANCE_LIMITER_SG_TIME_STAGE(Stage::Apply);
+						stamp.hash = frame.apply_hashed(effector.effect(), executor, step);
+					}
+					rack.extend_chain(effector_id, effector.effect(), stamp);
+				}
+				else
+				{
+					{
+						LUMINANCE_LIMITER_SG_TIME_STAGE(Stage::Apply);
+						frame.apply(effector.effect(), executor);
+					}
+					rack.break_chain();
+				}
+			}
+		}
+
+		// Pushes what effector is about to do to the telemetry log. histogram is the one
+		// the peaks were read from, if any; the frame is never counted just for the log.
+		template<Effector T>
+		inline const void log_frame(const uint32_t effector_id, const T& effector, const Histogram* const histogram) noexcept
+		{
+			if constexpr (requires { effector.last_record(); })
+			{
+				auto record = effector.last_record();
+				record.effector_id = effector_id;
+				record.clip = ProjectParameter::source() ? PeakIndex::source_hash(ProjectParameter::source().value()) : 0u;
+				if (histogram)
+				{
+					record.modified = histogram->modified(effector.effect());
+				}
+				TelemetryLog::global().push(record);
+			}
+		}
+
+		// Index of the current source for this instance, or null when the source is
+		// not known or its file in the cache directory cannot be opened.
+		PeakIndex* peak_index(const Parameters& parameters, const FrameRequest& request, const uint32_t effector_id, const uint32_t step);
+	};
+}
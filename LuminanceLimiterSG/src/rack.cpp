@@ -1,61 +1,142 @@
-/*
-	Copyright(c) 2023 SoseiGocho
-	This Source Code Form is subject to the terms of the Mozilla Public License,
-	v. 2.0.If a copy of the MPL was not distributed with this file, You can
-	obtain one at https ://mozilla.org/MPL/2.0/.
-*/
-
-
-#include "rack.h"
-
-
-namespace luminance_limiter_sg
-{
-	Rack::Rack()
-	{
-		std::fill(elements.begin(), elements.end(), std::nullopt);
-	}
-
-	const void Rack::gc() noexcept
-	{
-		for (auto&& elem: elements)
-		{
-			if (elem)
-			{
-				if (!elem->is_using())
-				{
-					elem.reset();
-				}
-				else
-				{
-					elem->reset();
-				}
-			}
-		}
-	}
-
-	const bool Rack::is_first_time(uint32_t current_frame) noexcept
-	{
-		const auto result = ongoing_frame < current_frame;
-		if (result)
-		{
-			ongoing_frame = current_frame;
-		}
-		return result;
-	}
-
-	const void Rack::set_effector(uint32_t idx, const AviUtl::FilterPlugin* const fp)
-	{
-		elements[idx].emplace(Limiter(fp));
-	}
-
-	uint32_t Rack::size() const noexcept
-	{
-		return elements.size();
-	}
-
-	std::optional<Limiter>& Rack::operator[] (size_t idx) noexcept
-	{
-		return elements[idx];
-	}
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#include "rack.h"
+
+#include <algorithm>
+
+
+namespace luminance_limiter_sg
+{
+	Rack::Rack()
+	{
+		std::fill(elements.begin(), elements.end(), std::nullopt);
+	}
+
+	const void Rack::gc() noexcept
+	{
+		stacked_effectors = 0;
+		for (auto&& elem: elements)
+		{
+			if (elem)
+			{
+				const auto using_it = std::visit([](auto& effector) noexcept { return effector.is_using(); }, elem.value());
+				stacked_effectors += using_it ? 1u : 0u;
+				if (!using_it)
+				{
+					elem.reset();
+				}
+				else
+				{
+					std::visit([](auto& effector) noexcept { effector.reset(); }, elem.value());
+				}
+			}
+		}
+	}
+
+	const bool Rack::is_first_time(uint32_t current_frame) noexcept
+	{
+		const auto result = ongoing_frame != current_frame;
+		if (result)
+		{
+			ongoing_frame = current_frame;
+		}
+		return result;
+	}
+
+	uint32_t Rack::size() const noexcept
+	{
+		return elements.size();
+	}
+
+	std::optional<RackUnit>& Rack::operator[] (size_t idx) noexcept
+	{
+		return elements[idx];
+	}
+
+	const bool Rack::is_stacked() const noexcept
+	{
+		return stacked_effectors > 1u;
+	}
+
+	const void Rack::enter(const uint32_t effector_id, const int32_t frame) noexcept
+	{
+		const auto ran = std::find(pass_ids.begin(), pass_ids.begin() + pass_length, effector_id) != pass_ids.begin() + pass_length;
+		if (frame != pass_frame || ran || pass_length == pass_ids.size())
+		{
+			pass_frame = frame;
+			pass_length = 0;
+			chain_start = 0;
+			chain_length = 0;
+			chain_stamp = FrameStamp();
+		}
+		pass_ids[pass_length++] = effector_id;
+	}
+
+	const bool Rack::is_first_in_pass() const noexcept
+	{
+		return pass_length == 1u;
+	}
+
+	const bool Rack::is_last_in_pass() const noexcept
+	{
+		return pass_length >= stacked_effectors;
+	}
+
+	const bool Rack::follows_chain() const noexcept
+	{
+		return chain_stamp.pixels
+			&& chain_start + chain_length + 1u == pass_length
+			&& std::equal(chain_ids.begin(), chain_ids.begin() + chain_length, pass_ids.begin() + chain_start);
+	}
+
+	const void Rack::begin_chain(const Histogram& source) noexcept
+	{
+		chain_start = pass_length - 1u;
+		chain_length = 0;
+		chain_stamp = FrameStamp();
+		chain_source = source;
+		chain_output = source;
+	}
+
+	const void Rack::extend_chain(const uint32_t effector_id, const TransferTable& table, const FrameStamp& stamp) noexcept
+	{
+		if (chain_length == 0)
+		{
+			chain_table = table;
+		}
+		else
+		{
+			chain_table.compose(table, chain_table);
+		}
+		chain_ids[chain_length++] = effector_id;
+		chain_output.transfer(chain_source, chain_table);
+		chain_stamp = stamp;
+	}
+
+	const void Rack::break_chain() noexcept
+	{
+		chain_length = 0;
+		chain_stamp = FrameStamp();
+	}
+
+	const Histogram& Rack::chain_histogram() const noexcept
+	{
+		return chain_output;
+	}
+
+	const TransferTable& Rack::fused() const noexcept
+	{
+		return chain_table;
+	}
+
+	const CurveCache& Rack::shared_curve_cache() const noexcept
+	{
+		return shared_cache;
+	}
 }
\ No newline at end of file
@@ -1,41 +1,133 @@
-/*
-	Copyright(c) 2023 SoseiGocho
-	This Source Code Form is subject to the terms of the Mozilla Public License,
-	v. 2.0.If a copy of the MPL was not distributed with this file, You can
-	obtain one at https ://mozilla.org/MPL/2.0/.
-*/
-
-
-#pragma once
-
-#include "rack_unit.h"
-
-#include <array>
-#include <memory>
-
-#include "processing_mode.h"
-#include "compressor.h"
-#include "limiter.h"
-
-namespace luminance_limiter_sg
-{
-	constexpr static inline auto num_or_racks = 16U;
-
-	class Rack
-	{
-	public:
-		Rack();
-
-		const void gc() noexcept;
-
-		const bool is_first_time(uint32_t current_frame) noexcept;
-		const void set_effector(uint32_t idx, const AviUtl::FilterPlugin* const fp);
-
-		uint32_t size() const noexcept;
-
-		std::optional<Limiter>& operator[] (size_t idx) noexcept;
-	private:
-		uint32_t ongoing_frame = 0;
-		std::array<std::optional<Limiter>, num_or_racks> elements;
-	};
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <variant>
+
+#include "processing_mode.h"
+#include "curve_cache.h"
+#include "effector.h"
+#include "histogram.h"
+#include "limiter.h"
+#include "trackbar.h"
+#include "transfer_table.h"
+
+namespace luminance_limiter_sg
+{
+	// Every effector type a slot can hold. Callers reach the one in a slot through
+	// std::visit, so each alternative gets its own instantiation of the processing
+	// path and a new alternative costs the others nothing.
+	using RackUnit = std::variant<Limiter>;
+
+	template<typename V>
+	constexpr static inline bool holds_effectors = false;
+	template<typename... Ts>
+	constexpr static inline bool holds_effectors<std::variant<Ts...>> = (Effector<Ts> && ...);
+
+	static_assert(holds_effectors<RackUnit>, "every RackUnit alternative must satisfy Effector");
+
+	// Identifies the image an instance leaves behind for the next one in the filter chain.
+	struct FrameStamp
+	{
+		int32_t frame = -1;
+		const void* pixels = nullptr;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t step = 0;
+		// Frame::hash of every pixel the statistics read at step.
+		uint64_t hash = 0;
+
+		bool operator==(const FrameStamp&) const = default;
+	};
+
+	class Rack
+	{
+	public:
+		Rack();
+
+		const void gc() noexcept;
+
+		const bool is_first_time(uint32_t current_frame) noexcept;
+		template<Effector T = Limiter>
+		inline const void set_effector(uint32_t idx, const Parameters& parameters)
+		{
+			auto& unit = std::get<T>(elements[idx].emplace(std::in_place_type<T>, parameters));
+			if constexpr (requires { unit.share(&shared_cache); })
+			{
+				unit.share(&shared_cache);
+			}
+		}
+
+		uint32_t size() const noexcept;
+
+		std::optional<RackUnit>& operator[] (size_t idx) noexcept;
+
+		// Stacked percentile instances on one frame share a chain: the histogram of the image
+		// the chain started from and the fused table of every instance applied since.
+		// A later instance reads its statistics from the chain instead of rescanning
+		// the frame only when every instance since the chain began extended it, in
+		// pass order, and its input matches the stamp of the last one.
+		const bool is_stacked() const noexcept;
+		// Called by every instance before it processes frame. The pass starts over,
+		// and the chain with it, on a new frame or when effector_id already ran in
+		// this pass: the frame is being rendered again.
+		const void enter(const uint32_t effector_id, const int32_t frame) noexcept;
+		// No other instance ran before the one that entered last in this pass.
+		const bool is_first_in_pass() const noexcept;
+		// Every instance that ran on the last frame has entered this pass, so no
+		// later one would read the chain.
+		const bool is_last_in_pass() const noexcept;
+		// stamp.hash is left to hash(), a full pass that is skipped when the order
+		// of the instances already rules the chain out.
+		template<typename F>
+		inline const bool continues_chain(FrameStamp stamp, const F& hash) const
+		{
+			if (!follows_chain())
+			{
+				return false;
+			}
+			stamp.hash = hash();
+			return stamp == chain_stamp;
+		}
+		const void begin_chain(const Histogram& source) noexcept;
+		const void extend_chain(const uint32_t effector_id, const TransferTable& table, const FrameStamp& stamp) noexcept;
+		// The instance that just ran changed the image through something other than one
+		// table, so the next one has to rescan the frame.
+		const void break_chain() noexcept;
+		const Histogram& chain_histogram() const noexcept;
+		const TransferTable& fused() const noexcept;
+
+		const CurveCache& shared_curve_cache() const noexcept;
+	private:
+		uint32_t ongoing_frame = 0;
+		uint32_t stacked_effectors = 0;
+
+		int32_t pass_frame = -1;
+		uint32_t pass_length = 0;
+		std::array<uint32_t, num_or_racks> pass_ids = {};
+
+		// The chain holds the instances pass_ids[chain_start] on.
+		uint32_t chain_start = 0;
+		uint32_t chain_length = 0;
+		std::array<uint32_t, num_or_racks> chain_ids = {};
+		FrameStamp chain_stamp;
+		Histogram chain_source;
+		Histogram chain_output;
+		TransferTable chain_table;
+
+		const bool follows_chain() const noexcept;
+
+		CurveCache shared_cache = CurveCache(num_or_racks);
+		std::array<std::optional<RackUnit>, num_or_racks> elements;
+	};
 }
\ No newline at end of file
@@ -0,0 +1,144 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#include "reference.h"
+
+#include <algorithm>
+#include <variant>
+
+#include "buffer.h"
+#include "interpolation.h"
+#include "limiter.h"
+#include "luminance.h"
+#include "scratch_pool.h"
+
+
+namespace luminance_limiter_sg
+{
+	const void ReferenceEnvelope::configure(const double top_limit, const double bottom_limit, const uint32_t sustain, const double release)
+	{
+		this->top_limit = top_limit;
+		this->bottom_limit = bottom_limit;
+		this->sustain = sustain;
+		this->release = release;
+	}
+
+	const std::array<double, 2> ReferenceEnvelope::update(const double top_peak, const double bottom_peak)
+	{
+		recent.push_back({ top_peak, bottom_peak });
+		if (recent.size() > static_cast<size_t>(sustain) + 1u)
+		{
+			recent.erase(recent.begin());
+		}
+
+		auto held_top = top_peak;
+		auto held_bottom = bottom_peak;
+		for (const auto& [top, bottom] : recent)
+		{
+			held_top = std::max(held_top, top);
+			held_bottom = std::min(held_bottom, bottom);
+		}
+
+		auto wrapped_top = held_top;
+		if (ongoing_top_peak == held_top)
+		{
+			top_peak_duration = 0.0;
+		}
+		else
+		{
+			top_peak_duration++;
+			const auto released = -(ongoing_top_peak - bottom_limit) / release * top_peak_duration + ongoing_top_peak;
+			if (held_top >= released)
+			{
+				ongoing_top_peak = held_top;
+				top_peak_duration = 0.0;
+			}
+			else
+			{
+				wrapped_top = released;
+			}
+		}
+
+		auto wrapped_bottom = held_bottom;
+		if (ongoing_bottom_peak == held_bottom)
+		{
+			bottom_peak_duration = 0.0;
+		}
+		else
+		{
+			bottom_peak_duration++;
+			const auto released = -(ongoing_bottom_peak - top_limit) / release * bottom_peak_duration + ongoing_bottom_peak;
+			if (held_bottom <= released)
+			{
+				ongoing_bottom_peak = held_bottom;
+				bottom_peak_duration = 0.0;
+			}
+			else
+			{
+				wrapped_bottom = released;
+			}
+		}
+
+		return { wrapped_top, wrapped_bottom };
+	}
+
+	const void ReferenceEnvelope::reset() noexcept
+	{
+		recent.clear();
+		ongoing_top_peak = 0.0;
+		top_peak_duration = 0.0;
+		ongoing_bottom_peak = 0.0;
+		bottom_peak_duration = 0.0;
+	}
+
+	ReferenceLimiter::ReferenceLimiter(const Parameters& parameters)
+	{
+		envelope.configure(parameters.top_limit, parameters.bottom_limit, parameters.sustain, parameters.release);
+	}
+
+	// Calls f with the clamped limiter curve for enveloped.
+	template<typename F>
+	static inline const void visit_limit(const Parameters& parameters, const std::array<double, 2>& enveloped, const F& f)
+	{
+		const auto key = limiter_key(parameters, enveloped[0], enveloped[1]);
+		const auto [xs, ys] = make_some_charactors(
+			key.top_limit, key.top_threshold,
+			key.bottom_limit, key.bottom_threshold,
+			key.top_peak, key.bottom_peak);
+		std::visit([&](const auto& character) {
+			f(make_limit(character, key.top_limit, key.bottom_limit));
+			}, make_curve(key.mode, xs, ys));
+	}
+
+	const std::array<double, 2> ReferenceLimiter::process(const Parameters& parameters, AviUtl::PixelYC* const pixels, const uint32_t width, const uint32_t height, const uint32_t stride)
+	{
+		auto buffer = Buffer<double>(width, height, stride, ScratchPool::global());
+		buffer.fetch_image(width, height, pixels);
+
+		const auto enveloped = envelope.update(buffer.maximum(), buffer.minimum());
+		visit_limit(parameters, enveloped, [&](const auto& limit) {
+			buffer.pixelwise_map([&](const double y) { return limit(y); });
+			});
+		buffer.render(width, height, pixels);
+		return enveloped;
+	}
+
+	const int16_t ReferenceLimiter::map_y(const Parameters& parameters, const std::array<double, 2>& enveloped, const int16_t y)
+	{
+		auto mapped = int16_t{ 0 };
+		visit_limit(parameters, enveloped, [&](const auto& limit) {
+			mapped = Luminance::quantize_y(Luminance::denormalize_y(limit(Luminance::normalize_y(y))));
+			});
+		return mapped;
+	}
+
+	const void ReferenceLimiter::reset() noexcept
+	{
+		envelope.reset();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "aviutl/filter.hpp"
+#include "parameters.h"
+
+
+namespace luminance_limiter_sg
+{
+	// The envelope as written before the ring queues: the held peaks are a plain scan
+	// of the raw peaks of the last sustain + 1 frames, released linearly toward the
+	// opposite limit. PeakEnvelopeGenerator must give the same peaks.
+	class ReferenceEnvelope
+	{
+	public:
+		const void configure(const double top_limit, const double bottom_limit, const uint32_t sustain, const double release);
+		const std::array<double, 2> update(const double top_peak, const double bottom_peak);
+		const void reset() noexcept;
+	private:
+		std::vector<std::array<double, 2>> recent;
+		uint32_t sustain = 0u;
+		double release = 0.0;
+		double top_limit = 0.0;
+		double bottom_limit = 0.0;
+		double ongoing_top_peak = 0.0;
+		double top_peak_duration = 0.0;
+		double ongoing_bottom_peak = 0.0;
+		double bottom_peak_duration = 0.0;
+	};
+
+	// The global limiter as the filter ran it before the transfer tables: Y is staged in
+	// a Buffer<double>, measured, and mapped through the clamped curve by pixelwise_map,
+	// without tables or bands. Kept as the definition the optimized paths are checked
+	// against, not for use in the filter. Percentile peaks, the look-ahead and the tiled
+	// mode are not modelled.
+	class ReferenceLimiter
+	{
+	public:
+		ReferenceLimiter(const Parameters& parameters);
+
+		// Limits the width x height pixels, rows stride apart, of the frame following
+		// the last one processed, and returns the enveloped peaks its curve was made for.
+		const std::array<double, 2> process(const Parameters& parameters, AviUtl::PixelYC* const pixels, const uint32_t width, const uint32_t height, const uint32_t stride);
+		// Y the curve for enveloped maps y to, as process renders it.
+		static const int16_t map_y(const Parameters& parameters, const std::array<double, 2>& enveloped, const int16_t y);
+		const void reset() noexcept;
+	private:
+		ReferenceEnvelope envelope;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,117 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace luminance_limiter_sg
+{
+	// Double-ended queue over storage allocated once by reserve.
+	// Pushing beyond capacity is a caller error.
+	template<typename T>
+	class RingBuffer
+	{
+	public:
+		RingBuffer() noexcept = default;
+
+		inline const void reserve(const size_t capacity)
+		{
+			if (capacity <= slots.size())
+			{
+				return;
+			}
+
+			auto grown = std::vector<T>(capacity);
+			for (auto i = size_t{ 0 }; i < count; ++i)
+			{
+				grown[i] = (*this)[i];
+			}
+			slots = std::move(grown);
+			head = 0;
+		}
+
+		inline const size_t capacity() const noexcept
+		{
+			return slots.size();
+		}
+
+		inline const size_t size() const noexcept
+		{
+			return count;
+		}
+
+		inline const bool empty() const noexcept
+		{
+			return count == 0;
+		}
+
+		inline const void clear() noexcept
+		{
+			head = 0;
+			count = 0;
+		}
+
+		inline const void push_back(const T& value) noexcept
+		{
+			slots[wrap(head + count)] = value;
+			count++;
+		}
+
+		inline const void pop_back() noexcept
+		{
+			count--;
+		}
+
+		inline const void pop_front() noexcept
+		{
+			head = wrap(head + 1);
+			count--;
+		}
+
+		inline T& front() noexcept
+		{
+			return slots[head];
+		}
+
+		inline const T& front() const noexcept
+		{
+			return slots[head];
+		}
+
+		inline T& back() noexcept
+		{
+			return slots[wrap(head + count - 1)];
+		}
+
+		inline const T& back() const noexcept
+		{
+			return slots[wrap(head + count - 1)];
+		}
+
+		inline T& operator[](const size_t i) noexcept
+		{
+			return slots[wrap(head + i)];
+		}
+
+		inline const T& operator[](const size_t i) const noexcept
+		{
+			return slots[wrap(head + i)];
+		}
+	private:
+		std::vector<T> slots;
+		size_t head = 0;
+		size_t count = 0;
+
+		inline const size_t wrap(const size_t i) const noexcept
+		{
+			return i < slots.size() ? i : i - slots.size();
+		}
+	};
+}
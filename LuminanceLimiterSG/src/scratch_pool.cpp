@@ -0,0 +1,184 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#include "scratch_pool.h"
+
+#include <bit>
+#include <new>
+
+
+namespace luminance_limiter_sg
+{
+	constexpr static inline auto block_octave = static_cast<uint32_t>(std::bit_width(ScratchPool::min_block)) - 1u;
+
+	ScratchPool::Block::Block(Block&& other) noexcept
+		: pool(other.pool), bytes(other.bytes), size_class(other.size_class)
+	{
+		other.pool = nullptr;
+		other.bytes = nullptr;
+	}
+
+	ScratchPool::Block& ScratchPool::Block::operator=(Block&& other) noexcept
+	{
+		if (this != &other)
+		{
+			if (bytes)
+			{
+				pool->give_back(bytes, size_class);
+			}
+			pool = other.pool;
+			bytes = other.bytes;
+			size_class = other.size_class;
+			other.pool = nullptr;
+			other.bytes = nullptr;
+		}
+		return *this;
+	}
+
+	ScratchPool::Block::~Block()
+	{
+		if (bytes)
+		{
+			pool->give_back(bytes, size_class);
+		}
+	}
+
+	const size_t ScratchPool::Block::size() const noexcept
+	{
+		return bytes ? class_size(size_class) : 0u;
+	}
+
+	ScratchPool::ScratchPool(const Clock::duration idle) noexcept
+		: idle(idle)
+	{
+	}
+
+	ScratchPool::~ScratchPool()
+	{
+		release_all();
+	}
+
+	ScratchPool::Block ScratchPool::acquire(const size_t bytes)
+	{
+		const auto size_class = class_of(bytes);
+		if (size_class >= class_count)
+		{
+			throw std::bad_alloc();
+		}
+
+		auto block = Block();
+		block.pool = this;
+		block.size_class = size_class;
+		{
+			std::lock_guard lock(mutex);
+			auto& free = returned[size_class];
+			if (!free.empty())
+			{
+				block.bytes = free.back().bytes;
+				free.pop_back();
+				idle_total -= class_size(size_class);
+				return block;
+			}
+		}
+
+		block.bytes = static_cast<std::byte*>(::operator new(class_size(size_class), std::align_val_t{ alignment }));
+		std::lock_guard lock(mutex);
+		reserved += class_size(size_class);
+		return block;
+	}
+
+	const void ScratchPool::release_idle() noexcept
+	{
+		const auto now = Clock::now();
+		std::lock_guard lock(mutex);
+		for (auto size_class = 0u; size_class < class_count; ++size_class)
+		{
+			auto& free = returned[size_class];
+			// Returned blocks are pushed in time order, so the stale ones lead.
+			auto kept = free.begin();
+			while (kept != free.end() && now - kept->since >= idle)
+			{
+				::operator delete(kept->bytes, std::align_val_t{ alignment });
+				++kept;
+			}
+			const auto freed = static_cast<size_t>(kept - free.begin()) * class_size(size_class);
+			reserved -= freed;
+			idle_total -= freed;
+			free.erase(free.begin(), kept);
+		}
+	}
+
+	const void ScratchPool::release_all() noexcept
+	{
+		std::lock_guard lock(mutex);
+		for (auto size_class = 0u; size_class < class_count; ++size_class)
+		{
+			auto& free = returned[size_class];
+			for (const auto& block : free)
+			{
+				::operator delete(block.bytes, std::align_val_t{ alignment });
+			}
+			reserved -= free.size() * class_size(size_class);
+			free.clear();
+			free.shrink_to_fit();
+		}
+		idle_total = 0;
+	}
+
+	const size_t ScratchPool::reserved_bytes() const noexcept
+	{
+		std::lock_guard lock(mutex);
+		return reserved;
+	}
+
+	const size_t ScratchPool::idle_bytes() const noexcept
+	{
+		std::lock_guard lock(mutex);
+		return idle_total;
+	}
+
+	ScratchPool& ScratchPool::global() noexcept
+	{
+		static auto pool = ScratchPool();
+		return pool;
+	}
+
+	const uint32_t ScratchPool::class_of(const size_t bytes) noexcept
+	{
+		if (bytes <= min_block)
+		{
+			return 0u;
+		}
+		const auto last = static_cast<uint64_t>(bytes - 1u);
+		const auto octave = static_cast<uint32_t>(std::bit_width(last)) - 1u;
+		const auto leading = static_cast<uint32_t>(last >> (octave - 2u));
+		return leading == 7u
+			? (octave + 1u - block_octave) * classes_per_octave
+			: (octave - block_octave) * classes_per_octave + leading - 3u;
+	}
+
+	const size_t ScratchPool::class_size(const uint32_t size_class) noexcept
+	{
+		return static_cast<size_t>(classes_per_octave + size_class % classes_per_octave) << (size_class / classes_per_octave + block_octave - 2u);
+	}
+
+	const void ScratchPool::give_back(std::byte* const bytes, const uint32_t size_class) noexcept
+	{
+		std::lock_guard lock(mutex);
+		try
+		{
+			returned[size_class].push_back(Idle{ bytes, Clock::now() });
+			idle_total += class_size(size_class);
+		}
+		catch (const std::bad_alloc&)
+		{
+			::operator delete(bytes, std::align_val_t{ alignment });
+			reserved -= class_size(size_class);
+		}
+	}
+}
\ No newline at end of file
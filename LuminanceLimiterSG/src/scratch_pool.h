@@ -0,0 +1,96 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace luminance_limiter_sg
+{
+	// 64-byte aligned blocks for per-frame temporaries, handed out by size class.
+	// A returned block is reused by the next request of its class; blocks that stay
+	// unused for longer than the idle period are freed by release_idle, so the memory
+	// held follows the frames being processed rather than the largest one seen.
+	// Every acquire gives an independent block and may be called from any thread.
+	class ScratchPool
+	{
+	public:
+		constexpr static inline size_t alignment = 64u;
+		// Four classes per octave from min_block up; a block wastes at most a quarter.
+		constexpr static inline size_t min_block = 4096u;
+		constexpr static inline uint32_t classes_per_octave = 4u;
+		constexpr static inline uint32_t class_count = classes_per_octave * 40u;
+
+		using Clock = std::chrono::steady_clock;
+
+		// Lease of one block, returned to its pool on destruction.
+		class Block
+		{
+		public:
+			Block() noexcept = default;
+			Block(Block&& other) noexcept;
+			Block& operator=(Block&& other) noexcept;
+			Block(const Block&) = delete;
+			Block& operator=(const Block&) = delete;
+			~Block();
+
+			template<typename T>
+			inline T* as() const noexcept
+			{
+				return reinterpret_cast<T*>(bytes);
+			}
+
+			const size_t size() const noexcept;
+		private:
+			friend class ScratchPool;
+
+			ScratchPool* pool = nullptr;
+			std::byte* bytes = nullptr;
+			uint32_t size_class = 0;
+		};
+
+		explicit ScratchPool(const Clock::duration idle = std::chrono::seconds(30)) noexcept;
+		ScratchPool(const ScratchPool&) = delete;
+		ScratchPool& operator=(const ScratchPool&) = delete;
+		// Blocks still leased must not outlive the pool.
+		~ScratchPool();
+
+		Block acquire(const size_t bytes);
+		// Frees the returned blocks no one has asked for within the idle period.
+		const void release_idle() noexcept;
+		const void release_all() noexcept;
+
+		// Bytes allocated from the system, leased or not, and the part not leased.
+		const size_t reserved_bytes() const noexcept;
+		const size_t idle_bytes() const noexcept;
+
+		static ScratchPool& global() noexcept;
+
+		static const uint32_t class_of(const size_t bytes) noexcept;
+		static const size_t class_size(const uint32_t size_class) noexcept;
+	private:
+		struct Idle
+		{
+			std::byte* bytes = nullptr;
+			Clock::time_point since;
+		};
+
+		mutable std::mutex mutex;
+		Clock::duration idle;
+		std::array<std::vector<Idle>, class_count> returned;
+		size_t reserved = 0;
+		size_t idle_total = 0;
+
+		const void give_back(std::byte* const bytes, const uint32_t size_class) noexcept;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+
+namespace luminance_limiter_sg
+{
+	// Bounded queue between exactly one producer and one consumer thread, without
+	// locks. Each side only writes its own index, so a push or a pop is a copy and one
+	// release store. N must be a power of two.
+	template<typename T, size_t N>
+	class SpscRing
+	{
+		static_assert(N != 0u && (N & (N - 1u)) == 0u, "N must be a power of two.");
+		static_assert(std::is_trivially_copyable_v<T>);
+	public:
+		constexpr static inline size_t capacity = N;
+
+		// Producer side; false when the ring is full.
+		inline const bool try_push(const T& value) noexcept
+		{
+			const auto tail = write.load(std::memory_order_relaxed);
+			if (tail - cached_read == N)
+			{
+				cached_read = read.load(std::memory_order_acquire);
+				if (tail - cached_read == N)
+				{
+					return false;
+				}
+			}
+			slots[tail & (N - 1u)] = value;
+			write.store(tail + 1u, std::memory_order_release);
+			return true;
+		}
+
+		// Consumer side; false when the ring is empty.
+		inline const bool try_pop(T& value) noexcept
+		{
+			const auto head = read.load(std::memory_order_relaxed);
+			if (head == cached_write)
+			{
+				cached_write = write.load(std::memory_order_acquire);
+				if (head == cached_write)
+				{
+					return false;
+				}
+			}
+			value = slots[head & (N - 1u)];
+			read.store(head + 1u, std::memory_order_release);
+			return true;
+		}
+	private:
+		// The indices and each side's copy of the other one sit on separate cache lines.
+		alignas(64) std::atomic<size_t> write = 0u;
+		size_t cached_read = 0u;
+		alignas(64) std::atomic<size_t> read = 0u;
+		size_t cached_write = 0u;
+		alignas(64) std::array<T, N> slots = {};
+	};
+}
\ No newline at end of file
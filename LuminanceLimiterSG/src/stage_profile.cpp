@@ -0,0 +1,159 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#include "stage_profile.h"
+
+#include <bit>
+#include <fstream>
+
+
+namespace luminance_limiter_sg
+{
+	const size_t LatencyHistogram::bucket_of(const uint64_t nanoseconds) noexcept
+	{
+		if (nanoseconds < (uint64_t{ 1 } << min_octave))
+		{
+			return 0u;
+		}
+		const auto octave = static_cast<uint32_t>(std::bit_width(nanoseconds)) - 1u;
+		if (octave >= min_octave + octaves)
+		{
+			return bucket_count - 1u;
+		}
+		const auto sub = static_cast<uint32_t>(nanoseconds >> (octave - 3u)) & (sub_buckets - 1u);
+		return 1u + static_cast<size_t>(octave - min_octave) * sub_buckets + sub;
+	}
+
+	const uint64_t LatencyHistogram::upper_edge(const size_t bucket) noexcept
+	{
+		if (bucket == 0u)
+		{
+			return uint64_t{ 1 } << min_octave;
+		}
+		if (bucket >= bucket_count - 1u)
+		{
+			return UINT64_MAX;
+		}
+		const auto octave = min_octave + static_cast<uint32_t>((bucket - 1u) / sub_buckets);
+		const auto sub = static_cast<uint64_t>((bucket - 1u) % sub_buckets);
+		return (uint64_t{ 1 } << octave) + ((sub + 1u) << (octave - 3u));
+	}
+
+	const void LatencyHistogram::record(const uint64_t nanoseconds) noexcept
+	{
+		buckets[bucket_of(nanoseconds)].fetch_add(1u, std::memory_order_relaxed);
+		count.fetch_add(1u, std::memory_order_relaxed);
+		total.fetch_add(nanoseconds, std::memory_order_relaxed);
+		auto seen = maximum.load(std::memory_order_relaxed);
+		while (seen < nanoseconds && !maximum.compare_exchange_weak(seen, nanoseconds, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	const void LatencyHistogram::clear() noexcept
+	{
+		for (auto&& bucket : buckets)
+		{
+			bucket.store(0u, std::memory_order_relaxed);
+		}
+		count.store(0u, std::memory_order_relaxed);
+		total.store(0u, std::memory_order_relaxed);
+		maximum.store(0u, std::memory_order_relaxed);
+	}
+
+	const uint64_t LatencyHistogram::percentile(const double fraction) const noexcept
+	{
+		auto samples = uint64_t{ 0 };
+		for (const auto& bucket : buckets)
+		{
+			samples += bucket.load(std::memory_order_relaxed);
+		}
+		if (samples == 0u)
+		{
+			return 0u;
+		}
+
+		const auto rank = static_cast<uint64_t>(fraction * static_cast<double>(samples - 1u)) + 1u;
+		auto seen = uint64_t{ 0 };
+		for (auto i = size_t{ 0 }; i < bucket_count; ++i)
+		{
+			seen += buckets[i].load(std::memory_order_relaxed);
+			if (seen >= rank)
+			{
+				const auto edge = upper_edge(i);
+				const auto max = maximum.load(std::memory_order_relaxed);
+				return edge < max ? edge : max;
+			}
+		}
+		return maximum.load(std::memory_order_relaxed);
+	}
+
+	const LatencyHistogram::Summary LatencyHistogram::summary() const noexcept
+	{
+		const auto samples = count.load(std::memory_order_relaxed);
+		return Summary{
+			samples,
+			samples ? static_cast<double>(total.load(std::memory_order_relaxed)) / static_cast<double>(samples) : 0.0,
+			percentile(0.50),
+			percentile(0.95),
+			percentile(0.99),
+			maximum.load(std::memory_order_relaxed) };
+	}
+
+	StageProfile& StageProfile::global() noexcept
+	{
+		static StageProfile profile;
+		return profile;
+	}
+
+	const LatencyHistogram::Summary StageProfile::summary(const Stage stage) const noexcept
+	{
+		return stages[static_cast<size_t>(stage)].summary();
+	}
+
+	const void StageProfile::clear() noexcept
+	{
+		for (auto&& stage : stages)
+		{
+			stage.clear();
+		}
+	}
+
+	const void StageProfile::write(std::ostream& out) const
+	{
+		out << "{\n\t\"unit\": \"ns\",\n\t\"stages\": {\n";
+		for (auto i = size_t{ 0 }; i < stage_count; ++i)
+		{
+			const auto summary = stages[i].summary();
+			out << "\t\t\"" << stage_name(static_cast<Stage>(i)) << "\": { "
+				<< "\"count\": " << summary.count
+				<< ", \"mean\": " << summary.mean
+				<< ", \"p50\": " << summary.p50
+				<< ", \"p95\": " << summary.p95
+				<< ", \"p99\": " << summary.p99
+				<< ", \"max\": " << summary.max
+				<< " }" << (i + 1u < stage_count ? "," : "") << "\n";
+		}
+		out << "\t}\n}\n";
+	}
+
+	const bool StageProfile::dump(const std::filesystem::path& path) const
+	{
+		if (summary(Stage::Frame).count == 0u)
+		{
+			return false;
+		}
+		auto file = std::ofstream(path);
+		if (!file)
+		{
+			return false;
+		}
+		write(file);
+		return static_cast<bool>(file);
+	}
+}
@@ -0,0 +1,154 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+
+
+namespace luminance_limiter_sg
+{
+	enum class Stage : int32_t
+	{
+		Init,
+		Gc,
+		Seek,
+		Reduce,
+		Envelope,
+		Curve,
+		Fetch,
+		Apply,
+		Frame,
+		Count
+	};
+
+	constexpr static inline auto stage_count = static_cast<size_t>(Stage::Count);
+
+	constexpr static inline auto stage_name(const Stage stage) noexcept
+	{
+		switch (stage)
+		{
+		case Stage::Init:
+			return "init";
+		case Stage::Gc:
+			return "gc";
+		case Stage::Seek:
+			return "seek";
+		case Stage::Reduce:
+			return "reduce";
+		case Stage::Envelope:
+			return "envelope";
+		case Stage::Curve:
+			return "curve";
+		case Stage::Fetch:
+			return "fetch";
+		case Stage::Apply:
+			return "apply";
+		case Stage::Frame:
+			return "frame";
+		default:
+			return "";
+		}
+	}
+
+	// Latency histogram with 8 buckets per power of two between 64 ns and about 68 s,
+	// so a percentile is off by at most 1/8 of an octave. Recording is wait-free.
+	class LatencyHistogram
+	{
+	public:
+		constexpr static inline uint32_t sub_buckets = 8u;
+		constexpr static inline uint32_t min_octave = 6u;
+		constexpr static inline uint32_t octaves = 30u;
+		constexpr static inline size_t bucket_count = static_cast<size_t>(octaves) * sub_buckets + 2u;
+
+		struct Summary
+		{
+			uint64_t count = 0;
+			double mean = 0.0;
+			uint64_t p50 = 0;
+			uint64_t p95 = 0;
+			uint64_t p99 = 0;
+			uint64_t max = 0;
+		};
+
+		const void record(const uint64_t nanoseconds) noexcept;
+		const void clear() noexcept;
+		// Upper edge of the bucket holding the given fraction of the samples, in ns.
+		const uint64_t percentile(const double fraction) const noexcept;
+		const Summary summary() const noexcept;
+
+		static const size_t bucket_of(const uint64_t nanoseconds) noexcept;
+		static const uint64_t upper_edge(const size_t bucket) noexcept;
+	private:
+		std::array<std::atomic<uint64_t>, bucket_count> buckets{};
+		std::atomic<uint64_t> count{ 0 };
+		std::atomic<uint64_t> total{ 0 };
+		std::atomic<uint64_t> maximum{ 0 };
+	};
+
+	// Per stage latencies of every frame the filter processed. The timers feeding it
+	// only exist in builds with LUMINANCE_LIMITER_SG_PROFILE defined.
+	class StageProfile
+	{
+	public:
+		static StageProfile& global() noexcept;
+
+		inline const void record(const Stage stage, const uint64_t nanoseconds) noexcept
+		{
+			stages[static_cast<size_t>(stage)].record(nanoseconds);
+		}
+
+		const LatencyHistogram::Summary summary(const Stage stage) const noexcept;
+		const void clear() noexcept;
+
+		const void write(std::ostream& out) const;
+		// Writes the JSON summary to path; false when nothing was recorded or the file
+		// cannot be written.
+		const bool dump(const std::filesystem::path& path) const;
+	private:
+		std::array<LatencyHistogram, stage_count> stages;
+	};
+
+	class ScopedStageTimer
+	{
+	public:
+		explicit ScopedStageTimer(const Stage stage) noexcept
+			: stage(stage), begin(std::chrono::steady_clock::now())
+		{
+		}
+
+		~ScopedStageTimer()
+		{
+			const auto elapsed = std::chrono::steady_clock::now() - begin;
+			StageProfile::global().record(stage, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+		}
+
+		ScopedStageTimer(const ScopedStageTimer&) = delete;
+		ScopedStageTimer& operator=(const ScopedStageTimer&) = delete;
+	private:
+		Stage stage;
+		std::chrono::steady_clock::time_point begin;
+	};
+}
+
+#define LUMINANCE_LIMITER_SG_CONCAT_IMPL(a, b) a##b
+#define LUMINANCE_LIMITER_SG_CONCAT(a, b) LUMINANCE_LIMITER_SG_CONCAT_IMPL(a, b)
+
+// Times the rest of the enclosing scope as stage. Expands to nothing unless the
+// build defines LUMINANCE_LIMITER_SG_PROFILE.
+#if defined(LUMINANCE_LIMITER_SG_PROFILE)
+#define LUMINANCE_LIMITER_SG_TIME_STAGE(stage) \
+	const auto LUMINANCE_LIMITER_SG_CONCAT(stage_timer_, __LINE__) = ::luminance_limiter_sg::ScopedStageTimer(stage)
+#else
+#define LUMINANCE_LIMITER_SG_TIME_STAGE(stage) static_cast<void>(0)
+#endif
@@ -0,0 +1,208 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#include "telemetry.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+
+namespace luminance_limiter_sg
+{
+	constexpr static inline auto drain_interval = std::chrono::milliseconds(10);
+
+	using RecordBytes = std::array<char, TelemetryLog::record_bytes>;
+
+	template<typename T>
+	static inline char* put(char* out, const T& value) noexcept
+	{
+		std::memcpy(out, &value, sizeof(value));
+		return out + sizeof(value);
+	}
+
+	template<typename T>
+	static inline const char* get(const char* in, T& value) noexcept
+	{
+		std::memcpy(&value, in, sizeof(value));
+		return in + sizeof(value);
+	}
+
+	static inline const RecordBytes encode(const FrameRecord& record) noexcept
+	{
+		auto bytes = RecordBytes();
+		auto* out = bytes.data();
+		out = put(out, record.frame);
+		out = put(out, record.effector_id);
+		out = put(out, record.clip);
+		out = put(out, record.modified);
+		out = put(out, static_cast<int32_t>(record.mode));
+		out = put(out, record.raw);
+		out = put(out, record.held);
+		out = put(out, record.wrapped);
+		out = put(out, record.xs);
+		put(out, record.ys);
+		return bytes;
+	}
+
+	static inline const FrameRecord decode(const RecordBytes& bytes) noexcept
+	{
+		auto record = FrameRecord();
+		auto mode = int32_t{ 0 };
+		const auto* in = bytes.data();
+		in = get(in, record.frame);
+		in = get(in, record.effector_id);
+		in = get(in, record.clip);
+		in = get(in, record.modified);
+		in = get(in, mode);
+		in = get(in, record.raw);
+		in = get(in, record.held);
+		in = get(in, record.wrapped);
+		in = get(in, record.xs);
+		get(in, record.ys);
+		record.mode = static_cast<InterpolationMode>(mode);
+		return record;
+	}
+
+	TelemetryLog& TelemetryLog::global() noexcept
+	{
+		static TelemetryLog log;
+		return log;
+	}
+
+	TelemetryLog::~TelemetryLog()
+	{
+		close();
+	}
+
+	const bool TelemetryLog::open(const std::filesystem::path& path, const TelemetryFormat format)
+	{
+		close();
+
+		file = std::ofstream(path, format == TelemetryFormat::Binary ? std::ios::binary : std::ios::out);
+		if (!file)
+		{
+			return false;
+		}
+		this->format = format;
+		file.precision(9);
+		if (format == TelemetryFormat::Binary)
+		{
+			const auto record_size = static_cast<uint32_t>(record_bytes);
+			file.write(magic.data(), magic.size());
+			file.write(reinterpret_cast<const char*>(&record_size), sizeof(record_size));
+		}
+		else
+		{
+			write_csv_header(file);
+		}
+
+		// Records pushed after the last log was closed belong to no log.
+		auto stale = FrameRecord();
+		while (ring.try_pop(stale))
+		{
+		}
+		dropped_records.store(0u, std::memory_order_relaxed);
+
+		running.store(true, std::memory_order_relaxed);
+		writer = std::thread([this]() {
+			while (running.load(std::memory_order_relaxed))
+			{
+				drain();
+				std::this_thread::sleep_for(drain_interval);
+			}
+			});
+		return true;
+	}
+
+	const void TelemetryLog::close()
+	{
+		if (!writer.joinable())
+		{
+			return;
+		}
+		running.store(false, std::memory_order_relaxed);
+		writer.join();
+		drain();
+		file.close();
+	}
+
+	const uint64_t TelemetryLog::dropped() const noexcept
+	{
+		return dropped_records.load(std::memory_order_relaxed);
+	}
+
+	const void TelemetryLog::drain()
+	{
+		auto record = FrameRecord();
+		while (ring.try_pop(record))
+		{
+			if (format == TelemetryFormat::Binary)
+			{
+				const auto bytes = encode(record);
+				file.write(bytes.data(), bytes.size());
+			}
+			else
+			{
+				write_csv(file, record);
+			}
+		}
+		file.flush();
+	}
+
+	const void TelemetryLog::write_csv_header(std::ostream& out)
+	{
+		out << "frame,effector,clip,modified,mode,"
+			<< "raw_top,raw_bottom,held_top,held_bottom,wrapped_top,wrapped_bottom,"
+			<< "x0,x1,x2,x3,y0,y1,y2,y3\n";
+	}
+
+	const void TelemetryLog::write_csv(std::ostream& out, const FrameRecord& record)
+	{
+		// An unknown fraction is left empty.
+		out << record.frame << ',' << record.effector_id << ',' << record.clip << ',';
+		if (!std::isnan(record.modified))
+		{
+			out << record.modified;
+		}
+		out << ',' << static_cast<int32_t>(record.mode);
+		for (const auto& pair : { record.raw, record.held, record.wrapped })
+		{
+			out << ',' << pair[0] << ',' << pair[1];
+		}
+		for (const auto& knots : { record.xs, record.ys })
+		{
+			for (const auto knot : knots)
+			{
+				out << ',' << knot;
+			}
+		}
+		out << '\n';
+	}
+
+	const std::optional<std::vector<FrameRecord>> TelemetryLog::read(const std::filesystem::path& path)
+	{
+		auto file = std::ifstream(path, std::ios::binary);
+		auto header = std::array<char, magic.size()>();
+		auto record_size = uint32_t{ 0 };
+		if (!file.read(header.data(), header.size())
+			|| !file.read(reinterpret_cast<char*>(&record_size), sizeof(record_size))
+			|| header != magic || record_size != record_bytes)
+		{
+			return std::nullopt;
+		}
+
+		auto records = std::vector<FrameRecord>();
+		auto bytes = RecordBytes();
+		while (file.read(bytes.data(), bytes.size()))
+		{
+			records.push_back(decode(bytes));
+		}
+		return records;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,108 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#include "interpolation.h"
+#include "spsc_ring.h"
+
+
+namespace luminance_limiter_sg
+{
+	// What the limiter did on one frame. Peaks and knots are normalized Y.
+	struct FrameRecord
+	{
+		int32_t frame = 0;
+		uint32_t effector_id = 0;
+		// Hash of the source path, or 0 when it is not known.
+		uint64_t clip = 0;
+		// Fraction of the pixels in the frame's histogram whose Y the table changes, or
+		// NaN when the frame was not counted: only percentile instances count it anyway.
+		double modified = std::numeric_limits<double>::quiet_NaN();
+		InterpolationMode mode = InterpolationMode::Linear;
+		std::array<double, 2> raw = {};
+		std::array<double, 2> held = {};
+		std::array<double, 2> wrapped = {};
+		Knots<4> xs = {};
+		Knots<4> ys = {};
+	};
+
+	enum class TelemetryFormat : int32_t
+	{
+		Binary,
+		Csv
+	};
+
+	// Per-frame records on their way from the rendering thread to a log file. push
+	// copies the record into a SpscRing and never waits; a writer thread drains it.
+	// Records are dropped and counted when the writer falls a whole ring behind.
+	// Only one thread may push at a time.
+	class TelemetryLog
+	{
+	public:
+		constexpr static inline size_t ring_size = 4096u;
+		// Leads the binary log, followed by record_bytes as a uint32_t and the records.
+		constexpr static inline std::array<char, 8> magic = { 'L', 'L', 'S', 'G', 'T', 'L', 'M', '2' };
+		// A record in the binary log: the fields of FrameRecord in order, in the byte
+		// order of the machine, without the padding between them.
+		constexpr static inline size_t record_bytes = sizeof(int32_t) + sizeof(uint32_t) + sizeof(uint64_t)
+			+ sizeof(double) + sizeof(int32_t) + 3u * sizeof(std::array<double, 2>) + 2u * sizeof(Knots<4>);
+
+		static TelemetryLog& global() noexcept;
+
+		TelemetryLog() = default;
+		TelemetryLog(const TelemetryLog&) = delete;
+		TelemetryLog& operator=(const TelemetryLog&) = delete;
+		~TelemetryLog();
+
+		// Starts the writer; false when the file cannot be written. Closes any log open.
+		const bool open(const std::filesystem::path& path, const TelemetryFormat format);
+		// Writes what is left in the ring and stops the writer.
+		const void close();
+
+		inline const bool enabled() const noexcept
+		{
+			return running.load(std::memory_order_relaxed);
+		}
+
+		inline const void push(const FrameRecord& record) noexcept
+		{
+			if (!ring.try_push(record))
+			{
+				dropped_records.fetch_add(1u, std::memory_order_relaxed);
+			}
+		}
+
+		const uint64_t dropped() const noexcept;
+
+		static const void write_csv_header(std::ostream& out);
+		static const void write_csv(std::ostream& out, const FrameRecord& record);
+		// Every record of a binary log, or nothing when path is not one.
+		static const std::optional<std::vector<FrameRecord>> read(const std::filesystem::path& path);
+	private:
+		SpscRing<FrameRecord, ring_size> ring;
+		std::atomic<bool> running = false;
+		std::atomic<uint64_t> dropped_records = 0u;
+		std::thread writer;
+		std::ofstream file;
+		TelemetryFormat format = TelemetryFormat::Binary;
+
+		const void drain();
+	};
+}
\ No newline at end of file
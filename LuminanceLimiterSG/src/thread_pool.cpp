@@ -0,0 +1,145 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#include "executor.h"
+
+
+namespace luminance_limiter_sg
+{
+	ThreadPool::ThreadPool(const uint32_t threads)
+	{
+		// The calling thread takes part in every job and owns the last range.
+		const auto worker_count = threads > 1u ? threads - 1u : 0u;
+		for (auto i = 0u; i <= worker_count; ++i)
+		{
+			ranges.emplace_back(std::make_unique<Range>());
+		}
+		for (auto i = 0u; i < worker_count; ++i)
+		{
+			workers.emplace_back([this, i]() { work(i); });
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (auto&& worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	uint32_t ThreadPool::concurrency() const noexcept
+	{
+		return static_cast<uint32_t>(ranges.size());
+	}
+
+	const void ThreadPool::run(Job&& job)
+	{
+		if (job.remaining == 0)
+		{
+			return;
+		}
+
+		std::lock_guard submit_lock(submit_mutex);
+
+		const auto count = job.remaining.load();
+		const auto n = ranges.size();
+		for (auto i = 0u; i < n; ++i)
+		{
+			std::lock_guard lock(ranges[i]->mutex);
+			ranges[i]->job = &job;
+			ranges[i]->begin = static_cast<uint32_t>(static_cast<uint64_t>(count) * i / n);
+			ranges[i]->end = static_cast<uint32_t>(static_cast<uint64_t>(count) * (i + 1) / n);
+		}
+
+		{
+			std::lock_guard lock(mutex);
+			generation++;
+		}
+		wake.notify_all();
+
+		const auto self = n - 1;
+		while (run_one(self))
+		{
+		}
+
+		std::unique_lock lock(mutex);
+		done.wait(lock, [&]() { return job.remaining.load() == 0; });
+	}
+
+	const bool ThreadPool::run_one(const size_t self)
+	{
+		Job* job = nullptr;
+		uint32_t index = 0;
+
+		{
+			auto& own = *ranges[self];
+			std::lock_guard lock(own.mutex);
+			if (own.begin < own.end)
+			{
+				job = own.job;
+				index = own.begin++;
+			}
+		}
+
+		for (auto offset = 1u; !job && offset < ranges.size(); ++offset)
+		{
+			auto& victim = *ranges[(self + offset) % ranges.size()];
+			std::scoped_lock lock(victim.mutex, ranges[self]->mutex);
+			if (victim.begin < victim.end)
+			{
+				const auto middle = victim.begin + (victim.end - victim.begin) / 2;
+				job = victim.job;
+				index = middle;
+				ranges[self]->job = victim.job;
+				ranges[self]->begin = middle + 1;
+				ranges[self]->end = victim.end;
+				victim.end = middle;
+			}
+		}
+
+		if (!job)
+		{
+			return false;
+		}
+
+		job->invoke(job->context, index);
+		if (job->remaining.fetch_sub(1) == 1)
+		{
+			std::lock_guard lock(mutex);
+			done.notify_all();
+		}
+		return true;
+	}
+
+	const void ThreadPool::work(const size_t self)
+	{
+		auto seen = uint64_t{ 0 };
+		while (true)
+		{
+			{
+				std::unique_lock lock(mutex);
+				wake.wait(lock, [&]() { return stopping || generation != seen; });
+				if (stopping)
+				{
+					return;
+				}
+				seen = generation;
+			}
+
+			while (run_one(self))
+			{
+			}
+		}
+	}
+}
@@ -0,0 +1,63 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+
+namespace luminance_limiter_sg
+{
+	// Instances a project can hold; trackbar 0 picks one, from 0 to num_or_racks - 1.
+	constexpr static inline auto num_or_racks = 16U;
+
+	// Ranges and defaults of the trackbars and check boxes, shared by the plugin and the
+	// host-side drivers. The labels stay with the plugin since they are AviUtl UI text.
+	constexpr static inline auto track_n = 13u;
+	constexpr static inline auto track_default = std::array<int32_t, track_n>
+	{
+		0,
+		4096,4095, 1, 0,
+		1, 0,
+		0,
+		10,
+		0,
+		0,
+		1, 1
+	};
+	constexpr static inline auto track_s = std::array<int32_t, track_n>
+	{
+		0,
+		3, 2, 1, 0,
+		1, 0,
+		0,
+		0,
+		0,
+		0,
+		1, 1
+	};
+	constexpr static inline auto track_e = std::array<int32_t, track_n>
+	{
+		num_or_racks - 1,
+		4096, 4095, 4094, 4093,
+		4096, 4096,
+		3,
+		500,
+		1000,
+		256,
+		32, 32
+	};
+
+	constexpr static inline auto check_n = 2u;
+	constexpr static inline auto check_default = std::array<int32_t, check_n>
+	{
+		0,
+		0
+	};
+}
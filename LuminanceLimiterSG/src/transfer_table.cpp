@@ -0,0 +1,38 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#include "transfer_table.h"
+
+#include "common_utility.h"
+
+
+namespace luminance_limiter_sg
+{
+	TransferTable::TransferTable() noexcept
+	{
+		bake(id);
+	}
+
+	const void TransferTable::clamp(const double lower, const double upper) noexcept
+	{
+		const auto low = Luminance::quantize_y(Luminance::denormalize_y(lower));
+		const auto high = Luminance::quantize_y(Luminance::denormalize_y(upper));
+		for (auto i = size_t{ 0 }; i < size; ++i)
+		{
+			table[i] = table[i] > high ? high : (table[i] < low ? low : table[i]);
+		}
+	}
+
+	const void TransferTable::compose(const TransferTable& outer, const TransferTable& inner) noexcept
+	{
+		for (auto i = size_t{ 0 }; i < size; ++i)
+		{
+			table[i] = outer[inner.table[i]];
+		}
+	}
+}
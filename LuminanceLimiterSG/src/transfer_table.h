@@ -0,0 +1,110 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include "luminance.h"
+
+namespace luminance_limiter_sg
+{
+	// Transfer curve baked for every integer YC48 Y value.
+	// Y outside [y_lower, y_upper] is looked up at the nearest edge.
+	class TransferTable
+	{
+	public:
+		constexpr static inline int32_t y_lower = -4096;
+		constexpr static inline int32_t y_upper = 8191;
+		constexpr static inline size_t size = static_cast<size_t>(y_upper - y_lower + 1);
+
+		TransferTable() noexcept;
+
+		template<typename F>
+		inline const void bake(const F& curve)
+		{
+			for (auto i = size_t{ 0 }; i < size; ++i)
+			{
+				const auto normalized = Luminance::normalize_y(y_lower + static_cast<int32_t>(i));
+				table[i] = Luminance::quantize_y(Luminance::denormalize_y(curve(normalized)));
+			}
+		}
+
+		// Bakes curve on every step-th entry and interpolates linearly in between, for
+		// smooth curves at a fraction of the cost of bake. Spans holding one of breaks,
+		// the normalized Y where curve may jump, are baked entry by entry.
+		template<typename F>
+		inline const void bake_sampled(const F& curve, const size_t step, const std::span<const double> breaks)
+		{
+			const auto at = [&](const size_t i) {
+				return Luminance::denormalize_y(curve(Luminance::normalize_y(y_lower + static_cast<int32_t>(i))));
+				};
+			const auto breaks_within = [&](const size_t begin, const size_t end) {
+				for (const auto x : breaks)
+				{
+					const auto y = Luminance::denormalize_y(x) - static_cast<double>(y_lower);
+					if (static_cast<double>(begin) <= y && y <= static_cast<double>(end))
+					{
+						return true;
+					}
+				}
+				return false;
+				};
+
+			auto begin = size_t{ 0 };
+			auto from = at(begin);
+			while (begin < size - 1u)
+			{
+				const auto end = begin + step < size - 1u ? begin + step : size - 1u;
+				const auto to = at(end);
+				if (breaks_within(begin, end))
+				{
+					table[begin] = Luminance::quantize_y(from);
+					for (auto i = begin + 1u; i < end; ++i)
+					{
+						table[i] = Luminance::quantize_y(at(i));
+					}
+				}
+				else
+				{
+					const auto slope = (to - from) / static_cast<double>(end - begin);
+					for (auto i = begin; i < end; ++i)
+					{
+						table[i] = Luminance::quantize_y(from + slope * static_cast<double>(i - begin));
+					}
+				}
+				begin = end;
+				from = to;
+			}
+			table[size - 1u] = Luminance::quantize_y(from);
+		}
+
+		// Clamps every entry to the quantized [lower, upper], both normalized.
+		const void clamp(const double lower, const double upper) noexcept;
+
+		// Bakes outer(inner(y)); inner may be this table, outer may not.
+		const void compose(const TransferTable& outer, const TransferTable& inner) noexcept;
+
+		constexpr inline int16_t operator[](const int16_t y) const noexcept
+		{
+			const auto clamped = y < y_lower ? y_lower : (y > y_upper ? y_upper : static_cast<int32_t>(y));
+			return table[static_cast<size_t>(clamped - y_lower)];
+		}
+
+		constexpr inline const int16_t* data() const noexcept
+		{
+			return table.data();
+		}
+	private:
+		// One trailing entry so dword gathers of the last entry stay in bounds.
+		alignas(64) std::array<int16_t, size + 1> table{};
+	};
+}
@@ -1,17 +1,1352 @@
-/*
-	Copyright(c) 2023 SoseiGocho
-	This Source Code Form is subject to the terms of the Mozilla Public License,
-	v. 2.0.If a copy of the MPL was not distributed with this file, You can
-	obtain one at https ://mozilla.org/MPL/2.0/.
-*/
-
-
-#include "../src/luminance_limiter_sg.h"
-
-#include "CppUnitTest.h"
-
-using namespace Microsoft::VisualStudio::CppUnitTestFramework;
-
-namespace luminance_limiter_sg_test
-{
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#include "../src/luminance_limiter_sg.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "CppUnitTest.h"
+#include "../src/buffer.h"
+#include "../src/curve_cache.h"
+#include "../src/envelope_checkpoints.h"
+#include "../src/executor.h"
+#include "../src/frame.h"
+#include "../src/histogram.h"
+#include "../src/host_filter.h"
+#include "../src/interpolation.h"
+#include "../src/kernel.h"
+#include "../src/knot_curve.h"
+#include "../src/limiter.h"
+#include "../src/local_limiter.h"
+#include "../src/look_ahead.h"
+#include "../src/parameters.h"
+#include "../src/peak_envelope_generator.h"
+#include "../src/peak_index.h"
+#include "../src/processor.h"
+#include "../src/project_parameter.h"
+#include "../src/rack.h"
+#include "../src/reference.h"
+#include "../src/scratch_pool.h"
+#include "../src/spsc_ring.h"
+#include "../src/stage_profile.h"
+#include "../src/telemetry.h"
+#include "../src/transfer_table.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace luminance_limiter_sg_test
+{
+	using namespace luminance_limiter_sg;
+
+	static std::vector<AviUtl::PixelYC> random_row(std::mt19937& rng, const uint32_t n)
+	{
+		auto row = std::vector<AviUtl::PixelYC>(n);
+		for (auto&& pixel : row)
+		{
+			pixel.y = static_cast<int16_t>(static_cast<int32_t>(rng() % 14000u) - 5000);
+			pixel.cb = static_cast<int16_t>(rng());
+			pixel.cr = static_cast<int16_t>(rng());
+		}
+		return row;
+	}
+
+	static bool same_pixels(const std::vector<AviUtl::PixelYC>& a, const std::vector<AviUtl::PixelYC>& b)
+	{
+		for (auto i = 0u; i < a.size(); ++i)
+		{
+			if (a[i].y != b[i].y || a[i].cb != b[i].cb || a[i].cr != b[i].cr)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	TEST_CLASS(KernelTest)
+	{
+	public:
+		TEST_METHOD(VectorKernelsMatchScalar)
+		{
+			auto rng = std::mt19937(4096u);
+			auto table = TransferTable();
+			table.bake([](double y) { return 0.25 + 0.5 * y * y; });
+
+			auto left = std::vector<int16_t>(TransferTable::size * 2u);
+			auto right = std::vector<int16_t>(TransferTable::size * 2u);
+			for (auto i = size_t{ 0 }; i < TransferTable::size; ++i)
+			{
+				left[i * 2u] = table.data()[i];
+				left[i * 2u + 1u] = static_cast<int16_t>(TransferTable::y_lower + static_cast<int32_t>(i));
+				right[i * 2u] = static_cast<int16_t>(TransferTable::y_upper - static_cast<int32_t>(i));
+				right[i * 2u + 1u] = static_cast<int16_t>(table.data()[i] / 2);
+			}
+
+			for (const auto instruction_set : { InstructionSet::SSE41, InstructionSet::AVX2, InstructionSet::AVX512 })
+			{
+				const auto kernel = kernels_for(instruction_set);
+				if (!kernel)
+				{
+					continue;
+				}
+
+				for (const auto n : { 1u, 7u, 8u, 15u, 16u, 17u, 33u, 48u, 1921u })
+				{
+					const auto row = random_row(rng, n);
+
+					int16_t top = INT16_MIN, bottom = INT16_MAX, expected_top = INT16_MIN, expected_bottom = INT16_MAX;
+					scalar_kernels.reduce_y(row.data(), n, expected_top, expected_bottom);
+					kernel->reduce_y(row.data(), n, top, bottom);
+					Assert::AreEqual(expected_top, top);
+					Assert::AreEqual(expected_bottom, bottom);
+
+					auto expected = row;
+					auto actual = row;
+					scalar_kernels.apply_table_y(expected.data(), n, table.data());
+					kernel->apply_table_y(actual.data(), n, table.data());
+					Assert::IsTrue(same_pixels(expected, actual));
+
+					auto expected_plane = std::vector<double>(n);
+					auto actual_plane = std::vector<double>(n);
+					scalar_kernels.fetch_y_f64(row.data(), n, expected_plane.data());
+					kernel->fetch_y_f64(row.data(), n, actual_plane.data());
+					Assert::IsTrue(expected_plane == actual_plane);
+
+					auto expected_f32 = std::vector<float>(n);
+					auto actual_f32 = std::vector<float>(n);
+					scalar_kernels.fetch_y_f32(row.data(), n, expected_f32.data());
+					kernel->fetch_y_f32(row.data(), n, actual_f32.data());
+					Assert::IsTrue(expected_f32 == actual_f32);
+
+					auto expected_i16 = std::vector<int16_t>(n);
+					auto actual_i16 = std::vector<int16_t>(n);
+					scalar_kernels.fetch_y_i16(row.data(), n, expected_i16.data());
+					kernel->fetch_y_i16(row.data(), n, actual_i16.data());
+					Assert::IsTrue(expected_i16 == actual_i16);
+
+					for (auto i = 0u; i < n; ++i)
+					{
+						expected_plane[i] = expected_plane[i] * 9.0 + 0.3;
+						expected_f32[i] = static_cast<float>(expected_plane[i]);
+						expected_i16[i] = static_cast<int16_t>(expected_i16[i] * 3);
+					}
+
+					expected = row;
+					actual = row;
+					scalar_kernels.render_y_f64(expected.data(), n, expected_plane.data());
+					kernel->render_y_f64(actual.data(), n, expected_plane.data());
+					Assert::IsTrue(same_pixels(expected, actual));
+
+					expected = row;
+					actual = row;
+					scalar_kernels.render_y_f32(expected.data(), n, expected_f32.data());
+					kernel->render_y_f32(actual.data(), n, expected_f32.data());
+					Assert::IsTrue(same_pixels(expected, actual));
+
+					expected = row;
+					actual = row;
+					scalar_kernels.render_y_i16(expected.data(), n, expected_i16.data());
+					kernel->render_y_i16(actual.data(), n, expected_i16.data());
+					Assert::IsTrue(same_pixels(expected, actual));
+
+					auto weights = std::vector<int16_t>(n);
+					for (auto&& weight : weights)
+					{
+						weight = static_cast<int16_t>(rng() % (Kernels::blend_one + 1u));
+					}
+					for (const auto vertical : { 0, 77, Kernels::blend_one })
+					{
+						expected = row;
+						actual = row;
+						scalar_kernels.blend_tables_y(expected.data(), n, left.data(), right.data(), weights.data(), vertical);
+						kernel->blend_tables_y(actual.data(), n, left.data(), right.data(), weights.data(), vertical);
+						Assert::IsTrue(same_pixels(expected, actual));
+					}
+				}
+			}
+		}
+	};
+
+	TEST_CLASS(CurveTest)
+	{
+	public:
+		TEST_METHOD(CurvesAreBuiltAtCompileTime)
+		{
+			constexpr auto xs = Knots<4>{ -0.1, 0.1, 0.8, 1.1 };
+			constexpr auto ys = Knots<4>{ 0.05, 0.1, 0.8, 0.9 };
+			constexpr auto linear = LinearCurve<4>(xs, ys);
+			constexpr auto lagrange = LagrangeCurve<4>(xs, ys);
+			constexpr auto spline = SplineCurve<4>(xs, ys);
+			static_assert(linear(1.1) > 0.899 && linear(1.1) < 0.901);
+			static_assert(lagrange(0.8) > 0.79 && lagrange(0.8) < 0.81);
+			static_assert(spline(0.5) == spline(0.5));
+
+			constexpr auto curve = make_curve(InterpolationMode::Lagrange, xs, ys);
+			static_assert(std::holds_alternative<LagrangeCurve<4>>(curve));
+			for (auto i = 0; i <= 16; ++i)
+			{
+				const auto x = i / 16.0;
+				Assert::AreEqual(lagrange(x), std::visit([x](const auto& character) { return character(x); }, curve));
+			}
+		}
+
+		TEST_METHOD(MonotoneCurveDoesNotOvershoot)
+		{
+			constexpr auto xs = Knots<4>{ 0.0, 0.3, 0.6, 1.0 };
+			constexpr auto ys = Knots<4>{ 0.0, 0.05, 0.95, 1.0 };
+			constexpr auto monotone = MonotoneCurve<4>(xs, ys);
+			static_assert(monotone(0.3) > 0.0499 && monotone(0.3) < 0.0501);
+
+			const auto lagrange = LagrangeCurve<4>(xs, ys);
+			auto lagrange_overshoots = false;
+			auto previous = monotone(0.0);
+			for (auto i = 1; i <= 1000; ++i)
+			{
+				const auto x = i / 1000.0;
+				const auto y = monotone(x);
+				Assert::IsTrue(y >= previous && y <= 1.0);
+				previous = y;
+				lagrange_overshoots = lagrange_overshoots || lagrange(x) < 0.0 || lagrange(x) > 1.0;
+			}
+			Assert::IsTrue(lagrange_overshoots);
+		}
+	};
+
+	TEST_CLASS(KnotCurveTest)
+	{
+	public:
+		TEST_METHOD(GridLookupFindsTheSegmentOfEveryX)
+		{
+			auto xs = std::vector<double>(64);
+			auto ys = std::vector<double>(64);
+			for (auto i = 0u; i < xs.size(); ++i)
+			{
+				const auto t = i / 63.0;
+				xs[i] = t * t * t;
+				ys[i] = std::sqrt(t);
+			}
+
+			for (const auto mode : { InterpolationMode::Linear, InterpolationMode::Spline, InterpolationMode::Monotone })
+			{
+				const auto curve = KnotCurve(xs, ys, mode);
+				for (auto i = 0u; i < xs.size(); ++i)
+				{
+					Assert::AreEqual(ys[i], curve(xs[i]), 1e-12);
+				}
+				for (auto i = 0; i < 100000; ++i)
+				{
+					const auto x = i / 100000.0;
+					const auto expected = static_cast<size_t>(std::upper_bound(xs.begin(), xs.end(), x) - xs.begin()) - 1u;
+					Assert::AreEqual(expected, curve.segment_of(x));
+				}
+			}
+
+			const auto monotone = KnotCurve(xs, ys, InterpolationMode::Monotone);
+			auto previous = monotone(-0.1);
+			for (auto i = -99; i <= 1100; ++i)
+			{
+				const auto y = monotone(i / 1000.0);
+				Assert::IsTrue(y >= previous);
+				previous = y;
+			}
+		}
+
+		TEST_METHOD(MatchesTheFixedCurvesAndRefusesBadKnots)
+		{
+			constexpr auto xs = Knots<4>{ -0.1, 0.1, 0.8, 1.1 };
+			constexpr auto ys = Knots<4>{ 0.05, 0.1, 0.8, 0.9 };
+			const auto fixed = MonotoneCurve<4>(xs, ys);
+			const auto knots = KnotCurve(xs, ys, InterpolationMode::Monotone);
+			for (auto i = 0; i <= 1000; ++i)
+			{
+				const auto x = -0.1 + 1.2 * i / 1000.0;
+				Assert::AreEqual(fixed(x), knots(x), 1e-12);
+			}
+
+			const auto unsorted = std::array<double, 3>{ 0.0, 0.5, 0.4 };
+			Assert::ExpectException<std::invalid_argument>([&]() { KnotCurve(unsorted, unsorted, InterpolationMode::Linear); });
+			Assert::ExpectException<std::invalid_argument>([&]() { KnotCurve(xs, ys, InterpolationMode::Lagrange); });
+		}
+	};
+
+	TEST_CLASS(TransferTableTest)
+	{
+	public:
+		TEST_METHOD(SampledLimiterStaysWithinOneCodeOfTheExactOne)
+		{
+			for (const auto mode : { InterpolationMode::Linear, InterpolationMode::Lagrange, InterpolationMode::Spline, InterpolationMode::Monotone })
+			{
+				for (const auto top_peak : { 0.8, 1.0, 1.1, 1.3 })
+				{
+					const auto key = CurveKey{ 1.0, 0.9, 0.0, 0.05, top_peak, -0.05, mode };
+					auto exact = TransferTable();
+					auto sampled = TransferTable();
+					bake_limiter(exact, key);
+					bake_limiter(sampled, key, LocalLimiter::bake_step);
+					for (auto y = TransferTable::y_lower; y <= TransferTable::y_upper; ++y)
+					{
+						Assert::IsTrue(std::abs(exact[static_cast<int16_t>(y)] - sampled[static_cast<int16_t>(y)]) <= 1);
+					}
+				}
+			}
+		}
+	};
+
+	TEST_CLASS(CurveCacheTest)
+	{
+	public:
+		TEST_METHOD(QuantizedKeysReuseTables)
+		{
+			auto bakes = 0;
+			const auto bake_for = [&bakes](const double gain) {
+				return [&bakes, gain](TransferTable& table) {
+					bakes++;
+					table.bake([gain](double y) { return y * gain; });
+					};
+				};
+			const auto key_for = [](const double peak) {
+				return CurveKey{ 1.0, 0.9, 0.0, 0.1, quantize_peak(peak, 16u), 0.0, InterpolationMode::Spline };
+				};
+
+			Assert::AreEqual(key_for(1000.0 / 4096.0).top_peak, key_for(1001.0 / 4096.0).top_peak);
+			Assert::AreEqual(0.25, quantize_peak(0.25, 0u));
+
+			auto cache = CurveCache(2u);
+			auto held = std::optional<CurveKey>();
+			auto table = TransferTable();
+			cache.load(key_for(0.5), held, table, bake_for(0.5));
+			cache.load(key_for(0.5 + 1.0 / 4096.0), held, table, bake_for(0.5));
+			Assert::AreEqual(1, bakes);
+			Assert::AreEqual(uint64_t{ 1 }, cache.hits());
+
+			cache.load(key_for(0.7), held, table, bake_for(0.7));
+			cache.load(key_for(0.5), held, table, bake_for(0.5));
+			Assert::AreEqual(2, bakes);
+			Assert::AreEqual(int16_t{ 1024 }, table[2048]);
+
+			cache.load(key_for(0.9), held, table, bake_for(0.9));
+			cache.load(key_for(0.7), held, table, bake_for(0.7));
+			Assert::AreEqual(4, bakes);
+			Assert::AreEqual(uint64_t{ 4 }, cache.misses());
+			Assert::AreEqual(uint64_t{ 2 }, cache.hits());
+		}
+	};
+
+	TEST_CLASS(FrameTest)
+	{
+	public:
+		TEST_METHOD(BandedProcessingIsIndependentOfThreadCount)
+		{
+			auto rng = std::mt19937(1080u);
+			const auto width = 1920u;
+			const auto height = 1080u;
+			const auto stride = 2048u;
+			const auto source = random_row(rng, stride * height);
+
+			auto table = TransferTable();
+			table.bake([](double y) { return 0.1 + 0.8 * y; });
+
+			auto expected = source;
+			auto serial = Frame(expected.data(), width, height, stride);
+			const auto expected_peaks = serial.peaks();
+			serial.apply(table);
+
+			for (const auto threads : { 1u, 2u, 5u, 16u })
+			{
+				auto pool = ThreadPool(threads);
+				auto actual = source;
+				auto banded = Frame(actual.data(), width, height, stride);
+				Assert::IsTrue(expected_peaks == banded.peaks(pool));
+				banded.apply(table, pool);
+				Assert::IsTrue(same_pixels(expected, actual));
+			}
+		}
+
+		TEST_METHOD(DraftStatisticsSampleASubsetOfTheFrame)
+		{
+			auto rng = std::mt19937(2160u);
+			const auto width = 3840u;
+			const auto height = 2160u;
+			auto pixels = random_row(rng, width * height);
+			auto frame = Frame(pixels.data(), width, height, width);
+
+			Assert::AreEqual(1u, frame.sampling_step(StatisticsQuality::Exact));
+			const auto step = frame.sampling_step(StatisticsQuality::Draft);
+			Assert::AreEqual(8u, step);
+
+			auto draft = Histogram();
+			frame.histogram(draft, step);
+			Assert::AreEqual(static_cast<uint64_t>(width / step) * (height / step), draft.total());
+
+			auto pool = ThreadPool(4u);
+			const auto [exact_top, exact_bottom] = frame.peaks(pool);
+			const auto [draft_top, draft_bottom] = frame.peaks(pool, step);
+			Assert::IsTrue(draft_top <= exact_top && draft_bottom >= exact_bottom);
+			Assert::IsTrue(draft.peaks() == frame.peaks(step));
+		}
+
+		TEST_METHOD(HashCoversEverySampledPixel)
+		{
+			auto rng = std::mt19937(36u);
+			const auto width = 1280u;
+			const auto height = 720u;
+			auto pixels = random_row(rng, width * height);
+			auto frame = Frame(pixels.data(), width, height, width);
+			auto pool = ThreadPool(4u);
+
+			auto table = TransferTable();
+			table.bake([](double y) { return 0.05 + 0.9 * y; });
+			for (const auto step : { 1u, 3u })
+			{
+				auto applied = pixels;
+				auto banded = Frame(applied.data(), width, height, width);
+				const auto written = banded.apply_hashed(table, pool, step);
+				Assert::IsTrue(written == banded.hash(step));
+				Assert::IsTrue(written == banded.hash(pool, step));
+			}
+
+			// A pixel off any sparse grid still changes the hash.
+			const auto before = frame.hash(pool);
+			pixels[width * 361u + 641u].y += 1;
+			Assert::IsTrue(before != frame.hash(pool));
+			pixels[width * 361u + 641u].cb += 1;
+			pixels[width * 361u + 641u].y -= 1;
+			Assert::IsTrue(before == frame.hash(pool));
+		}
+	};
+
+	TEST_CLASS(HistogramTest)
+	{
+	public:
+		TEST_METHOD(PercentilePeaksBracketTheExcludedTail)
+		{
+			auto rng = std::mt19937(4097u);
+			const auto width = 1280u;
+			const auto height = 720u;
+			auto pixels = random_row(rng, width * height);
+
+			auto serial = Histogram();
+			Frame(pixels.data(), width, height, width).histogram(serial);
+			Assert::AreEqual(static_cast<uint64_t>(width) * height, serial.total());
+			Assert::IsTrue(serial.peaks() == Frame(pixels.data(), width, height, width).peaks());
+
+			auto pool = ThreadPool(4u);
+			auto partials = std::vector<Histogram>();
+			auto banded = Histogram();
+			Frame(pixels.data(), width, height, width).histogram(banded, partials, pool);
+			Assert::IsTrue(serial.counts() == banded.counts());
+
+			const auto exclusion = 0.001;
+			const auto top = serial.upper_percentile(exclusion);
+			const auto bottom = serial.lower_percentile(exclusion);
+			auto above = uint64_t{ 0 };
+			auto below = uint64_t{ 0 };
+			for (const auto& pixel : pixels)
+			{
+				above += pixel.y > top ? 1u : 0u;
+				below += pixel.y < bottom ? 1u : 0u;
+			}
+			const auto limit = static_cast<uint64_t>(exclusion * static_cast<double>(serial.total()));
+			Assert::IsTrue(above <= limit && below <= limit);
+			Assert::IsTrue(above + serial[top] > limit && below + serial[bottom] > limit);
+		}
+
+		TEST_METHOD(TransferThroughFusedTablesMatchesRescan)
+		{
+			auto rng = std::mt19937(8191u);
+			const auto width = 640u;
+			const auto height = 360u;
+			const auto source = random_row(rng, width * height);
+
+			auto first = TransferTable();
+			first.bake([](double y) { return 0.05 + 0.9 * y * y; });
+			auto second = TransferTable();
+			second.bake([](double y) { return 1.0 - y; });
+			auto fused = first;
+			fused.compose(second, fused);
+
+			auto input = Histogram();
+			auto pixels = source;
+			auto frame = Frame(pixels.data(), width, height, width);
+			frame.histogram(input);
+			frame.apply(first);
+			frame.apply(second);
+
+			auto rescanned = Histogram();
+			frame.histogram(rescanned);
+			auto derived = Histogram();
+			derived.transfer(input, fused);
+			Assert::IsTrue(rescanned.counts() == derived.counts());
+			Assert::IsTrue(rescanned.peaks() == derived.peaks());
+		}
+	};
+
+	TEST_CLASS(PeakIndexTest)
+	{
+	public:
+		TEST_METHOD(StoredPeaksSurviveReopen)
+		{
+			const auto key = PeakIndex::Key{ PeakIndex::source_hash("peak_index_test.avi"), 300u, 1920u, 1080u, 1u, 0, 0u };
+			const auto path = PeakIndex::cache_path(std::filesystem::temp_directory_path(), key);
+			std::filesystem::remove(path);
+
+			auto pool = ThreadPool(4u);
+			{
+				auto index = PeakIndex::open(path, key);
+				Assert::IsTrue(index.has_value());
+				Assert::IsFalse(index->peaks(10).has_value());
+				index->scan(pool, [](const int32_t frame) -> std::optional<std::array<double, 2>> {
+					return std::array<double, 2>{ Luminance::normalize_y(frame + 1000), Luminance::normalize_y(-frame) };
+					});
+			}
+
+			auto reopened = PeakIndex::open(path, key);
+			Assert::IsTrue(reopened.has_value());
+			for (auto frame = 0; frame < 300; ++frame)
+			{
+				const auto peaks = reopened->peaks(frame);
+				Assert::IsTrue(peaks.has_value());
+				Assert::AreEqual(Luminance::normalize_y(frame + 1000), peaks.value()[0]);
+				Assert::AreEqual(Luminance::normalize_y(-frame), peaks.value()[1]);
+			}
+			Assert::IsFalse(reopened->peaks(300).has_value());
+
+			auto other = key;
+			other.step = 4u;
+			reopened = std::nullopt;
+			auto stale = PeakIndex::open(path, other);
+			Assert::IsFalse(stale->peaks(10).has_value());
+			stale = std::nullopt;
+			std::filesystem::remove(path);
+		}
+
+		TEST_METHOD(StoredPeaksAreCheckedAgainstTheFrame)
+		{
+			const auto key = PeakIndex::Key{ PeakIndex::source_hash("peak_index_check.avi"), 30u, 640u, 360u, 1u, 0, 1u };
+			const auto path = PeakIndex::cache_path(std::filesystem::temp_directory_path(), key);
+			std::filesystem::remove(path);
+			{
+				auto index = PeakIndex::open(path, key);
+				const auto stored = std::array<double, 2>{ Luminance::normalize_y(3000), Luminance::normalize_y(100) };
+				index->store(3, stored);
+				Assert::IsTrue(index->agrees(3, stored));
+				Assert::IsTrue(index->agrees(4, stored));
+				Assert::IsFalse(index->agrees(3, { Luminance::normalize_y(3001), Luminance::normalize_y(100) }));
+
+				index->clear();
+				Assert::IsFalse(index->peaks(3).has_value());
+			}
+			std::filesystem::remove(path);
+		}
+
+		TEST_METHOD(ReplayedHistoryMatchesSequentialEnvelope)
+		{
+			auto rng = std::mt19937(24u);
+			auto peaks = std::vector<std::array<double, 2>>(600);
+			for (auto&& [top, bottom] : peaks)
+			{
+				top = Luminance::normalize_y(2048 + static_cast<int32_t>(rng() % 2048u));
+				bottom = Luminance::normalize_y(static_cast<int32_t>(rng() % 2048u));
+			}
+
+			const auto configure = [](PeakEnvelopeGenerator& generator) {
+				generator.set_limit(0.9, 0.1);
+				generator.set_sustain(12u);
+				generator.set_release(30.0);
+				};
+
+			auto sequential = PeakEnvelopeGenerator();
+			configure(sequential);
+			auto expected = std::vector<std::array<double, 2>>();
+			for (const auto& [top, bottom] : peaks)
+			{
+				expected.push_back(sequential.update_and_get_envelope_peaks(top, bottom));
+			}
+
+			auto seeking = PeakEnvelopeGenerator();
+			configure(seeking);
+			for (const auto frame : { 450, 3, 599, 100, 101 })
+			{
+				seeking.reset();
+				const auto history = static_cast<int32_t>(seeking.history());
+				for (auto past = frame > history ? frame - history : 0; past < frame; ++past)
+				{
+					seeking.update_and_get_envelope_peaks(peaks[past][0], peaks[past][1]);
+				}
+				Assert::IsTrue(expected[frame] == seeking.update_and_get_envelope_peaks(peaks[frame][0], peaks[frame][1]));
+			}
+		}
+	};
+
+	TEST_CLASS(PeakEnvelopeGeneratorTest)
+	{
+	public:
+		TEST_METHOD(LiveResizeHoldsExactWindow)
+		{
+			auto rng = std::mt19937(11u);
+			auto peaks = std::vector<std::array<double, 2>>(500);
+			for (auto&& [top, bottom] : peaks)
+			{
+				top = Luminance::normalize_y(static_cast<int32_t>(rng() % 4096u));
+				bottom = Luminance::normalize_y(static_cast<int32_t>(rng() % 4096u));
+			}
+
+			auto generator = PeakEnvelopeGenerator();
+			generator.reserve(64u);
+			auto sustain = 5u;
+			generator.set_sustain(sustain);
+			for (auto frame = 0; frame < static_cast<int32_t>(peaks.size()); ++frame)
+			{
+				if (frame % 37 == 0)
+				{
+					sustain = rng() % 65u;
+					generator.set_sustain(sustain);
+				}
+
+				auto expected_top = peaks[frame][0];
+				auto expected_bottom = peaks[frame][1];
+				for (auto past = std::max(0, frame - static_cast<int32_t>(sustain)); past < frame; ++past)
+				{
+					expected_top = std::max(expected_top, peaks[past][0]);
+					expected_bottom = std::min(expected_bottom, peaks[past][1]);
+				}
+				const auto [top, bottom] = generator.hold_peaks(peaks[frame][0], peaks[frame][1]);
+				Assert::AreEqual(expected_top, top);
+				Assert::AreEqual(expected_bottom, bottom);
+			}
+		}
+
+		TEST_METHOD(RepeatedPeaksStayWithinReservedWindow)
+		{
+			for (const auto sustain : { 0u, 1u, 7u })
+			{
+				auto generator = PeakEnvelopeGenerator();
+				generator.set_sustain(sustain);
+				for (auto frame = 0; frame < 100; ++frame)
+				{
+					const auto peak = frame < 50 ? 0.75 : 0.5;
+					const auto [top, bottom] = generator.hold_peaks(peak, peak);
+					const auto expected_top = frame < 50 + static_cast<int32_t>(sustain) ? 0.75 : 0.5;
+					Assert::AreEqual(expected_top, top);
+					Assert::AreEqual(peak, bottom);
+				}
+			}
+		}
+
+		TEST_METHOD(BatchedProcessMatchesPerFrameUpdates)
+		{
+			auto rng = std::mt19937(12u);
+			auto peaks = std::vector<std::array<double, 2>>(1000);
+			for (auto&& [top, bottom] : peaks)
+			{
+				top = Luminance::normalize_y(2048 + static_cast<int32_t>(rng() % 2048u));
+				bottom = Luminance::normalize_y(static_cast<int32_t>(rng() % 2048u));
+			}
+
+			const auto configure = [](PeakEnvelopeGenerator& generator) {
+				generator.set_limit(0.9, 0.1);
+				generator.set_sustain(20u);
+				generator.set_release(15.0);
+				};
+
+			auto per_frame = PeakEnvelopeGenerator();
+			configure(per_frame);
+			auto batched = PeakEnvelopeGenerator();
+			configure(batched);
+
+			auto envelope = std::vector<std::array<double, 2>>(peaks.size());
+			batched.process(peaks, envelope);
+			for (auto frame = size_t{ 0 }; frame < peaks.size(); ++frame)
+			{
+				Assert::IsTrue(envelope[frame] == per_frame.update_and_get_envelope_peaks(peaks[frame][0], peaks[frame][1]));
+			}
+		}
+	};
+
+	TEST_CLASS(LookAheadTest)
+	{
+	public:
+		TEST_METHOD(RingWindowMatchesBruteForce)
+		{
+			auto rng = std::mt19937(60u);
+			auto frames = std::vector<std::array<double, 2>>(400);
+			for (auto&& [top, bottom] : frames)
+			{
+				top = Luminance::normalize_y(2048 + static_cast<int32_t>(rng() % 2048u));
+				bottom = Luminance::normalize_y(static_cast<int32_t>(rng() % 2048u));
+			}
+			const auto source = MemoryPeakSource(frames);
+
+			const auto window = 9;
+			const auto top_limit = 0.95;
+			const auto bottom_limit = 0.05;
+			const auto slope = (top_limit - bottom_limit) / (window + 1);
+			const auto brute_force = [&](const int32_t frame) {
+				auto [top, bottom] = frames[frame];
+				for (auto k = 1; k <= window && frame + k < static_cast<int32_t>(frames.size()); ++k)
+				{
+					top = std::max(top, frames[frame + k][0] - slope * k);
+					bottom = std::min(bottom, frames[frame + k][1] + slope * k);
+				}
+				return std::array<double, 2>{ top, bottom };
+				};
+
+			auto look_ahead = LookAhead();
+			look_ahead.set_limit(top_limit, bottom_limit);
+			look_ahead.set_window(window);
+			for (const auto frame : { 0, 1, 2, 3, 250, 251, 252, 120, 121, 397, 398, 399 })
+			{
+				look_ahead.advance(frame, source);
+				const auto [top, bottom] = look_ahead.peaks(frames[frame]);
+				const auto [expected_top, expected_bottom] = brute_force(frame);
+				Assert::AreEqual(expected_top, top, 1e-9);
+				Assert::AreEqual(expected_bottom, bottom, 1e-9);
+			}
+		}
+
+		TEST_METHOD(ResetWindowIsReadAgain)
+		{
+			auto frames = std::vector<std::array<double, 2>>(20, { 0.5, 0.5 });
+			frames[3] = { 1.0, 0.0 };
+			auto look_ahead = LookAhead();
+			look_ahead.set_limit(0.95, 0.05);
+			look_ahead.set_window(4u);
+
+			look_ahead.advance(2, MemoryPeakSource(frames));
+			Assert::IsTrue(look_ahead.peaks({ 0.5, 0.5 })[0] > 0.5);
+
+			// The flash is gone upstream; frame 3 follows 2 but the window is read again.
+			look_ahead.reset();
+			look_ahead.advance(3, EmptyPeakSource());
+			Assert::IsTrue(look_ahead.peaks({ 0.5, 0.5 }) == std::array<double, 2>{ 0.5, 0.5 });
+		}
+	};
+
+	TEST_CLASS(BufferTest)
+	{
+	public:
+		template<typename T>
+		static void render_through(const std::vector<AviUtl::PixelYC>& source, std::vector<AviUtl::PixelYC>& result, const uint32_t width, const uint32_t height)
+		{
+			auto buffer = Buffer<T>(width, height);
+			result = source;
+			buffer.fetch_image(width, height, result.data());
+			buffer.pixelwise_map([](double y) { return y < 0.6 ? y : 0.6 + (y - 0.6) / 3.0; });
+			buffer.render(width, height, result.data());
+		}
+
+		TEST_METHOD(CompactStorageMatchesDoubleWithinTolerance)
+		{
+			auto rng = std::mt19937(720u);
+			const auto width = 1280u;
+			const auto height = 720u;
+			const auto source = random_row(rng, width * height);
+
+			auto reference = std::vector<AviUtl::PixelYC>();
+			auto compact = std::vector<AviUtl::PixelYC>();
+			render_through<double>(source, reference, width, height);
+
+			render_through<int16_t>(source, compact, width, height);
+			Assert::IsTrue(same_pixels(reference, compact));
+
+			render_through<float>(source, compact, width, height);
+			for (auto i = 0u; i < reference.size(); ++i)
+			{
+				const auto difference = reference[i].y - compact[i].y;
+				Assert::IsTrue(-BufferTraits<float>::tolerance <= difference && difference <= BufferTraits<float>::tolerance);
+			}
+		}
+	};
+
+	TEST_CLASS(StageProfileTest)
+	{
+	public:
+		TEST_METHOD(PercentilesStayWithinOneBucket)
+		{
+			auto rng = std::mt19937(16u);
+			auto samples = std::vector<uint64_t>(10000);
+			for (auto&& sample : samples)
+			{
+				sample = 100u + rng() % 20000000u;
+			}
+
+			auto histogram = LatencyHistogram();
+			for (const auto sample : samples)
+			{
+				histogram.record(sample);
+			}
+			std::sort(samples.begin(), samples.end());
+
+			for (const auto fraction : { 0.5, 0.95, 0.99 })
+			{
+				const auto exact = samples[static_cast<size_t>(fraction * static_cast<double>(samples.size() - 1u))];
+				const auto estimate = histogram.percentile(fraction);
+				Assert::IsTrue(exact <= estimate);
+				Assert::IsTrue(static_cast<double>(estimate) <= static_cast<double>(exact) * 1.125 + 1.0);
+			}
+
+			const auto summary = histogram.summary();
+			Assert::AreEqual(static_cast<uint64_t>(samples.size()), summary.count);
+			Assert::AreEqual(samples.back(), summary.max);
+		}
+	};
+
+	TEST_CLASS(RackTest)
+	{
+	public:
+		TEST_METHOD(GcKeepsOnlyUnitsUsedSinceLastFrame)
+		{
+			ProjectParameter::fps() = 30.0;
+			auto filter = HostFilter();
+			auto rack = Rack();
+			rack.set_effector(0, Parameters::of(filter.plugin()));
+			rack.set_effector(1, Parameters::of(filter.plugin()));
+			Assert::IsTrue(std::holds_alternative<Limiter>(rack[0].value()));
+
+			std::visit([](auto& effector) { effector.used(); }, rack[0].value());
+			rack.gc();
+
+			Assert::IsTrue(rack[0].has_value());
+			Assert::IsFalse(rack[1].has_value());
+			Assert::IsFalse(std::visit([](const auto& effector) { return effector.is_using(); }, rack[0].value()));
+			Assert::IsFalse(rack.is_stacked());
+		}
+
+		TEST_METHOD(ChainFollowsOnlyThePassThatBuiltIt)
+		{
+			auto rack = Rack();
+			auto pixels = std::vector<AviUtl::PixelYC>(16u);
+			const auto stamp = FrameStamp{ 5, pixels.data(), 4u, 4u, 1u, 42u };
+			const auto same = [] { return uint64_t{ 42u }; };
+			auto source = Histogram();
+			source.clear();
+
+			rack.enter(0u, 5);
+			rack.begin_chain(source);
+			rack.extend_chain(0u, TransferTable(), stamp);
+			rack.enter(1u, 5);
+			Assert::IsTrue(rack.continues_chain(stamp, same));
+			Assert::IsFalse(rack.continues_chain(stamp, [] { return uint64_t{ 43u }; }));
+
+			// The frame is rendered again: the first instance starts a new pass.
+			rack.enter(0u, 5);
+			rack.enter(1u, 5);
+			Assert::IsFalse(rack.continues_chain(stamp, same));
+
+			// An instance between them that did not extend the chain breaks it.
+			rack.enter(0u, 6);
+			rack.begin_chain(source);
+			rack.extend_chain(0u, TransferTable(), stamp);
+			rack.enter(2u, 6);
+			rack.enter(1u, 6);
+			Assert::IsFalse(rack.continues_chain(stamp, same));
+
+			// So does a local instance, which blends tables instead of extending it.
+			rack.enter(0u, 7);
+			rack.begin_chain(source);
+			rack.extend_chain(0u, TransferTable(), stamp);
+			rack.enter(1u, 7);
+			rack.break_chain();
+			rack.enter(2u, 7);
+			Assert::IsFalse(rack.continues_chain(stamp, same));
+		}
+
+		TEST_METHOD(LastInPassCountsTheInstancesOfTheLastFrame)
+		{
+			ProjectParameter::fps() = 30.0;
+			auto filter = HostFilter();
+			auto rack = Rack();
+			rack.set_effector(0, Parameters::of(filter.plugin()));
+			rack.set_effector(1, Parameters::of(filter.plugin()));
+			std::visit([](auto& effector) { effector.used(); }, rack[0].value());
+			std::visit([](auto& effector) { effector.used(); }, rack[1].value());
+			rack.gc();
+			Assert::IsTrue(rack.is_stacked());
+
+			rack.enter(1u, 3);
+			Assert::IsFalse(rack.is_last_in_pass());
+			rack.enter(0u, 3);
+			Assert::IsTrue(rack.is_last_in_pass());
+
+			// The frame is rendered again and the pass starts over.
+			rack.enter(1u, 3);
+			Assert::IsFalse(rack.is_last_in_pass());
+		}
+	};
+
+	TEST_CLASS(ProcessorTest)
+	{
+	public:
+		TEST_METHOD(IdWithoutSlotLeavesTheFrameAlone)
+		{
+			ProjectParameter::fps() = 30.0;
+			auto rng = std::mt19937(16u);
+			const auto row = random_row(rng, 64u);
+			auto executor = SerialExecutor();
+			auto processor = Processor();
+			const auto none = [](PeakIndex*, const auto&) { return EmptyPeakSource(); };
+
+			for (const auto id : { -1, static_cast<int32_t>(num_or_racks), INT32_MAX })
+			{
+				auto filter = HostFilter();
+				filter.track[0] = id;
+				filter.track[1] = 1000;
+				processor.update(filter.plugin());
+
+				auto pixels = row;
+				processor.process<ProcessingPath::InPlace>(filter.plugin(), FrameRequest{ pixels.data(), 8u, 8u, 8u, 8u, 0 }, executor, none);
+				Assert::IsTrue(same_pixels(row, pixels));
+			}
+
+			// The last slot is still processed.
+			auto filter = HostFilter();
+			filter.track[0] = static_cast<int32_t>(num_or_racks) - 1;
+			filter.track[1] = 1000;
+			auto pixels = row;
+			processor.process<ProcessingPath::InPlace>(filter.plugin(), FrameRequest{ pixels.data(), 8u, 8u, 8u, 8u, 0 }, executor, none);
+			Assert::IsFalse(same_pixels(row, pixels));
+		}
+	};
+
+	TEST_CLASS(ParameterSnapshotsTest)
+	{
+	public:
+		TEST_METHOD(DerivedValuesFollowTrackbars)
+		{
+			ProjectParameter::fps() = 30.0;
+			auto filter = HostFilter();
+			filter.track[2] = 400;
+			filter.track[3] = 3400;
+			filter.track[5] = 1000;
+			const auto parameters = Parameters::of(filter.plugin());
+
+			Assert::IsTrue(parameters.top_threshold == Luminance::normalize_y(3400));
+			Assert::IsTrue(parameters.bottom_threshold == Luminance::normalize_y(400));
+			Assert::AreEqual(30u, parameters.sustain);
+			Assert::IsTrue(parameters.reads(filter.plugin()));
+
+			filter.track[5] = 500;
+			Assert::IsFalse(parameters.reads(filter.plugin()));
+			Assert::IsTrue(Parameters::of(filter.plugin()).version > parameters.version);
+		}
+
+		TEST_METHOD(PinnedSnapshotOutlivesPublish)
+		{
+			ProjectParameter::fps() = 30.0;
+			auto filter = HostFilter();
+			auto snapshots = ParameterSnapshots(2u);
+			Assert::IsFalse(static_cast<bool>(snapshots.pin(0u)));
+
+			const auto first = Parameters::of(filter.plugin());
+			snapshots.publish(0u, first);
+			{
+				const auto pin = snapshots.pin(0u);
+				filter.track[1] = 3000;
+				snapshots.publish(0u, Parameters::of(filter.plugin()));
+				snapshots.reclaim();
+
+				Assert::AreEqual(size_t{ 1 }, snapshots.retired());
+				Assert::IsTrue(pin->version == first.version);
+				Assert::IsTrue(snapshots.pin(0u)->top_limit == Luminance::normalize_y(3000));
+			}
+			snapshots.reclaim();
+			Assert::AreEqual(size_t{ 0 }, snapshots.retired());
+			Assert::IsFalse(static_cast<bool>(snapshots.pin(1u)));
+		}
+
+		TEST_METHOD(ObjectsKeepTheirOwnSnapshots)
+		{
+			ProjectParameter::fps() = 30.0;
+			auto filter = HostFilter();
+			auto objects = ObjectParameters();
+
+			const auto& first = objects.of(filter.plugin());
+			const auto version = first.version;
+			filter.track[1] = 3000;
+			const auto& second = objects.of(filter.plugin());
+			Assert::IsTrue(&first != &second);
+			Assert::IsTrue(second.top_limit == Luminance::normalize_y(3000));
+			const auto second_version = second.version;
+
+			// Taking turns finds the same snapshots again.
+			filter.track[1] = track_default[1];
+			Assert::IsTrue(&first == &objects.of(filter.plugin()));
+			Assert::IsTrue(first.version == version);
+
+			// Only the least recently used snapshot makes room.
+			for (auto i = 1; i < static_cast<int32_t>(ObjectParameters::capacity); ++i)
+			{
+				filter.track[1] = 2000 + i;
+				objects.of(filter.plugin());
+			}
+			filter.track[1] = track_default[1];
+			Assert::IsTrue(objects.of(filter.plugin()).version == version);
+			filter.track[1] = 3000;
+			Assert::IsTrue(objects.of(filter.plugin()).version != second_version);
+		}
+	};
+
+	TEST_CLASS(ScratchPoolTest)
+	{
+	public:
+		TEST_METHOD(ClassesFitRequestsWithinAQuarter)
+		{
+			for (auto bytes = size_t{ 1 }; bytes < (size_t{ 1 } << 30); bytes += bytes / 7u + 1u)
+			{
+				const auto size = ScratchPool::class_size(ScratchPool::class_of(bytes));
+				Assert::IsTrue(bytes <= size);
+				Assert::IsTrue(bytes <= ScratchPool::min_block || size < bytes + bytes / 4u + 1u);
+			}
+		}
+
+		TEST_METHOD(ReusesReturnedBlocksAndReleasesIdleOnes)
+		{
+			auto pool = ScratchPool(std::chrono::hours(1));
+			const void* first = nullptr;
+			{
+				const auto block = pool.acquire(1920u * 1080u * sizeof(int16_t));
+				first = block.as<void>();
+				Assert::AreEqual(size_t{ 0 }, reinterpret_cast<uintptr_t>(first) % ScratchPool::alignment);
+				const auto other = pool.acquire(1920u * 1080u * sizeof(int16_t));
+				Assert::IsTrue(first != other.as<void>());
+			}
+			Assert::AreEqual(pool.reserved_bytes(), pool.idle_bytes());
+			{
+				const auto block = pool.acquire(1920u * 1072u * sizeof(int16_t));
+				Assert::IsTrue(first == block.as<void>());
+			}
+
+			pool.release_idle();
+			Assert::IsTrue(pool.reserved_bytes() > 0u);
+
+			auto eager = ScratchPool(std::chrono::seconds(0));
+			{
+				const auto block = eager.acquire(640u * 480u * sizeof(double));
+				eager.release_idle();
+				Assert::AreEqual(block.size(), eager.reserved_bytes());
+			}
+			eager.release_idle();
+			Assert::AreEqual(size_t{ 0 }, eager.reserved_bytes());
+		}
+	};
+
+	TEST_CLASS(LocalLimiterTest)
+	{
+	public:
+		TEST_METHOD(OnlyTheHotTileIsCompressed)
+		{
+			ProjectParameter::fps() = 30.0;
+			auto filter = HostFilter();
+			filter.track[1] = 3600;
+			filter.track[2] = 3000;
+			filter.track[3] = 400;
+			filter.track[4] = 100;
+			filter.track[5] = 0;
+			filter.track[6] = 100;
+			filter.track[7] = static_cast<int32_t>(InterpolationMode::Linear);
+			filter.track[11] = 2;
+			filter.track[12] = 1;
+			const auto parameters = Parameters::of(filter.plugin());
+			Assert::IsTrue(LocalLimiter::is_local(parameters));
+
+			const auto width = 256u;
+			const auto height = 144u;
+			auto pixels = std::vector<AviUtl::PixelYC>(width * height);
+			for (auto y = 0u; y < height; ++y)
+			{
+				for (auto x = 0u; x < width; ++x)
+				{
+					pixels[y * width + x] = AviUtl::PixelYC{ static_cast<int16_t>(x < width / 2u ? 4000 : 2000), 0, 0 };
+				}
+			}
+
+			auto executor = SerialExecutor();
+			auto frame = Frame(pixels.data(), width, height, width);
+			auto local = LocalLimiter(parameters);
+			local.seek(0);
+			local.fetch_trackbar_and_frame(parameters, frame, width, height, executor, 1u);
+
+			Assert::IsTrue(local.raw_peaks(0, 0)[0] == Luminance::normalize_y(4000));
+			Assert::IsTrue(local.raw_peaks(1, 0)[0] == Luminance::normalize_y(2000));
+			Assert::IsTrue(local.effect(0, 0)[4000] <= 3600);
+			Assert::AreEqual(int16_t{ 2000 }, local.effect(1, 0)[2000]);
+
+			local.apply(frame, executor);
+			for (auto y = 0u; y < height; ++y)
+			{
+				Assert::AreEqual(local.effect(0, 0)[4000], pixels[y * width].y);
+				Assert::AreEqual(int16_t{ 2000 }, pixels[y * width + width - 1u].y);
+				for (auto x = 1u; x < width; ++x)
+				{
+					Assert::IsTrue(pixels[y * width + x - 1u].y >= pixels[y * width + x].y || x == width / 2u);
+				}
+			}
+		}
+	};
+
+	TEST_CLASS(ReferenceTest)
+	{
+	public:
+		TEST_METHOD(GeneratorMatchesReferenceEnvelope)
+		{
+			auto rng = std::mt19937(23u);
+			auto peaks = std::vector<std::array<double, 2>>(800);
+			for (auto&& [top, bottom] : peaks)
+			{
+				top = Luminance::normalize_y(2048 + static_cast<int32_t>(rng() % 2048u));
+				bottom = Luminance::normalize_y(static_cast<int32_t>(rng() % 2048u));
+			}
+
+			auto reference = ReferenceEnvelope();
+			reference.configure(0.9, 0.1, 17u, 24.0);
+			auto generator = PeakEnvelopeGenerator();
+			generator.set_limit(0.9, 0.1);
+			generator.set_sustain(17u);
+			generator.set_release(24.0);
+			for (const auto& [top, bottom] : peaks)
+			{
+				Assert::IsTrue(reference.update(top, bottom) == generator.update_and_get_envelope_peaks(top, bottom));
+			}
+		}
+
+		TEST_METHOD(TablePathMatchesReferenceWithinTable)
+		{
+			ProjectParameter::fps() = 30.0;
+			auto filter = HostFilter();
+			filter.track[1] = 3760;
+			filter.track[2] = 3400;
+			filter.track[3] = 400;
+			filter.track[4] = 128;
+			// A release of 0 divides by zero on the first frame, and the NaN curve it makes
+			// converts to Y differently in the scalar bake and the SIMD render.
+			filter.track[6] = 200;
+			filter.track[7] = static_cast<int32_t>(InterpolationMode::Spline);
+
+			auto rng = std::mt19937(230u);
+			const auto width = 640u;
+			const auto height = 360u;
+			const auto parameters = Parameters::of(filter.plugin());
+			auto reference = ReferenceLimiter(parameters);
+			auto limiter = Limiter(parameters);
+			auto executor = SerialExecutor();
+			for (auto frame = 0; frame < 8; ++frame)
+			{
+				auto expected = random_row(rng, width * height);
+				for (auto&& pixel : expected)
+				{
+					pixel.y = std::clamp<int16_t>(pixel.y, TransferTable::y_lower, TransferTable::y_upper);
+				}
+				auto result = expected;
+				reference.process(parameters, expected.data(), width, height, width);
+
+				auto image = Frame(result.data(), width, height, width);
+				limiter.fetch_trackbar_and_peaks(parameters, image.peaks(executor));
+				image.apply(limiter.effect(), executor);
+				Assert::IsTrue(same_pixels(expected, result));
+			}
+		}
+	};
+
+	TEST_CLASS(EnvelopeCheckpointsTest)
+	{
+	public:
+		TEST_METHOD(RestoredEnvelopeMatchesSequential)
+		{
+			auto rng = std::mt19937(21u);
+			auto peaks = std::vector<std::array<double, 2>>(600);
+			for (auto&& [top, bottom] : peaks)
+			{
+				top = Luminance::normalize_y(2048 + static_cast<int32_t>(rng() % 2048u));
+				bottom = Luminance::normalize_y(static_cast<int32_t>(rng() % 2048u));
+			}
+
+			auto sequential = PeakEnvelopeGenerator();
+			sequential.set_limit(0.9, 0.1);
+			sequential.set_sustain(12u);
+			sequential.set_release(30.0);
+			auto checkpoints = EnvelopeCheckpoints(32, 4u);
+			auto expected = std::vector<std::array<double, 2>>();
+			for (auto frame = 0; frame < 600; ++frame)
+			{
+				checkpoints.record(frame, peaks[frame], peaks[frame], sequential);
+				expected.push_back(sequential.update_and_get_envelope_peaks(peaks[frame][0], peaks[frame][1]));
+			}
+			Assert::AreEqual(size_t{ 4 }, checkpoints.size());
+
+			auto seeking = PeakEnvelopeGenerator();
+			for (const auto frame : { 599, 480, 511, 512, 575 })
+			{
+				Assert::IsTrue(checkpoints.restore(frame, seeking));
+				Assert::IsTrue(expected[frame] == seeking.update_and_get_envelope_peaks(peaks[frame][0], peaks[frame][1]));
+			}
+			// Only the four latest checkpoints fit.
+			Assert::IsFalse(checkpoints.restore(450, seeking));
+			Assert::IsFalse(checkpoints.restore(3, seeking));
+		}
+
+		TEST_METHOD(BackwardSeekReadsOnlyTheCheckpointFrame)
+		{
+			ProjectParameter::fps() = 30.0;
+			auto filter = HostFilter();
+			filter.track[1] = 3600;
+			filter.track[2] = 3000;
+			filter.track[3] = 400;
+			filter.track[4] = 100;
+			filter.track[5] = 200;
+			filter.track[6] = 500;
+
+			auto rng = std::mt19937(210u);
+			auto peaks = std::vector<std::array<double, 2>>(300);
+			for (auto&& [top, bottom] : peaks)
+			{
+				top = Luminance::normalize_y(3000 + static_cast<int32_t>(rng() % 1500u));
+				bottom = Luminance::normalize_y(static_cast<int32_t>(rng() % 500u));
+			}
+
+			struct CountingSource
+			{
+				const std::vector<std::array<double, 2>>& frames;
+				mutable uint32_t reads = 0u;
+
+				const std::optional<std::array<double, 2>> peaks(const int32_t frame) const noexcept
+				{
+					reads++;
+					return frames[frame];
+				}
+			};
+			auto source = CountingSource{ peaks };
+
+			const auto parameters = Parameters::of(filter.plugin());
+			auto limiter = Limiter(parameters);
+			auto expected = std::vector<std::array<int16_t, 3>>();
+			for (auto frame = 0; frame < 300; ++frame)
+			{
+				limiter.seek(parameters, frame, peaks[frame], source);
+				limiter.fetch_trackbar_and_peaks(parameters, peaks[frame]);
+				expected.push_back({ limiter.effect()[3000], limiter.effect()[3500], limiter.effect()[4000] });
+			}
+			Assert::AreEqual(0u, source.reads);
+
+			for (const auto frame : { 250, 40, 41, 299, 7, 128 })
+			{
+				limiter.seek(parameters, frame, peaks[frame], source);
+				limiter.fetch_trackbar_and_peaks(parameters, peaks[frame]);
+				Assert::IsTrue(expected[frame] == std::array<int16_t, 3>{ limiter.effect()[3000], limiter.effect()[3500], limiter.effect()[4000] });
+			}
+			// Each seek but the one onto a checkpoint reads the frame its replay starts from.
+			Assert::AreEqual(4u, source.reads);
+
+			// The clip changed upstream after the checkpoints were taken.
+			for (auto frame = 200; frame < 260; ++frame)
+			{
+				peaks[frame] = { Luminance::normalize_y(4000), Luminance::normalize_y(20) };
+			}
+			auto fresh = Limiter(parameters);
+			for (auto frame = 0; frame <= 250; ++frame)
+			{
+				fresh.seek(parameters, frame, peaks[frame], source);
+				fresh.fetch_trackbar_and_peaks(parameters, peaks[frame]);
+			}
+			source.reads = 0u;
+			limiter.seek(parameters, 250, peaks[250], source);
+			limiter.fetch_trackbar_and_peaks(parameters, peaks[250]);
+			Assert::IsTrue(source.reads > 1u);
+			Assert::IsTrue(std::array<int16_t, 3>{ fresh.effect()[3000], fresh.effect()[3500], fresh.effect()[4000] }
+				== std::array<int16_t, 3>{ limiter.effect()[3000], limiter.effect()[3500], limiter.effect()[4000] });
+		}
+	};
+	TEST_CLASS(TelemetryTest)
+	{
+	public:
+		TEST_METHOD(RingKeepsOrderAndRefusesWhenFull)
+		{
+			auto ring = SpscRing<uint32_t, 4u>();
+			for (auto i = 0u; i < 4u; ++i)
+			{
+				Assert::IsTrue(ring.try_push(i));
+			}
+			Assert::IsFalse(ring.try_push(4u));
+
+			auto value = 0u;
+			for (auto i = 0u; i < 6u; ++i)
+			{
+				Assert::IsTrue(ring.try_pop(value));
+				Assert::AreEqual(i, value);
+				Assert::IsTrue(ring.try_push(i + 4u));
+			}
+		}
+
+		TEST_METHOD(LoggedRecordsReadBack)
+		{
+			ProjectParameter::fps() = 30.0;
+			auto filter = HostFilter();
+			filter.track[1] = 3000;
+			filter.track[2] = 2800;
+			filter.track[6] = 100;
+			const auto parameters = Parameters::of(filter.plugin());
+			auto limiter = Limiter(parameters);
+
+			const auto path = std::filesystem::temp_directory_path() / "luminance_limiter_sg_test.llsgtelemetry";
+			auto& log = TelemetryLog::global();
+			Assert::IsTrue(log.open(path, TelemetryFormat::Binary));
+			for (auto frame = 0; frame < 100; ++frame)
+			{
+				limiter.fetch_trackbar_and_peaks(parameters, { Luminance::normalize_y(3500 + frame), Luminance::normalize_y(100) });
+				auto record = limiter.last_record();
+				record.effector_id = 3u;
+				record.clip = 0x0123456789abcdefu;
+				if (frame % 2)
+				{
+					record.modified = 0.25;
+				}
+				log.push(record);
+			}
+			log.close();
+
+			const auto records = TelemetryLog::read(path);
+			Assert::IsTrue(records.has_value());
+			Assert::AreEqual(size_t{ 100 }, records->size());
+			Assert::AreEqual(0u, static_cast<uint32_t>(log.dropped()));
+			const auto& last = records->back();
+			Assert::AreEqual(99, last.frame);
+			Assert::AreEqual(3u, last.effector_id);
+			Assert::IsTrue(last.clip == 0x0123456789abcdefu && last.modified == 0.25);
+			Assert::IsTrue(last.raw[0] == Luminance::normalize_y(3599));
+			Assert::IsTrue(last.held[0] == last.raw[0] && last.wrapped[0] == last.held[0]);
+			Assert::IsTrue(last.ys[3] == Luminance::normalize_y(3000));
+
+			// Frames nobody counted stay unknown, and their CSV field is left empty.
+			Assert::IsTrue(std::isnan(records->front().modified));
+			auto csv = std::ostringstream();
+			TelemetryLog::write_csv(csv, records->front());
+			Assert::IsTrue(csv.str().rfind("0,3,81985529216486895,,", 0) == 0);
+			std::filesystem::remove(path);
+		}
+
+		TEST_METHOD(ModifiedCountsTheHistogramTheTableChanges)
+		{
+			auto pixels = std::vector<AviUtl::PixelYC>(100);
+			for (auto i = 0u; i < pixels.size(); ++i)
+			{
+				pixels[i].y = static_cast<int16_t>(i < 30u ? 3900 + i : 1000 + i);
+			}
+			auto histogram = Histogram();
+			Frame(pixels.data(), 10u, 10u, 10u).histogram(histogram);
+
+			auto table = TransferTable();
+			Assert::AreEqual(0.0, histogram.modified(table));
+			table.bake([](const double y) { return std::min(y, Luminance::normalize_y(3900)); });
+			Assert::AreEqual(0.29, histogram.modified(table), 1e-12);
+			Assert::AreEqual(0.0, Histogram().modified(table));
+		}
+	};
 }
\ No newline at end of file
@@ -0,0 +1,300 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+// Runs the per-frame path over synthetic frames with every interpolation mode and
+// processing path, and fails when operator new is called once the warm-up frames
+// are done. Replaces the global allocation functions of this executable, so it is
+// kept apart from the unit tests.
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <optional>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+#include "executor.h"
+#include "frame.h"
+#include "host_filter.h"
+#include "interpolation.h"
+#include "processing_mode.h"
+#include "processor.h"
+#include "project_parameter.h"
+
+
+namespace luminance_limiter_sg_alloc_test
+{
+	static std::atomic<bool> counting = false;
+	static std::atomic<uint64_t> allocations = 0u;
+
+	static inline void* allocate(const size_t bytes, const size_t alignment)
+	{
+		if (counting.load(std::memory_order_relaxed))
+		{
+			allocations.fetch_add(1u, std::memory_order_relaxed);
+		}
+
+		const auto size = bytes == 0u ? size_t{ 1 } : bytes;
+#if defined(_WIN32)
+		auto* const memory = _aligned_malloc(size, alignment);
+#else
+		auto* const memory = std::aligned_alloc(alignment, (size + alignment - 1u) / alignment * alignment);
+#endif
+		return memory;
+	}
+
+	static inline void deallocate(void* const memory) noexcept
+	{
+#if defined(_WIN32)
+		_aligned_free(memory);
+#else
+		std::free(memory);
+#endif
+	}
+}
+
+void* operator new(const size_t bytes)
+{
+	if (auto* const memory = luminance_limiter_sg_alloc_test::allocate(bytes, alignof(std::max_align_t)))
+	{
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new[](const size_t bytes)
+{
+	return operator new(bytes);
+}
+
+void* operator new(const size_t bytes, const std::align_val_t alignment)
+{
+	if (auto* const memory = luminance_limiter_sg_alloc_test::allocate(bytes, static_cast<size_t>(alignment)))
+	{
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new[](const size_t bytes, const std::align_val_t alignment)
+{
+	return operator new(bytes, alignment);
+}
+
+void* operator new(const size_t bytes, const std::nothrow_t&) noexcept
+{
+	return luminance_limiter_sg_alloc_test::allocate(bytes, alignof(std::max_align_t));
+}
+
+void* operator new[](const size_t bytes, const std::nothrow_t&) noexcept
+{
+	return luminance_limiter_sg_alloc_test::allocate(bytes, alignof(std::max_align_t));
+}
+
+void* operator new(const size_t bytes, const std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return luminance_limiter_sg_alloc_test::allocate(bytes, static_cast<size_t>(alignment));
+}
+
+void* operator new[](const size_t bytes, const std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return luminance_limiter_sg_alloc_test::allocate(bytes, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* const memory) noexcept { luminance_limiter_sg_alloc_test::deallocate(memory); }
+void operator delete[](void* const memory) noexcept { luminance_limiter_sg_alloc_test::deallocate(memory); }
+void operator delete(void* const memory, const size_t) noexcept { luminance_limiter_sg_alloc_test::deallocate(memory); }
+void operator delete[](void* const memory, const size_t) noexcept { luminance_limiter_sg_alloc_test::deallocate(memory); }
+void operator delete(void* const memory, const std::align_val_t) noexcept { luminance_limiter_sg_alloc_test::deallocate(memory); }
+void operator delete[](void* const memory, const std::align_val_t) noexcept { luminance_limiter_sg_alloc_test::deallocate(memory); }
+void operator delete(void* const memory, const size_t, const std::align_val_t) noexcept { luminance_limiter_sg_alloc_test::deallocate(memory); }
+void operator delete[](void* const memory, const size_t, const std::align_val_t) noexcept { luminance_limiter_sg_alloc_test::deallocate(memory); }
+void operator delete(void* const memory, const std::nothrow_t&) noexcept { luminance_limiter_sg_alloc_test::deallocate(memory); }
+void operator delete[](void* const memory, const std::nothrow_t&) noexcept { luminance_limiter_sg_alloc_test::deallocate(memory); }
+void operator delete(void* const memory, const std::align_val_t, const std::nothrow_t&) noexcept { luminance_limiter_sg_alloc_test::deallocate(memory); }
+void operator delete[](void* const memory, const std::align_val_t, const std::nothrow_t&) noexcept { luminance_limiter_sg_alloc_test::deallocate(memory); }
+
+namespace luminance_limiter_sg_alloc_test
+{
+	using namespace luminance_limiter_sg;
+
+	constexpr static inline auto width = 320u;
+	constexpr static inline auto height = 180u;
+	constexpr static inline auto frames = 300;
+	// Enough for the curve cache, the scratch pool and the envelope checkpoints to fill.
+	constexpr static inline auto warm_up = 40;
+
+	struct Scenario
+	{
+		const char* name;
+		ProcessingPath path;
+		bool percentile = false;
+		StatisticsQuality quality = StatisticsQuality::Exact;
+		int32_t look_ahead = 0;
+		std::array<int32_t, 2> grid = { 1, 1 };
+		// Jumps back this many frames every 50 frames, as an editor scrubbing would.
+		int32_t scrub = 0;
+		// Objects of the extended editor taking turns on one FilterPlugin, each with
+		// its own upper limit.
+		int32_t objects = 1;
+	};
+
+	constexpr static inline auto scenarios = std::array<Scenario, 8>{ {
+		{ "staged", ProcessingPath::Staged },
+		{ "in_place", ProcessingPath::InPlace },
+		{ "in_place_percentile", ProcessingPath::InPlace, true },
+		{ "in_place_draft", ProcessingPath::InPlace, false, StatisticsQuality::Draft },
+		{ "in_place_look_ahead", ProcessingPath::InPlace, false, StatisticsQuality::Exact, 200 },
+		{ "in_place_scrub", ProcessingPath::InPlace, false, StatisticsQuality::Exact, 0, { 1, 1 }, 20 },
+		{ "local_4x3", ProcessingPath::InPlace, false, StatisticsQuality::Exact, 0, { 4, 3 } },
+		{ "in_place_objects", ProcessingPath::InPlace, false, StatisticsQuality::Exact, 0, { 1, 1 }, 0, 3 },
+	} };
+
+	constexpr static inline const char* mode_name(const InterpolationMode mode) noexcept
+	{
+		switch (mode)
+		{
+		case InterpolationMode::Linear:
+			return "linear";
+		case InterpolationMode::Lagrange:
+			return "lagrange";
+		case InterpolationMode::Spline:
+			return "spline";
+		case InterpolationMode::Monotone:
+			return "monotone";
+		default:
+			return "";
+		}
+	}
+
+	// Flat midtones with a highlight that grows and moves and a flash every 24 frames,
+	// so the peaks, the envelope and the curve change from frame to frame.
+	static inline const void synthesize(const int32_t frame, std::vector<AviUtl::PixelYC>& pixels)
+	{
+		const auto flash = frame % 24 == 23;
+		const auto spot = static_cast<uint32_t>(frame * 7) % width;
+		for (auto y = 0u; y < height; ++y)
+		{
+			for (auto x = 0u; x < width; ++x)
+			{
+				const auto hot = x >= spot && x < spot + 24u && y < 40u;
+				const auto level = flash ? 4300 : hot ? 3400 + (frame % 97) * 8 : 1200 + static_cast<int32_t>((x + y) % 512u);
+				pixels[y * width + x] = AviUtl::PixelYC{ static_cast<int16_t>(level - (frame % 13) * 16), 0, 0 };
+			}
+		}
+	}
+
+	// Peaks of every frame as the look-ahead and the seek read them.
+	class ClipPeakSource
+	{
+	public:
+		ClipPeakSource(const std::vector<std::array<double, 2>>& clip) noexcept
+			: clip(clip)
+		{
+		}
+
+		inline const std::optional<std::array<double, 2>> peaks(const int32_t frame) const noexcept
+		{
+			if (frame < 0 || static_cast<size_t>(frame) >= clip.size())
+			{
+				return std::nullopt;
+			}
+			return clip[frame];
+		}
+	private:
+		const std::vector<std::array<double, 2>>& clip;
+	};
+
+	template<ProcessingPath P>
+	static inline const uint64_t run(const Scenario& scenario, const InterpolationMode mode, ThreadPool& pool, const std::vector<std::array<double, 2>>& clip)
+	{
+		auto filter = HostFilter();
+		filter.track[1] = 3760;
+		filter.track[2] = 3400;
+		filter.track[3] = 400;
+		filter.track[4] = 128;
+		filter.track[5] = 100;
+		filter.track[6] = 200;
+		filter.track[7] = static_cast<int32_t>(mode);
+		filter.track[9] = scenario.look_ahead;
+		filter.track[11] = scenario.grid[0];
+		filter.track[12] = scenario.grid[1];
+		filter.check[0] = scenario.percentile ? 1 : 0;
+
+		auto pixels = std::vector<AviUtl::PixelYC>(static_cast<size_t>(width) * height);
+		auto processor = Processor();
+
+		auto frame = 0;
+		for (auto call = 0; call < frames; ++call)
+		{
+			if (call == warm_up)
+			{
+				allocations = 0u;
+				counting = true;
+			}
+
+			filter.track[1] = 3760 - call % scenario.objects * 100;
+			synthesize(frame, pixels);
+			const auto request = FrameRequest{ pixels.data(), width, height, width, height, frame, frames, scenario.quality };
+			processor.process<P>(filter.plugin(), request, pool, [&](PeakIndex*, const auto&) {
+				return ClipPeakSource(clip);
+				});
+
+			frame = scenario.scrub && call % 50 == 49 ? frame - scenario.scrub : frame + 1;
+		}
+
+		counting = false;
+		return allocations.load();
+	}
+}
+
+int main()
+{
+	using namespace luminance_limiter_sg_alloc_test;
+
+	ProjectParameter::fps() = 30.0;
+	auto pool = ThreadPool();
+
+	auto clip = std::vector<std::array<double, 2>>(frames);
+	{
+		auto pixels = std::vector<AviUtl::PixelYC>(static_cast<size_t>(width) * height);
+		auto executor = SerialExecutor();
+		for (auto frame = 0; frame < frames; ++frame)
+		{
+			synthesize(frame, pixels);
+			clip[frame] = Frame(pixels.data(), width, height, width).peaks(executor, 1u);
+		}
+	}
+
+	auto failures = 0;
+	for (const auto& scenario : scenarios)
+	{
+		for (const auto mode : { InterpolationMode::Linear, InterpolationMode::Lagrange, InterpolationMode::Spline, InterpolationMode::Monotone })
+		{
+			const auto counted = scenario.path == ProcessingPath::Staged
+				? run<ProcessingPath::Staged>(scenario, mode, pool, clip)
+				: run<ProcessingPath::InPlace>(scenario, mode, pool, clip);
+			std::printf("%-22s %-9s %llu\n", scenario.name, mode_name(mode), static_cast<unsigned long long>(counted));
+			failures += counted == 0u ? 0 : 1;
+		}
+	}
+
+	if (failures)
+	{
+		std::printf("%d runs allocated after %d warm-up frames\n", failures, warm_up);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,722 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+// Times every stage of the limiter on synthetic YC48 frames and prints the results
+// as JSON. Builds against the real SDK on Windows and against the host stand-in
+// (LuminanceLimiterSG/host) elsewhere.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+
+#include "buffer.h"
+#include "executor.h"
+#include "frame.h"
+#include "histogram.h"
+#include "host_filter.h"
+#include "interpolation.h"
+#include "kernel.h"
+#include "knot_curve.h"
+#include "limiter.h"
+#include "local_limiter.h"
+#include "parameters.h"
+#include "peak_envelope_generator.h"
+#include "processing_mode.h"
+#include "processor.h"
+#include "project_parameter.h"
+#include "scratch_pool.h"
+#include "telemetry.h"
+#include "transfer_table.h"
+
+
+namespace luminance_limiter_sg_bench
+{
+	using namespace luminance_limiter_sg;
+
+	struct Resolution
+	{
+		const char* name;
+		uint32_t width;
+		uint32_t height;
+	};
+
+	constexpr static inline auto resolutions = std::array<Resolution, 4>
+	{
+		Resolution{ "720p", 1280u, 720u },
+		Resolution{ "1080p", 1920u, 1080u },
+		Resolution{ "4K", 3840u, 2160u },
+		Resolution{ "8K", 7680u, 4320u },
+	};
+
+	enum class Content : int32_t
+	{
+		Flat,
+		Gradient,
+		Noise,
+		Flash
+	};
+
+	constexpr static inline auto contents = std::array<Content, 4>
+	{
+		Content::Flat, Content::Gradient, Content::Noise, Content::Flash
+	};
+
+	constexpr static inline auto content_name(const Content content) noexcept
+	{
+		switch (content)
+		{
+		case Content::Flat:
+			return "flat";
+		case Content::Gradient:
+			return "gradient";
+		case Content::Noise:
+			return "noise";
+		case Content::Flash:
+			return "flash";
+		default:
+			return "";
+		}
+	}
+
+	constexpr static inline auto interpolation_name(const InterpolationMode mode) noexcept
+	{
+		switch (mode)
+		{
+		case InterpolationMode::Linear:
+			return "linear";
+		case InterpolationMode::Lagrange:
+			return "lagrange";
+		case InterpolationMode::Spline:
+			return "spline";
+		case InterpolationMode::Monotone:
+			return "monotone";
+		default:
+			return "";
+		}
+	}
+
+	constexpr static inline auto instruction_set_name(const InstructionSet instruction_set) noexcept
+	{
+		switch (instruction_set)
+		{
+		case InstructionSet::Scalar:
+			return "scalar";
+		case InstructionSet::SSE41:
+			return "sse41";
+		case InstructionSet::AVX2:
+			return "avx2";
+		case InstructionSet::AVX512:
+			return "avx512";
+		default:
+			return "";
+		}
+	}
+
+	// Keeps results of otherwise unused reductions alive.
+	static volatile double sink = 0.0;
+
+	// Frames of the flash content repeat every flash_period frames, the last of them bright.
+	constexpr static inline auto flash_period = 8u;
+
+	class XorShift
+	{
+	public:
+		explicit XorShift(const uint64_t seed) noexcept : state(seed * 0x9E3779B97F4A7C15ull + 1ull) {}
+
+		inline uint64_t operator()() noexcept
+		{
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			return state;
+		}
+	private:
+		uint64_t state;
+	};
+
+	// Y spans a little beyond [0, 4096] so that both limits have something to do.
+	static inline const void synthesize(const Content content, const uint32_t width, const uint32_t height, const uint32_t frame, std::vector<AviUtl::PixelYC>& pixels)
+	{
+		pixels.resize(static_cast<size_t>(width) * height);
+		auto random = XorShift(frame);
+		for (auto y = 0u; y < height; ++y)
+		{
+			auto* row = pixels.data() + static_cast<size_t>(y) * width;
+			for (auto x = 0u; x < width; ++x)
+			{
+				auto luma = int16_t(2048);
+				switch (content)
+				{
+				case Content::Flat:
+					luma = 2048;
+					break;
+				case Content::Gradient:
+					luma = static_cast<int16_t>(-256 + static_cast<int32_t>((static_cast<uint64_t>(x) + y) * 4608u / (static_cast<uint64_t>(width) + height - 2u)));
+					break;
+				case Content::Noise:
+					luma = static_cast<int16_t>(static_cast<int32_t>(random() % 4608u) - 256);
+					break;
+				case Content::Flash:
+					luma = static_cast<int16_t>(frame % flash_period == flash_period - 1u ? 4352 - static_cast<int32_t>(random() % 512u) : 256 + static_cast<int32_t>(random() % 1024u));
+					break;
+				}
+				row[x] = AviUtl::PixelYC{ luma, static_cast<int16_t>(x % 256u), static_cast<int16_t>(y % 256u) };
+			}
+		}
+	}
+
+	struct Options
+	{
+		std::vector<std::string> resolutions;
+		double min_time = 0.25;
+		uint32_t min_iterations = 5u;
+		uint32_t threads = std::thread::hardware_concurrency();
+		std::optional<std::string> output;
+	};
+
+	struct Result
+	{
+		std::string stage;
+		std::string variant;
+		std::string content;
+		std::string resolution;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		// Work done per iteration: pixels for frame stages, frames for the envelope.
+		uint64_t items = 0;
+		std::vector<double> samples;
+	};
+
+	class Bench
+	{
+	public:
+		explicit Bench(const Options& options) : options(options) {}
+
+		// Times f until both min_time seconds and min_iterations runs have passed.
+		// prepare runs untimed before every iteration.
+		template<typename P, typename F>
+		inline const void run(Result&& result, const P& prepare, const F& f)
+		{
+			using Clock = std::chrono::steady_clock;
+			const auto started = Clock::now();
+			auto elapsed = 0.0;
+			while (result.samples.size() < options.min_iterations || elapsed < options.min_time)
+			{
+				prepare();
+				const auto begin = Clock::now();
+				f();
+				const auto end = Clock::now();
+				result.samples.push_back(std::chrono::duration<double, std::nano>(end - begin).count());
+				elapsed = std::chrono::duration<double>(end - started).count();
+			}
+			std::cerr << result.stage << (result.variant.empty() ? "" : "/") << result.variant
+				<< " " << result.content << " " << result.resolution << std::endl;
+			results.push_back(std::move(result));
+		}
+
+		template<typename F>
+		inline const void run(Result&& result, const F& f)
+		{
+			run(std::move(result), []() {}, f);
+		}
+
+		const void write(std::ostream& out) const
+		{
+			out << "{\n";
+			out << "\t\"instruction_set\": \"" << instruction_set_name(kernels().instruction_set) << "\",\n";
+			out << "\t\"threads\": " << options.threads << ",\n";
+			out << "\t\"results\": [\n";
+			for (auto i = 0u; i < results.size(); ++i)
+			{
+				const auto& result = results[i];
+				auto samples = result.samples;
+				std::sort(samples.begin(), samples.end());
+				auto mean = 0.0;
+				for (const auto sample : samples)
+				{
+					mean += sample;
+				}
+				mean /= static_cast<double>(samples.size());
+				const auto median = samples[samples.size() / 2u];
+
+				out << "\t\t{ \"stage\": \"" << result.stage << "\""
+					<< ", \"variant\": \"" << result.variant << "\""
+					<< ", \"content\": \"" << result.content << "\""
+					<< ", \"resolution\": \"" << result.resolution << "\""
+					<< ", \"width\": " << result.width
+					<< ", \"height\": " << result.height
+					<< ", \"iterations\": " << samples.size()
+					<< ", \"min_ns\": " << samples.front()
+					<< ", \"median_ns\": " << median
+					<< ", \"mean_ns\": " << mean
+					<< ", \"max_ns\": " << samples.back()
+					<< ", \"items\": " << result.items
+					<< ", \"items_per_second\": " << (median > 0.0 ? static_cast<double>(result.items) * 1e9 / median : 0.0)
+					<< " }" << (i + 1u < results.size() ? "," : "") << "\n";
+			}
+			out << "\t]\n";
+			out << "}\n";
+		}
+	private:
+		const Options& options;
+		std::vector<Result> results;
+	};
+
+	// Knots of a drawn tone curve: a lifted toe and a rolled-off shoulder over the YC48
+	// range, with count knots spaced unevenly so the segment index has work to do.
+	static inline const std::array<std::vector<double>, 2> tone_knots(const uint32_t count, const double lift)
+	{
+		auto xs = std::vector<double>(count);
+		auto ys = std::vector<double>(count);
+		for (auto i = 0u; i < count; ++i)
+		{
+			const auto t = static_cast<double>(i) / (count - 1u);
+			xs[i] = -0.1 + 1.3 * t * (0.5 + 0.5 * t);
+			ys[i] = lift + (1.0 - lift) * (1.0 - std::exp(-3.0 * std::max(xs[i], 0.0))) / (1.0 - std::exp(-3.0)) + 0.05 * std::min(xs[i], 0.0);
+		}
+		return { xs, ys };
+	}
+
+	// Trackbar values of a limiter that actually limits: the defaults of the plugin
+	// pass everything through.
+	static inline const void configure(HostFilter& filter, const InterpolationMode mode, const bool percentile) noexcept
+	{
+		filter.track[1] = 3760;
+		filter.track[2] = 3400;
+		filter.track[3] = 400;
+		filter.track[4] = 128;
+		filter.track[5] = 100;
+		filter.track[6] = 200;
+		filter.track[7] = static_cast<int32_t>(mode);
+		filter.check[0] = percentile ? 1 : 0;
+	}
+
+	template<typename T>
+	static inline const void run_buffer_stages(Bench& bench, const char* type, const Content content, const Resolution& resolution, std::vector<AviUtl::PixelYC>& pixels)
+	{
+		const auto pixel_count = static_cast<uint64_t>(resolution.width) * resolution.height;
+		const auto result = [&](const char* stage) {
+			return Result{ stage, type, content_name(content), resolution.name, resolution.width, resolution.height, pixel_count, {} };
+			};
+
+		auto buffer = Buffer<T>(resolution.width, resolution.height);
+		bench.run(result("fetch_image"), [&]() {
+			buffer.fetch_image(resolution.width, resolution.height, pixels.data());
+			});
+
+		bench.run(result("maximum"), [&]() {
+			sink = buffer.maximum();
+			});
+		bench.run(result("minimum"), [&]() {
+			sink = buffer.minimum();
+			});
+
+		const auto [xs, ys] = make_some_charactors(
+			Luminance::normalize_y(3760), Luminance::normalize_y(3400),
+			Luminance::normalize_y(128), Luminance::normalize_y(400),
+			buffer.maximum(), buffer.minimum());
+		const auto curve = make_curve(InterpolationMode::Spline, xs, ys);
+		bench.run(result("pixelwise_map"),
+			[&]() {
+				buffer.fetch_image(resolution.width, resolution.height, pixels.data());
+			},
+			[&]() {
+				std::visit([&](const auto& character) {
+					buffer.pixelwise_map(make_limit(character, Luminance::normalize_y(3760), Luminance::normalize_y(128)));
+					}, curve);
+			});
+
+		const auto [knot_xs, knot_ys] = tone_knots(64u, 0.02);
+		const auto knots = KnotCurve(knot_xs, knot_ys, InterpolationMode::Monotone);
+		bench.run(result("pixelwise_map_knots64"),
+			[&]() {
+				buffer.fetch_image(resolution.width, resolution.height, pixels.data());
+			},
+			[&]() {
+				buffer.pixelwise_map([&](const double y) { return knots(y); });
+			});
+
+		bench.run(result("render"), [&]() {
+			buffer.render(resolution.width, resolution.height, pixels.data());
+			});
+	}
+
+	static inline const void run_curve_stages(Bench& bench)
+	{
+		for (const auto mode : { InterpolationMode::Linear, InterpolationMode::Lagrange, InterpolationMode::Spline, InterpolationMode::Monotone })
+		{
+			auto table = TransferTable();
+			auto frame = 0u;
+			bench.run(Result{ "curve", interpolation_name(mode), "", "", 0u, 0u, TransferTable::size, {} }, [&]() {
+				// Peaks move every iteration so nothing is hoisted out of the loop.
+				const auto top_peak = Luminance::normalize_y(3800 + static_cast<int32_t>(frame % 512u));
+				const auto bottom_peak = Luminance::normalize_y(64 - static_cast<int32_t>(frame % 256u));
+				++frame;
+				const auto [xs, ys] = make_some_charactors(
+					Luminance::normalize_y(3760), Luminance::normalize_y(3400),
+					Luminance::normalize_y(128), Luminance::normalize_y(400),
+					top_peak, bottom_peak);
+				std::visit([&](const auto& character) {
+					table.bake(make_limit(character, Luminance::normalize_y(3760), Luminance::normalize_y(128)));
+					}, make_curve(mode, xs, ys));
+				});
+		}
+
+		for (const auto mode : { InterpolationMode::Linear, InterpolationMode::Spline, InterpolationMode::Monotone })
+		{
+			auto table = TransferTable();
+			auto frame = 0u;
+			const auto variant = std::string("knots64_") + interpolation_name(mode);
+			bench.run(Result{ "curve", variant, "", "", 0u, 0u, TransferTable::size, {} }, [&]() {
+				const auto [xs, ys] = tone_knots(64u, 0.01 * static_cast<double>(frame++ % 4u));
+				table.bake(KnotCurve(xs, ys, mode));
+				});
+		}
+	}
+
+	static inline const void run_envelope_stages(Bench& bench)
+	{
+		constexpr auto frames = 4096u;
+		auto peaks = std::vector<std::array<double, 2>>(frames);
+		auto random = XorShift(frames);
+		for (auto i = 0u; i < frames; ++i)
+		{
+			const auto flash = i % flash_period == flash_period - 1u;
+			peaks[i] = {
+				Luminance::normalize_y((flash ? 4000 : 2500) + static_cast<int32_t>(random() % 600u)),
+				Luminance::normalize_y(static_cast<int32_t>(random() % 600u) - 300) };
+		}
+		auto envelope = std::vector<std::array<double, 2>>(frames);
+
+		for (const auto sustain : { 0u, 6u, 60u, 600u, 3000u })
+		{
+			auto generator = PeakEnvelopeGenerator();
+			generator.set_limit(Luminance::normalize_y(3760), Luminance::normalize_y(128));
+			generator.reserve(sustain);
+			generator.set_sustain(sustain);
+			generator.set_release(12.0);
+
+			const auto variant = "sustain=" + std::to_string(sustain);
+			bench.run(Result{ "envelope", variant, "flash", "", 0u, 0u, frames, {} },
+				[&]() {
+					generator.reset();
+				},
+				[&]() {
+					for (const auto& [top, bottom] : peaks)
+					{
+						generator.update_and_get_envelope_peaks(top, bottom);
+					}
+				});
+			bench.run(Result{ "envelope_batch", variant, "flash", "", 0u, 0u, frames, {} },
+				[&]() {
+					generator.reset();
+				},
+				[&]() {
+					generator.process(peaks, envelope);
+				});
+		}
+	}
+
+	// The work func_proc does for one instance on one frame, for either processing path.
+	static inline const void run_frame_stages(Bench& bench, ThreadPool& pool, const Content content, const Resolution& resolution)
+	{
+		const auto pixel_count = static_cast<uint64_t>(resolution.width) * resolution.height;
+		const auto sequence = content == Content::Flash ? flash_period : 1u;
+		auto sources = std::vector<std::vector<AviUtl::PixelYC>>(sequence);
+		for (auto i = 0u; i < sequence; ++i)
+		{
+			synthesize(content, resolution.width, resolution.height, i, sources[i]);
+		}
+		auto pixels = sources.front();
+		auto histogram = Histogram();
+		auto partials = std::vector<Histogram>();
+		auto scratch = ScratchPool();
+
+		struct Path
+		{
+			const char* name;
+			StatisticsQuality quality;
+			bool percentile;
+			bool staged;
+			bool local;
+		};
+		constexpr auto paths = std::array<Path, 5>
+		{
+			Path{ "in_place", StatisticsQuality::Exact, false, false, false },
+			Path{ "in_place_draft", StatisticsQuality::Draft, false, false, false },
+			Path{ "in_place_percentile", StatisticsQuality::Exact, true, false, false },
+			Path{ "staged", StatisticsQuality::Exact, false, true, false },
+			Path{ "local_16x9", StatisticsQuality::Exact, false, false, true },
+		};
+
+		for (const auto& path : paths)
+		{
+			auto filter = HostFilter();
+			configure(filter, InterpolationMode::Spline, path.percentile);
+			if (path.local)
+			{
+				filter.track[11] = 16;
+				filter.track[12] = 9;
+			}
+			const auto parameters = Parameters::of(filter.plugin());
+			auto limiter = Limiter(parameters);
+			auto local = LocalLimiter(parameters);
+			auto frame_number = 0u;
+
+			bench.run(Result{ "frame", path.name, content_name(content), resolution.name, resolution.width, resolution.height, pixel_count, {} },
+				[&]() {
+					const auto& source = sources[frame_number % sequence];
+					std::memcpy(pixels.data(), source.data(), source.size() * sizeof(AviUtl::PixelYC));
+				},
+				[&]() {
+					auto frame = Frame(pixels.data(), resolution.width, resolution.height, resolution.width);
+					if (path.local)
+					{
+						local.fetch_trackbar_and_frame(parameters, frame, resolution.width, resolution.height, pool, 1u);
+						local.apply(frame, pool);
+						++frame_number;
+						return;
+					}
+					if (path.staged)
+					{
+						auto processing_buffer = Buffer<int16_t>(resolution.width, resolution.height, resolution.width, scratch);
+						processing_buffer.fetch_image(resolution.width, resolution.height, pixels.data());
+						limiter.fetch_trackbar_and_buffer(parameters, processing_buffer);
+					}
+					else
+					{
+						const auto step = frame.sampling_step(path.quality);
+						if (path.percentile)
+						{
+							frame.histogram(histogram, partials, pool, step);
+							limiter.fetch_trackbar_and_peaks(parameters, frame.peaks(pool));
+						}
+						else
+						{
+							limiter.fetch_trackbar_and_peaks(parameters, frame.peaks(pool, step));
+						}
+					}
+					frame.apply(limiter.effect(), pool);
+					++frame_number;
+				});
+		}
+
+		// What an open telemetry log adds to a frame: one instance through Processor with
+		// the log closed and open. The writer drains into a scratch file.
+		const auto log_path = std::filesystem::temp_directory_path() / "luminance_limiter_sg_bench.llsgtelemetry";
+		for (const auto percentile : { false, true })
+		{
+			auto filter = HostFilter();
+			configure(filter, InterpolationMode::Spline, percentile);
+			for (const auto logged : { false, true })
+			{
+				if (logged && !TelemetryLog::global().open(log_path, TelemetryFormat::Binary))
+				{
+					continue;
+				}
+
+				auto processor = Processor();
+				auto frame_number = 0;
+				const auto prepare = [&]() {
+					const auto& source = sources[static_cast<uint32_t>(frame_number) % sequence];
+					std::memcpy(pixels.data(), source.data(), source.size() * sizeof(AviUtl::PixelYC));
+					};
+				const auto process = [&]() {
+					const auto request = FrameRequest{ pixels.data(), resolution.width, resolution.height, resolution.width, resolution.height, frame_number };
+					processor.process<ProcessingPath::InPlace>(filter.plugin(), request, pool, [](PeakIndex*, const auto&) {
+						return EmptyPeakSource();
+						});
+					++frame_number;
+					};
+
+				const auto variant = std::string(percentile ? "in_place_percentile" : "in_place") + (logged ? "_logged" : "");
+				bench.run(Result{ "telemetry", variant, content_name(content), resolution.name, resolution.width, resolution.height, pixel_count, {} }, prepare, process);
+
+				if (logged)
+				{
+					TelemetryLog::global().close();
+					std::filesystem::remove(log_path);
+				}
+			}
+		}
+	}
+
+	// Two instances on one frame through Processor as func_proc runs them: both in one
+	// rack, stacked, and each alone in a rack of its own.
+	static inline const void run_stack_stages(Bench& bench, ThreadPool& pool, const Content content, const Resolution& resolution)
+	{
+		const auto pixel_count = static_cast<uint64_t>(resolution.width) * resolution.height;
+		const auto sequence = content == Content::Flash ? flash_period : 1u;
+		auto sources = std::vector<std::vector<AviUtl::PixelYC>>(sequence);
+		for (auto i = 0u; i < sequence; ++i)
+		{
+			synthesize(content, resolution.width, resolution.height, i, sources[i]);
+		}
+		auto pixels = sources.front();
+
+		for (const auto percentile : { false, true })
+		{
+			auto filters = std::array<HostFilter, 2>();
+			for (auto id = 0u; id < filters.size(); ++id)
+			{
+				configure(filters[id], InterpolationMode::Spline, percentile);
+				filters[id].track[0] = static_cast<int32_t>(id);
+				filters[id].track[1] -= static_cast<int32_t>(id) * 200;
+			}
+
+			for (const auto stacked : { false, true })
+			{
+				auto processors = std::array<Processor, 2>();
+				auto frame_number = 0;
+				const auto prepare = [&]() {
+					const auto& source = sources[static_cast<uint32_t>(frame_number) % sequence];
+					std::memcpy(pixels.data(), source.data(), source.size() * sizeof(AviUtl::PixelYC));
+					};
+				const auto process = [&]() {
+					const auto request = FrameRequest{ pixels.data(), resolution.width, resolution.height, resolution.width, resolution.height, frame_number };
+					for (auto id = 0u; id < filters.size(); ++id)
+					{
+						auto& processor = processors[stacked ? 0u : id];
+						processor.process<ProcessingPath::InPlace>(filters[id].plugin(), request, pool, [](PeakIndex*, const auto&) {
+							return EmptyPeakSource();
+							});
+					}
+					++frame_number;
+					};
+
+				// The rack counts its instances once the frame after they first ran.
+				for (auto warm_up = 0; warm_up < 2; ++warm_up)
+				{
+					prepare();
+					process();
+				}
+
+				const auto variant = std::string(stacked ? "stacked" : "independent") + (percentile ? "_percentile" : "");
+				bench.run(Result{ "stack_x2", variant, content_name(content), resolution.name, resolution.width, resolution.height, pixel_count, {} }, prepare, process);
+			}
+		}
+	}
+
+	static inline const std::optional<Options> parse(const int argc, const char* const argv[])
+	{
+		auto options = Options();
+		for (auto i = 1; i < argc; ++i)
+		{
+			const auto argument = std::string(argv[i]);
+			const auto has_value = i + 1 < argc;
+			if (argument == "--resolution" && has_value)
+			{
+				options.resolutions.push_back(argv[++i]);
+			}
+			else if (argument == "--min-time" && has_value)
+			{
+				options.min_time = std::stod(argv[++i]);
+			}
+			else if (argument == "--min-iterations" && has_value)
+			{
+				options.min_iterations = static_cast<uint32_t>(std::stoul(argv[++i]));
+			}
+			else if (argument == "--threads" && has_value)
+			{
+				options.threads = static_cast<uint32_t>(std::stoul(argv[++i]));
+			}
+			else if (argument == "--output" && has_value)
+			{
+				options.output = argv[++i];
+			}
+			else
+			{
+				std::cerr
+					<< "usage: " << argv[0] << " [--resolution 720p|1080p|4K|8K]... [--min-time seconds]\n"
+					<< "       [--min-iterations n] [--threads n] [--output file.json]" << std::endl;
+				return std::nullopt;
+			}
+		}
+		if (options.resolutions.empty())
+		{
+			for (const auto& resolution : resolutions)
+			{
+				options.resolutions.push_back(resolution.name);
+			}
+		}
+		if (options.threads == 0u)
+		{
+			options.threads = 1u;
+		}
+		return options;
+	}
+}
+
+
+int main(const int argc, const char* const argv[])
+{
+	using namespace luminance_limiter_sg_bench;
+
+	const auto options = parse(argc, argv);
+	if (!options)
+	{
+		return 2;
+	}
+
+	ProjectParameter::fps() = 60.0;
+
+	auto bench = Bench(options.value());
+	auto pool = ThreadPool(options->threads);
+
+	run_curve_stages(bench);
+	run_envelope_stages(bench);
+
+	for (const auto& name : options->resolutions)
+	{
+		const auto resolution = std::find_if(resolutions.begin(), resolutions.end(), [&](const Resolution& candidate) {
+			return name == candidate.name;
+			});
+		if (resolution == resolutions.end())
+		{
+			std::cerr << "unknown resolution " << name << std::endl;
+			return 2;
+		}
+
+		for (const auto content : contents)
+		{
+			auto pixels = std::vector<AviUtl::PixelYC>();
+			synthesize(content, resolution->width, resolution->height, 0u, pixels);
+			run_buffer_stages<double>(bench, "f64", content, *resolution, pixels);
+			run_buffer_stages<float>(bench, "f32", content, *resolution, pixels);
+			run_buffer_stages<int16_t>(bench, "i16", content, *resolution, pixels);
+			pixels = std::vector<AviUtl::PixelYC>();
+
+			run_frame_stages(bench, pool, content, *resolution);
+			run_stack_stages(bench, pool, content, *resolution);
+		}
+	}
+
+	if (options->output)
+	{
+		auto file = std::ofstream(options->output.value());
+		bench.write(file);
+	}
+	else
+	{
+		bench.write(std::cout);
+	}
+	return 0;
+}
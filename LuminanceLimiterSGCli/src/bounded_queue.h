@@ -0,0 +1,74 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+
+namespace luminance_limiter_sg_cli
+{
+	// Blocking FIFO between two pipeline stages. push waits while the queue is full,
+	// pop waits while it is empty. After close, push drops its value and pop drains
+	// what is left before returning nothing.
+	template<typename T>
+	class BoundedQueue
+	{
+	public:
+		explicit BoundedQueue(const size_t capacity) noexcept
+			: capacity(capacity)
+		{
+		}
+
+		inline const bool push(T&& value)
+		{
+			auto lock = std::unique_lock(mutex);
+			not_full.wait(lock, [&]() { return closed || items.size() < capacity; });
+			if (closed)
+			{
+				return false;
+			}
+			items.push_back(std::move(value));
+			not_empty.notify_one();
+			return true;
+		}
+
+		inline std::optional<T> pop()
+		{
+			auto lock = std::unique_lock(mutex);
+			not_empty.wait(lock, [&]() { return closed || !items.empty(); });
+			if (items.empty())
+			{
+				return std::nullopt;
+			}
+			auto value = std::move(items.front());
+			items.pop_front();
+			not_full.notify_one();
+			return value;
+		}
+
+		inline const void close()
+		{
+			auto lock = std::unique_lock(mutex);
+			closed = true;
+			not_empty.notify_all();
+			not_full.notify_all();
+		}
+	private:
+		const size_t capacity;
+		std::mutex mutex;
+		std::condition_variable not_empty;
+		std::condition_variable not_full;
+		std::deque<T> items;
+		bool closed = false;
+	};
+}
@@ -0,0 +1,608 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+// Runs the limiter over a Y4M or raw planar YUV stream outside AviUtl. Reading,
+// processing and writing run on their own threads joined by bounded queues; frames
+// are recycled through a fixed pool, so memory stays flat however long the clip is.
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "bounded_queue.h"
+#include "executor.h"
+#include "frame.h"
+#include "host_filter.h"
+#include "interpolation.h"
+#include "knot_curve.h"
+#include "luminance.h"
+#include "peak_index.h"
+#include "processing_mode.h"
+#include "processor.h"
+#include "project_parameter.h"
+#include "stage_profile.h"
+#include "telemetry.h"
+#include "transfer_table.h"
+#include "video_stream.h"
+
+
+namespace luminance_limiter_sg_cli
+{
+	using namespace luminance_limiter_sg;
+
+	using FramePointer = std::unique_ptr<StreamFrame>;
+
+	constexpr static inline auto io_buffer_size = size_t{ 1 } << 20;
+
+	struct Options
+	{
+		std::string input = "-";
+		std::string output = "-";
+		std::optional<std::string> pixel_format;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::optional<double> fps;
+		Range range = Range::Limited;
+		uint32_t threads = std::thread::hardware_concurrency();
+		uint32_t queue = 4;
+		StatisticsQuality quality = StatisticsQuality::Exact;
+		std::optional<std::string> profile;
+		std::optional<std::string> telemetry;
+		// Knots remapping Y after the limiter, in YC48 Y.
+		std::optional<std::pair<std::vector<double>, std::vector<double>>> curve;
+		InterpolationMode curve_mode = InterpolationMode::Monotone;
+		std::array<int32_t, track_n> track = track_default;
+		std::array<int32_t, check_n> check = check_default;
+	};
+
+	// FramePeakSource over the frames the processing stage holds ahead of the current
+	// one. Frames that have left the window or not arrived yet give nothing.
+	template<typename M>
+	class WindowPeakSource
+	{
+	public:
+		WindowPeakSource(const std::deque<FramePointer>& window, const VideoFormat& format, M measure) noexcept
+			: window(window), format(format), measure(measure)
+		{
+		}
+
+		inline const std::optional<std::array<double, 2>> peaks(const int32_t frame) const
+		{
+			if (window.empty() || frame < window.front()->number)
+			{
+				return std::nullopt;
+			}
+			const auto offset = static_cast<size_t>(frame - window.front()->number);
+			if (offset >= window.size())
+			{
+				return std::nullopt;
+			}
+			auto& pixels = window[offset]->pixels;
+			return measure(Frame(pixels.data(), format.width, format.height, format.width));
+		}
+	private:
+		const std::deque<FramePointer>& window;
+		const VideoFormat& format;
+		M measure;
+	};
+
+	// The first failure of any stage stops the whole pipeline.
+	class Failure
+	{
+	public:
+		template<typename... Q>
+		inline const void capture(Q&... queues)
+		{
+			{
+				auto lock = std::unique_lock(mutex);
+				if (!error)
+				{
+					error = std::current_exception();
+				}
+			}
+			(queues.close(), ...);
+		}
+
+		inline const void rethrow() const
+		{
+			if (error)
+			{
+				std::rethrow_exception(error);
+			}
+		}
+	private:
+		std::mutex mutex;
+		std::exception_ptr error;
+	};
+
+	static inline const void usage(const char* program)
+	{
+		std::cerr
+			<< "usage: " << program << " [options] [input|-]\n"
+			<< "\n"
+			<< "Reads YUV4MPEG2 (or raw planar YUV with --pix-fmt) from input or stdin and\n"
+			<< "writes the limited stream in the same format to stdout.\n"
+			<< "\n"
+			<< "stream:\n"
+			<< "  -o, --output FILE         output file (default: stdout)\n"
+			<< "  --pix-fmt FMT             raw input: gray, yuv420p, yuv422p, yuv444p, +10/12 bits\n"
+			<< "  --width N, --height N     raw input frame size\n"
+			<< "  --fps R                   frame rate (required for raw input)\n"
+			<< "  --range limited|full      sample range of Y (default: limited)\n"
+			<< "  --threads N               worker threads for the limiter\n"
+			<< "  --queue N                 frames buffered between stages (default: 4)\n"
+			<< "  --draft                   estimate statistics on a subsampled grid\n"
+			<< "  --profile FILE            write per stage latencies as JSON (profiling builds)\n"
+			<< "  --telemetry FILE          log what the limiter did on every frame (CSV if FILE ends in .csv)\n"
+			<< "\n"
+			<< "limiter (YC48 Y, 4096 = white):\n"
+			<< "  --top-limit N             upper limit           [3, 4096]    (4096)\n"
+			<< "  --top-threshold N         threshold 1           [2, 4095]    (4095)\n"
+			<< "  --bottom-threshold N      threshold 2           [1, 4094]    (1)\n"
+			<< "  --bottom-limit N          lower limit           [0, 4093]    (0)\n"
+			<< "  --sustain MS              peak hold             [1, 4096]    (1)\n"
+			<< "  --release MS              release time          [0, 4096]    (0)\n"
+			<< "  --interpolation MODE      linear, lagrange, spline, monotone  (linear)\n"
+			<< "  --exclusion N             percentile exclusion  [0, 500] .01% (10)\n"
+			<< "  --look-ahead MS           look-ahead window     [0, 1000]    (0)\n"
+			<< "  --quantize N              curve cache step      [0, 256]     (0)\n"
+			<< "  --tile-columns N          local mode grid       [1, 32]      (1)\n"
+			<< "  --tile-rows N             local mode grid       [1, 32]      (1)\n"
+			<< "  --percentile              use percentile peaks\n"
+			<< "\n"
+			<< "curve (applied after the limiter):\n"
+			<< "  --curve X:Y,X:Y,...       remap Y through these knots, X increasing, in YC48 Y\n"
+			<< "  --curve-interpolation MODE  linear, spline, monotone       (monotone)" << std::endl;
+	}
+
+	static inline const std::optional<int32_t> parse_interpolation(const std::string& value)
+	{
+		if (value == "linear")
+		{
+			return static_cast<int32_t>(InterpolationMode::Linear);
+		}
+		if (value == "lagrange")
+		{
+			return static_cast<int32_t>(InterpolationMode::Lagrange);
+		}
+		if (value == "spline")
+		{
+			return static_cast<int32_t>(InterpolationMode::Spline);
+		}
+		if (value == "monotone")
+		{
+			return static_cast<int32_t>(InterpolationMode::Monotone);
+		}
+		return std::nullopt;
+	}
+
+	static inline const std::pair<std::vector<double>, std::vector<double>> parse_knots(const std::string& value)
+	{
+		auto xs = std::vector<double>();
+		auto ys = std::vector<double>();
+		auto begin = size_t{ 0 };
+		while (begin <= value.size())
+		{
+			const auto end = std::min(value.find(',', begin), value.size());
+			const auto knot = value.substr(begin, end - begin);
+			const auto colon = knot.find(':');
+			auto x_end = size_t{ 0 };
+			auto y_end = size_t{ 0 };
+			try
+			{
+				xs.push_back(Luminance::normalize_y(std::stoi(knot.substr(0, colon), &x_end)));
+				ys.push_back(Luminance::normalize_y(std::stoi(knot.substr(colon + 1u), &y_end)));
+			}
+			catch (const std::logic_error&)
+			{
+				x_end = 0u;
+			}
+			if (colon == std::string::npos || x_end != colon || y_end != knot.size() - colon - 1u)
+			{
+				throw std::invalid_argument("--curve takes X:Y knots separated by commas.");
+			}
+			begin = end + 1u;
+		}
+		return { std::move(xs), std::move(ys) };
+	}
+
+	static inline const std::optional<Options> parse(const int argc, const char* const argv[])
+	{
+		constexpr auto track_flags = std::array<std::pair<const char*, uint32_t>, 11>
+		{
+			std::pair{ "--top-limit", 1u },
+			std::pair{ "--top-threshold", 2u },
+			std::pair{ "--bottom-threshold", 3u },
+			std::pair{ "--bottom-limit", 4u },
+			std::pair{ "--sustain", 5u },
+			std::pair{ "--release", 6u },
+			std::pair{ "--exclusion", 8u },
+			std::pair{ "--look-ahead", 9u },
+			std::pair{ "--quantize", 10u },
+			std::pair{ "--tile-columns", 11u },
+			std::pair{ "--tile-rows", 12u },
+		};
+
+		auto options = Options();
+		auto positional = false;
+		for (auto i = 1; i < argc; ++i)
+		{
+			const auto argument = std::string(argv[i]);
+			const auto value = [&]() {
+				if (i + 1 >= argc)
+				{
+					throw std::invalid_argument(argument + " needs a value.");
+				}
+				return std::string(argv[++i]);
+				};
+
+			const auto track = std::find_if(track_flags.begin(), track_flags.end(), [&](const auto& flag) {
+				return argument == flag.first;
+				});
+			if (track != track_flags.end())
+			{
+				const auto index = track->second;
+				const auto parsed = std::stoi(value());
+				if (parsed < track_s[index] || track_e[index] < parsed)
+				{
+					throw std::out_of_range(argument + " must be in [" + std::to_string(track_s[index]) + ", " + std::to_string(track_e[index]) + "].");
+				}
+				options.track[index] = parsed;
+			}
+			else if (argument == "--interpolation")
+			{
+				const auto mode = parse_interpolation(value());
+				if (!mode)
+				{
+					throw std::invalid_argument("--interpolation must be linear, lagrange, spline or monotone.");
+				}
+				options.track[7] = mode.value();
+			}
+			else if (argument == "--curve")
+			{
+				options.curve = parse_knots(value());
+			}
+			else if (argument == "--curve-interpolation")
+			{
+				const auto mode = parse_interpolation(value());
+				if (!mode || mode.value() == static_cast<int32_t>(InterpolationMode::Lagrange))
+				{
+					throw std::invalid_argument("--curve-interpolation must be linear, spline or monotone.");
+				}
+				options.curve_mode = static_cast<InterpolationMode>(mode.value());
+			}
+			else if (argument == "--percentile")
+			{
+				options.check[0] = 1;
+			}
+			else if (argument == "-o" || argument == "--output")
+			{
+				options.output = value();
+			}
+			else if (argument == "--pix-fmt")
+			{
+				options.pixel_format = value();
+			}
+			else if (argument == "--width")
+			{
+				options.width = static_cast<uint32_t>(std::stoul(value()));
+			}
+			else if (argument == "--height")
+			{
+				options.height = static_cast<uint32_t>(std::stoul(value()));
+			}
+			else if (argument == "--fps")
+			{
+				options.fps = std::stod(value());
+			}
+			else if (argument == "--range")
+			{
+				const auto range = value();
+				if (range != "limited" && range != "full")
+				{
+					throw std::invalid_argument("--range must be limited or full.");
+				}
+				options.range = range == "full" ? Range::Full : Range::Limited;
+			}
+			else if (argument == "--threads")
+			{
+				options.threads = static_cast<uint32_t>(std::stoul(value()));
+			}
+			else if (argument == "--queue")
+			{
+				options.queue = static_cast<uint32_t>(std::stoul(value()));
+			}
+			else if (argument == "--draft")
+			{
+				options.quality = StatisticsQuality::Draft;
+			}
+			else if (argument == "--profile")
+			{
+				options.profile = value();
+			}
+			else if (argument == "--telemetry")
+			{
+				options.telemetry = value();
+			}
+			else if (argument == "-h" || argument == "--help")
+			{
+				return std::nullopt;
+			}
+			else if (!positional && (argument == "-" || argument.front() != '-'))
+			{
+				options.input = argument;
+				positional = true;
+			}
+			else
+			{
+				throw std::invalid_argument("Unknown option " + argument + ".");
+			}
+		}
+
+		options.threads = options.threads == 0u ? 1u : options.threads;
+		options.queue = options.queue == 0u ? 1u : options.queue;
+		return options;
+	}
+
+	static inline std::FILE* open_stream(const std::string& path, const bool output)
+	{
+		auto* file = path == "-" ? (output ? stdout : stdin) : std::fopen(path.c_str(), output ? "wb" : "rb");
+		if (!file)
+		{
+			throw std::runtime_error("Cannot open " + path + ".");
+		}
+#if defined(_WIN32)
+		if (path == "-")
+		{
+			_setmode(_fileno(file), _O_BINARY);
+		}
+#endif
+		std::setvbuf(file, nullptr, _IOFBF, io_buffer_size);
+		return file;
+	}
+
+	static inline const int run(const Options& options)
+	{
+		auto* input = open_stream(options.input, false);
+		auto* output = open_stream(options.output, true);
+
+		auto raw_format = VideoFormat();
+		if (options.pixel_format)
+		{
+			const auto parsed = parse_pixel_format(options.pixel_format.value());
+			if (!parsed)
+			{
+				throw std::invalid_argument("Unknown pixel format " + options.pixel_format.value() + ".");
+			}
+			raw_format = parsed.value();
+			raw_format.width = options.width;
+			raw_format.height = options.height;
+			raw_format.range = options.range;
+			if (raw_format.width == 0u || raw_format.height == 0u)
+			{
+				throw std::invalid_argument("Raw input needs --width and --height.");
+			}
+		}
+		const auto container = options.pixel_format ? Container::Raw : Container::Y4M;
+
+		auto reader = VideoReader(input, container, raw_format);
+		auto format = reader.format();
+		if (container == Container::Y4M && options.range == Range::Full)
+		{
+			format.range = Range::Full;
+		}
+		if (options.fps)
+		{
+			format.fps = options.fps.value();
+		}
+		if (!(format.fps > 0.0))
+		{
+			throw std::invalid_argument("The frame rate is unknown; pass --fps.");
+		}
+		ProjectParameter::fps() = format.fps;
+
+		auto writer = VideoWriter(output, container, reader.header());
+		const auto converter = LumaConverter(format);
+
+		auto filter = HostFilter();
+		filter.track = options.track;
+		filter.check = options.check;
+		const auto* fp = filter.plugin();
+
+		auto processor = Processor();
+		auto pool = ThreadPool(options.threads);
+
+		auto curve = std::optional<TransferTable>();
+		if (options.curve)
+		{
+			const auto& [xs, ys] = options.curve.value();
+			curve.emplace().bake(KnotCurve(xs, ys, options.curve_mode));
+		}
+
+		// The processing stage holds the look-ahead window besides the current frame.
+		const auto look_ahead = static_cast<size_t>(std::ceil(static_cast<double>(options.track[9]) * format.fps / 1000.0));
+		const auto frames = look_ahead + 2u * options.queue + 2u;
+
+		auto free_frames = BoundedQueue<FramePointer>(frames);
+		auto decoded = BoundedQueue<FramePointer>(options.queue);
+		auto processed = BoundedQueue<FramePointer>(options.queue);
+		for (auto i = size_t{ 0 }; i < frames; ++i)
+		{
+			auto frame = std::make_unique<StreamFrame>();
+			frame->data.reserve(format.frame_bytes());
+			frame->pixels.reserve(static_cast<size_t>(format.width) * format.height);
+			free_frames.push(std::move(frame));
+		}
+
+		if (options.telemetry)
+		{
+			const auto path = std::filesystem::path(options.telemetry.value());
+			if (!TelemetryLog::global().open(path, path.extension() == ".csv" ? TelemetryFormat::Csv : TelemetryFormat::Binary))
+			{
+				throw std::runtime_error("Failed to open " + options.telemetry.value() + ".");
+			}
+		}
+
+		auto failure = Failure();
+
+		auto read_stage = std::thread([&]() {
+			try
+			{
+				while (auto frame = free_frames.pop())
+				{
+					if (!reader.read(*frame.value()))
+					{
+						break;
+					}
+					converter.decode(*frame.value());
+					if (!decoded.push(std::move(frame.value())))
+					{
+						break;
+					}
+				}
+				decoded.close();
+			}
+			catch (...)
+			{
+				failure.capture(free_frames, decoded, processed);
+			}
+			});
+
+		auto process_stage = std::thread([&]() {
+			try
+			{
+				auto window = std::deque<FramePointer>();
+				auto ended = false;
+				for (;;)
+				{
+					while (!ended && window.size() <= look_ahead)
+					{
+						auto frame = decoded.pop();
+						if (!frame)
+						{
+							ended = true;
+							break;
+						}
+						window.push_back(std::move(frame.value()));
+					}
+					if (window.empty())
+					{
+						break;
+					}
+
+					auto& current = *window.front();
+					const auto request = FrameRequest{
+						current.pixels.data(),
+						format.width, format.height, format.width, format.height,
+						current.number, 0, options.quality };
+					processor.process<ProcessingPath::InPlace>(fp, request, pool, [&](PeakIndex*, const auto& measure) {
+						return WindowPeakSource(window, format, measure);
+						});
+					if (curve)
+					{
+						Frame(current.pixels.data(), format.width, format.height, format.width).apply(curve.value(), pool);
+					}
+
+					if (!processed.push(std::move(window.front())))
+					{
+						break;
+					}
+					window.pop_front();
+				}
+				processed.close();
+			}
+			catch (...)
+			{
+				failure.capture(free_frames, decoded, processed);
+			}
+			});
+
+		auto write_stage = std::thread([&]() {
+			try
+			{
+				while (auto frame = processed.pop())
+				{
+					converter.encode(*frame.value());
+					writer.write(*frame.value());
+					free_frames.push(std::move(frame.value()));
+				}
+				writer.flush();
+			}
+			catch (...)
+			{
+				failure.capture(free_frames, decoded, processed);
+			}
+			});
+
+		read_stage.join();
+		process_stage.join();
+		write_stage.join();
+		TelemetryLog::global().close();
+		failure.rethrow();
+
+		if (input != stdin)
+		{
+			std::fclose(input);
+		}
+		if (output != stdout && std::fclose(output) != 0)
+		{
+			throw std::runtime_error("Failed to close " + options.output + ".");
+		}
+
+		if (options.profile && !StageProfile::global().dump(options.profile.value()))
+		{
+			std::cerr << "No stage latencies were recorded; build with LUMINANCE_LIMITER_SG_PROFILE to profile." << std::endl;
+		}
+		if (options.telemetry && TelemetryLog::global().dropped() > 0u)
+		{
+			std::cerr << TelemetryLog::global().dropped() << " telemetry records were dropped." << std::endl;
+		}
+		return 0;
+	}
+}
+
+
+int main(const int argc, const char* const argv[])
+{
+	using namespace luminance_limiter_sg_cli;
+
+	try
+	{
+		const auto options = parse(argc, argv);
+		if (!options)
+		{
+			usage(argv[0]);
+			return 2;
+		}
+		return run(options.value());
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << argv[0] << ": " << e.what() << std::endl;
+		return 1;
+	}
+}
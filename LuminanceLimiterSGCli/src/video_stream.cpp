@@ -0,0 +1,360 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#include "video_stream.h"
+
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include "luminance.h"
+
+
+namespace luminance_limiter_sg_cli
+{
+	using luminance_limiter_sg::Luminance;
+	using luminance_limiter_sg::TransferTable;
+
+	constexpr static inline auto y4m_magic = "YUV4MPEG2";
+	constexpr static inline auto y4m_frame = "FRAME";
+	constexpr static inline auto max_line = size_t{ 4096 };
+
+	const size_t VideoFormat::sample_bytes() const noexcept
+	{
+		return bit_depth > 8u ? 2u : 1u;
+	}
+
+	const size_t VideoFormat::luma_bytes() const noexcept
+	{
+		return static_cast<size_t>(width) * height * sample_bytes();
+	}
+
+	const size_t VideoFormat::frame_bytes() const noexcept
+	{
+		const auto chroma_width = chroma == ChromaFormat::Yuv444 ? width : (width + 1u) / 2u;
+		const auto chroma_height = chroma == ChromaFormat::Yuv420 ? (height + 1u) / 2u : height;
+		const auto chroma_bytes = chroma == ChromaFormat::Mono ? size_t{ 0 } : static_cast<size_t>(chroma_width) * chroma_height * sample_bytes();
+		return luma_bytes() + 2u * chroma_bytes;
+	}
+
+	LumaConverter::LumaConverter(const VideoFormat& format)
+		: format(format), to_yc48(size_t{ 1 } << format.bit_depth), from_yc48(TransferTable::size)
+	{
+		const auto maximum = static_cast<double>((1u << format.bit_depth) - 1u);
+		const auto scale = static_cast<double>(1u << (format.bit_depth - 8u));
+		const auto black = format.range == Range::Limited ? 16.0 * scale : 0.0;
+		const auto span = format.range == Range::Limited ? 219.0 * scale : maximum;
+
+		for (auto v = size_t{ 0 }; v < to_yc48.size(); ++v)
+		{
+			to_yc48[v] = Luminance::quantize_y(std::round((static_cast<double>(v) - black) * Luminance::y_max / span));
+		}
+		for (auto i = size_t{ 0 }; i < from_yc48.size(); ++i)
+		{
+			const auto y = static_cast<double>(TransferTable::y_lower + static_cast<int32_t>(i));
+			const auto v = std::round(y * span / Luminance::y_max + black);
+			from_yc48[i] = static_cast<uint16_t>(v < 0.0 ? 0.0 : (v > maximum ? maximum : v));
+		}
+	}
+
+	const void LumaConverter::decode(StreamFrame& frame) const noexcept
+	{
+		const auto count = static_cast<size_t>(format.width) * format.height;
+		frame.pixels.resize(count);
+		if (format.sample_bytes() == 1u)
+		{
+			for (auto i = size_t{ 0 }; i < count; ++i)
+			{
+				frame.pixels[i] = AviUtl::PixelYC{ to_yc48[frame.data[i]], 0, 0 };
+			}
+		}
+		else
+		{
+			const auto mask = static_cast<uint16_t>(to_yc48.size() - 1u);
+			for (auto i = size_t{ 0 }; i < count; ++i)
+			{
+				const auto v = static_cast<uint16_t>(frame.data[2u * i] | (frame.data[2u * i + 1u] << 8)) & mask;
+				frame.pixels[i] = AviUtl::PixelYC{ to_yc48[v], 0, 0 };
+			}
+		}
+	}
+
+	const void LumaConverter::encode(StreamFrame& frame) const noexcept
+	{
+		const auto count = static_cast<size_t>(format.width) * format.height;
+		const auto lookup = [&](const int16_t y) {
+			const auto clamped = y < TransferTable::y_lower ? TransferTable::y_lower : (y > TransferTable::y_upper ? TransferTable::y_upper : static_cast<int32_t>(y));
+			return from_yc48[static_cast<size_t>(clamped - TransferTable::y_lower)];
+			};
+		if (format.sample_bytes() == 1u)
+		{
+			for (auto i = size_t{ 0 }; i < count; ++i)
+			{
+				frame.data[i] = static_cast<uint8_t>(lookup(frame.pixels[i].y));
+			}
+		}
+		else
+		{
+			for (auto i = size_t{ 0 }; i < count; ++i)
+			{
+				const auto v = lookup(frame.pixels[i].y);
+				frame.data[2u * i] = static_cast<uint8_t>(v & 0xFFu);
+				frame.data[2u * i + 1u] = static_cast<uint8_t>(v >> 8);
+			}
+		}
+	}
+
+	// Y4M colour spaces: 420jpeg, 420paldv, 420mpeg2, 420, 422, 444 and mono with an
+	// optional bit depth such as 420p10 or mono12.
+	static inline const bool parse_y4m_chroma(const std::string& tag, VideoFormat& format)
+	{
+		const auto prefixes = { std::pair{ "420", ChromaFormat::Yuv420 }, std::pair{ "422", ChromaFormat::Yuv422 }, std::pair{ "444", ChromaFormat::Yuv444 }, std::pair{ "mono", ChromaFormat::Mono } };
+		for (const auto& [prefix, chroma] : prefixes)
+		{
+			const auto length = std::strlen(prefix);
+			if (tag.compare(0u, length, prefix) != 0)
+			{
+				continue;
+			}
+
+			auto rest = tag.substr(length);
+			if (rest.empty() || rest == "jpeg" || rest == "paldv" || rest == "mpeg2")
+			{
+				format.chroma = chroma;
+				format.bit_depth = 8u;
+				return true;
+			}
+			if (rest.front() == 'p')
+			{
+				rest.erase(0u, 1u);
+			}
+			if (rest.empty() || rest.find_first_not_of("0123456789") != std::string::npos)
+			{
+				return false;
+			}
+			format.chroma = chroma;
+			format.bit_depth = static_cast<uint32_t>(std::stoul(rest));
+			return true;
+		}
+		return false;
+	}
+
+	const std::optional<VideoFormat> parse_pixel_format(const std::string& name)
+	{
+		auto format = VideoFormat();
+		auto rest = std::string();
+		if (name.rfind("gray", 0u) == 0u)
+		{
+			format.chroma = ChromaFormat::Mono;
+			rest = name.substr(4u);
+		}
+		else if (name.rfind("yuv", 0u) == 0u && name.size() >= 7u && name[6] == 'p')
+		{
+			const auto sampling = name.substr(3u, 3u);
+			if (sampling == "420")
+			{
+				format.chroma = ChromaFormat::Yuv420;
+			}
+			else if (sampling == "422")
+			{
+				format.chroma = ChromaFormat::Yuv422;
+			}
+			else if (sampling == "444")
+			{
+				format.chroma = ChromaFormat::Yuv444;
+			}
+			else
+			{
+				return std::nullopt;
+			}
+			rest = name.substr(7u);
+		}
+		else
+		{
+			return std::nullopt;
+		}
+
+		if (rest.size() > 2u && rest.compare(rest.size() - 2u, 2u, "le") == 0)
+		{
+			rest.erase(rest.size() - 2u);
+		}
+		if (rest.find_first_not_of("0123456789") != std::string::npos)
+		{
+			return std::nullopt;
+		}
+		format.bit_depth = rest.empty() ? 8u : static_cast<uint32_t>(std::stoul(rest));
+		if (format.bit_depth < 8u || format.bit_depth > 12u)
+		{
+			return std::nullopt;
+		}
+		return format;
+	}
+
+	VideoReader::VideoReader(std::FILE* file, const Container container, const VideoFormat& raw_format)
+		: file(file), container(container), video_format(raw_format)
+	{
+		if (container == Container::Raw)
+		{
+			return;
+		}
+
+		const auto line = read_line();
+		if (!line || line->rfind(y4m_magic, 0u) != 0u)
+		{
+			throw std::runtime_error("Input is not a YUV4MPEG2 stream.");
+		}
+		stream_header = line.value();
+
+		video_format = VideoFormat();
+		auto tokens = std::istringstream(stream_header.substr(std::strlen(y4m_magic)));
+		auto token = std::string();
+		while (tokens >> token)
+		{
+			const auto value = token.substr(1u);
+			switch (token.front())
+			{
+			case 'W':
+				video_format.width = static_cast<uint32_t>(std::stoul(value));
+				break;
+			case 'H':
+				video_format.height = static_cast<uint32_t>(std::stoul(value));
+				break;
+			case 'F':
+			{
+				const auto colon = value.find(':');
+				const auto numerator = std::stod(value.substr(0u, colon));
+				const auto denominator = colon == std::string::npos ? 1.0 : std::stod(value.substr(colon + 1u));
+				video_format.fps = denominator > 0.0 ? numerator / denominator : 0.0;
+				break;
+			}
+			case 'C':
+				if (!parse_y4m_chroma(value, video_format))
+				{
+					throw std::runtime_error("Unsupported YUV4MPEG2 colour space C" + value + ".");
+				}
+				break;
+			case 'X':
+				if (value == "COLORRANGE=FULL")
+				{
+					video_format.range = Range::Full;
+				}
+				break;
+			default:
+				break;
+			}
+		}
+
+		if (video_format.width == 0u || video_format.height == 0u)
+		{
+			throw std::runtime_error("YUV4MPEG2 header has no frame size.");
+		}
+		if (video_format.bit_depth < 8u || video_format.bit_depth > 12u)
+		{
+			throw std::runtime_error("Only 8 to 12 bit samples are supported.");
+		}
+	}
+
+	const VideoFormat& VideoReader::format() const noexcept
+	{
+		return video_format;
+	}
+
+	const std::string& VideoReader::header() const noexcept
+	{
+		return stream_header;
+	}
+
+	const bool VideoReader::read(StreamFrame& frame)
+	{
+		if (container == Container::Y4M)
+		{
+			const auto line = read_line();
+			if (!line)
+			{
+				return false;
+			}
+			if (line->rfind(y4m_frame, 0u) != 0u)
+			{
+				throw std::runtime_error("Broken YUV4MPEG2 frame header.");
+			}
+			frame.parameters = line->substr(std::strlen(y4m_frame));
+		}
+
+		frame.data.resize(video_format.frame_bytes());
+		const auto read = std::fread(frame.data.data(), 1u, frame.data.size(), file);
+		if (read == 0u && container == Container::Raw)
+		{
+			return false;
+		}
+		if (read != frame.data.size())
+		{
+			throw std::runtime_error("Input ends in the middle of frame " + std::to_string(next_number) + ".");
+		}
+		frame.number = next_number++;
+		return true;
+	}
+
+	const std::optional<std::string> VideoReader::read_line()
+	{
+		auto line = std::string();
+		for (;;)
+		{
+			const auto c = std::fgetc(file);
+			if (c == EOF)
+			{
+				if (line.empty())
+				{
+					return std::nullopt;
+				}
+				throw std::runtime_error("Input ends inside a YUV4MPEG2 header.");
+			}
+			if (c == '\n')
+			{
+				return line;
+			}
+			if (line.size() == max_line)
+			{
+				throw std::runtime_error("YUV4MPEG2 header line is too long.");
+			}
+			line.push_back(static_cast<char>(c));
+		}
+	}
+
+	VideoWriter::VideoWriter(std::FILE* file, const Container container, const std::string& header)
+		: file(file), container(container)
+	{
+		if (container == Container::Y4M)
+		{
+			std::fputs(header.c_str(), file);
+			std::fputc('\n', file);
+		}
+	}
+
+	const void VideoWriter::write(const StreamFrame& frame)
+	{
+		if (container == Container::Y4M)
+		{
+			std::fputs(y4m_frame, file);
+			std::fputs(frame.parameters.c_str(), file);
+			std::fputc('\n', file);
+		}
+		if (std::fwrite(frame.data.data(), 1u, frame.data.size(), file) != frame.data.size())
+		{
+			throw std::runtime_error("Failed to write frame " + std::to_string(frame.number) + ".");
+		}
+	}
+
+	const void VideoWriter::flush()
+	{
+		if (std::fflush(file) != 0)
+		{
+			throw std::runtime_error("Failed to flush the output.");
+		}
+	}
+}
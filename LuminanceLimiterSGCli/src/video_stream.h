@@ -0,0 +1,119 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "aviutl/filter.hpp"
+#include "transfer_table.h"
+
+
+namespace luminance_limiter_sg_cli
+{
+	enum class Container
+	{
+		Y4M,
+		Raw
+	};
+
+	enum class ChromaFormat
+	{
+		Mono,
+		Yuv420,
+		Yuv422,
+		Yuv444
+	};
+
+	enum class Range
+	{
+		Limited,
+		Full
+	};
+
+	// Planar YUV as it comes in: the Y plane followed by the chroma planes, samples of
+	// more than 8 bits stored as little-endian 16-bit words.
+	struct VideoFormat
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		ChromaFormat chroma = ChromaFormat::Yuv420;
+		uint32_t bit_depth = 8;
+		Range range = Range::Limited;
+		double fps = 0.0;
+
+		const size_t sample_bytes() const noexcept;
+		const size_t luma_bytes() const noexcept;
+		const size_t frame_bytes() const noexcept;
+	};
+
+	// One picture travelling through the pipeline. The chroma planes stay in data
+	// untouched; only Y goes to YC48 and back.
+	struct StreamFrame
+	{
+		int32_t number = 0;
+		std::string parameters;
+		std::vector<uint8_t> data;
+		std::vector<AviUtl::PixelYC> pixels;
+	};
+
+	// Maps stored Y samples to YC48 Y and back. Video range puts black at 0 and
+	// white at 4096; the mapping is exact in both directions up to 12 bits.
+	class LumaConverter
+	{
+	public:
+		explicit LumaConverter(const VideoFormat& format);
+
+		const void decode(StreamFrame& frame) const noexcept;
+		const void encode(StreamFrame& frame) const noexcept;
+	private:
+		VideoFormat format;
+		std::vector<int16_t> to_yc48;
+		std::vector<uint16_t> from_yc48;
+	};
+
+	class VideoReader
+	{
+	public:
+		// Reads the stream header for Y4M; raw streams take format as given.
+		VideoReader(std::FILE* file, const Container container, const VideoFormat& raw_format);
+
+		const VideoFormat& format() const noexcept;
+		// Y4M stream header line without the trailing newline, empty for raw streams.
+		const std::string& header() const noexcept;
+		// Fills frame.data with the next picture; false at the end of the stream.
+		const bool read(StreamFrame& frame);
+	private:
+		std::FILE* file;
+		Container container;
+		VideoFormat video_format;
+		std::string stream_header;
+		int32_t next_number = 0;
+
+		const std::optional<std::string> read_line();
+	};
+
+	class VideoWriter
+	{
+	public:
+		VideoWriter(std::FILE* file, const Container container, const std::string& header);
+
+		const void write(const StreamFrame& frame);
+		const void flush();
+	private:
+		std::FILE* file;
+		Container container;
+	};
+
+	// Parses pixel format names such as yuv420p, yuv422p10 or gray12 for raw input.
+	const std::optional<VideoFormat> parse_pixel_format(const std::string& name);
+}
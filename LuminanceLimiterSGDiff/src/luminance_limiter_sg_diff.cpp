@@ -0,0 +1,549 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+// Runs ReferenceLimiter, the Buffer<double> path the filter used before the transfer
+// tables, and the optimized paths side by side over generated clips, and reports per
+// frame the largest Y difference from the reference and how far the envelope drifted
+// from ReferenceEnvelope. A few frames of every clip are also kept as golden files,
+// so a change to the reference itself is caught as well.
+//
+// luminance_limiter_sg_diff [--golden DIR] [--update-golden] [--report FILE]
+//
+// Golden files hold the Y of golden_count frames of golden_width x golden_height as
+// little-endian int16, frame after frame.
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "executor.h"
+#include "frame_peak_source.h"
+#include "host_filter.h"
+#include "interpolation.h"
+#include "kernel.h"
+#include "limiter.h"
+#include "luminance.h"
+#include "parameters.h"
+#include "peak_envelope_generator.h"
+#include "processing_mode.h"
+#include "processor.h"
+#include "project_parameter.h"
+#include "reference.h"
+#include "transfer_table.h"
+
+
+namespace luminance_limiter_sg_diff
+{
+	using namespace luminance_limiter_sg;
+
+	// Large enough to be split into row bands.
+	constexpr static inline auto width = 400u;
+	constexpr static inline auto height = 225u;
+	constexpr static inline auto golden_width = 48u;
+	constexpr static inline auto golden_height = 27u;
+	constexpr static inline auto golden_count = 4u;
+
+	// The table paths bake the curve at every integer Y the reference maps, so both
+	// must agree exactly, and the envelopes are the same arithmetic in the same order.
+	// Y beyond the table is looked up at its edge instead of on the curve, which is
+	// intended: such pixels must agree exactly with the reference at the edge Y. How
+	// far that is from the reference at the Y itself is reported apart; the curve is
+	// clamped to the limits, so it is at most the upper limit minus the lower limit.
+	constexpr static inline auto y_tolerance = 0;
+	constexpr static inline auto envelope_tolerance = 0.0;
+
+	// Trackbars 1 and 4 of every scenario.
+	constexpr static inline auto top_limit = 3760;
+	constexpr static inline auto bottom_limit = 128;
+	constexpr static inline auto outside_bound = top_limit - bottom_limit;
+
+	enum class Content
+	{
+		Gradient,
+		Noise,
+		Flash,
+		Clipped,
+		OutOfRange,
+		Sweep
+	};
+
+	struct Scenario
+	{
+		const char* name;
+		Content content;
+		int32_t frames;
+		// Trackbars 5 and 6, in milliseconds.
+		int32_t sustain;
+		int32_t release;
+		InterpolationMode golden_mode;
+	};
+
+	constexpr static inline auto scenarios = std::array<Scenario, 6>{ {
+		{ "gradient", Content::Gradient, 96, 100, 200, InterpolationMode::Linear },
+		{ "noise", Content::Noise, 96, 100, 200, InterpolationMode::Spline },
+		{ "flash", Content::Flash, 96, 300, 500, InterpolationMode::Monotone },
+		{ "clipped", Content::Clipped, 96, 100, 200, InterpolationMode::Lagrange },
+		{ "out_of_range", Content::OutOfRange, 96, 100, 200, InterpolationMode::Linear },
+		{ "sweep", Content::Sweep, 450, 2000, 3000, InterpolationMode::Spline },
+	} };
+
+	constexpr static inline auto modes = std::array<InterpolationMode, 4>{
+		InterpolationMode::Linear, InterpolationMode::Lagrange, InterpolationMode::Spline, InterpolationMode::Monotone };
+
+	constexpr static inline const char* mode_name(const InterpolationMode mode) noexcept
+	{
+		switch (mode)
+		{
+		case InterpolationMode::Linear:
+			return "linear";
+		case InterpolationMode::Lagrange:
+			return "lagrange";
+		case InterpolationMode::Spline:
+			return "spline";
+		case InterpolationMode::Monotone:
+			return "monotone";
+		default:
+			return "";
+		}
+	}
+
+	constexpr static inline const char* instruction_set_name(const InstructionSet instruction_set) noexcept
+	{
+		switch (instruction_set)
+		{
+		case InstructionSet::Scalar:
+			return "table_scalar";
+		case InstructionSet::SSE41:
+			return "table_sse41";
+		case InstructionSet::AVX2:
+			return "table_avx2";
+		case InstructionSet::AVX512:
+			return "table_avx512";
+		default:
+			return "";
+		}
+	}
+
+	// Integer hash, so the noise is the same on every compiler and standard library.
+	constexpr static inline uint32_t hash(uint32_t x) noexcept
+	{
+		x ^= x >> 16;
+		x *= 0x7feb352du;
+		x ^= x >> 15;
+		x *= 0x846ca68bu;
+		x ^= x >> 16;
+		return x;
+	}
+
+	static inline const void synthesize(const Content content, const int32_t frame, const uint32_t width, const uint32_t height, std::vector<AviUtl::PixelYC>& pixels)
+	{
+		for (auto y = 0u; y < height; ++y)
+		{
+			for (auto x = 0u; x < width; ++x)
+			{
+				const auto noise = hash((static_cast<uint32_t>(frame) * height + y) * width + x);
+				auto level = 0;
+				switch (content)
+				{
+				case Content::Gradient:
+					// A ramp over the whole range whose offset drifts.
+					level = static_cast<int32_t>((x * 4096u) / width) + (frame % 32) * 8 - 128;
+					break;
+				case Content::Noise:
+					// Midtones with noise whose amplitude breathes over 48 frames.
+					level = 2048 + static_cast<int32_t>(noise % 4096u) * (frame % 48 + 1) / 48 - 2048 * (frame % 48 + 1) / 48;
+					break;
+				case Content::Flash:
+					// Dark frames with a full-frame flash every 24 frames.
+					level = frame % 24 == 23 ? 4000 + static_cast<int32_t>(noise % 96u) : 300 + static_cast<int32_t>(noise % 400u);
+					break;
+				case Content::Clipped:
+					// Hard black and white areas around midtones.
+					level = x < width / 4u ? 0 : x >= width * 3u / 4u ? 4096 : 1024 + static_cast<int32_t>((x + y + static_cast<uint32_t>(frame)) % 2048u);
+					break;
+				case Content::OutOfRange:
+					// Superblack and superwhite beyond YC48, some beyond the tables.
+					level = -6000 + static_cast<int32_t>(noise % 18000u) + (frame % 7) * 100;
+					break;
+				case Content::Sweep:
+					// A highlight that rises, falls and moves over hundreds of frames.
+					level = 1000 + static_cast<int32_t>((x + y) % 1024u)
+						+ ((x + static_cast<uint32_t>(frame) * 3u) % width < 40u ? 1200 + static_cast<int32_t>(std::abs(frame % 300 - 150)) * 8 : 0);
+					break;
+				default:
+					break;
+				}
+				pixels[y * width + x] = AviUtl::PixelYC{
+					static_cast<int16_t>(std::clamp(level, static_cast<int32_t>(INT16_MIN), static_cast<int32_t>(INT16_MAX))),
+					static_cast<int16_t>(static_cast<int32_t>(noise % 512u) - 256), static_cast<int16_t>(static_cast<int32_t>(noise / 512u % 512u) - 256) };
+			}
+		}
+	}
+
+	static inline const void configure(HostFilter& filter, const Scenario& scenario, const InterpolationMode mode) noexcept
+	{
+		filter.track[1] = top_limit;
+		filter.track[2] = 3400;
+		filter.track[3] = 400;
+		filter.track[4] = bottom_limit;
+		filter.track[5] = scenario.sustain;
+		filter.track[6] = scenario.release;
+		filter.track[7] = static_cast<int32_t>(mode);
+	}
+
+	// Limiter::fetch_trackbar_and_peaks taken apart, so the kernels of every
+	// instruction set run and the enveloped peaks can be compared.
+	class TablePath
+	{
+	public:
+		TablePath(const Kernels& kernel, const Parameters& parameters)
+			: kernel(kernel)
+		{
+			envelope.set_limit(parameters.top_limit, parameters.bottom_limit);
+			envelope.reserve(parameters.max_sustain);
+			envelope.set_sustain(parameters.sustain);
+			envelope.set_release(parameters.release);
+		}
+
+		const std::array<double, 2> process(const Parameters& parameters, AviUtl::PixelYC* const pixels, const uint32_t width, const uint32_t height)
+		{
+			auto top = std::numeric_limits<int16_t>::min();
+			auto bottom = std::numeric_limits<int16_t>::max();
+			for (auto y = 0u; y < height; ++y)
+			{
+				kernel.reduce_y(pixels + y * width, width, top, bottom);
+			}
+
+			const auto enveloped = envelope.update_and_get_envelope_peaks(Luminance::normalize_y(top), Luminance::normalize_y(bottom));
+			bake_limiter(table, limiter_key(parameters, enveloped[0], enveloped[1]));
+			for (auto y = 0u; y < height; ++y)
+			{
+				kernel.apply_table_y(pixels + y * width, width, table.data());
+			}
+			return enveloped;
+		}
+	private:
+		const Kernels& kernel;
+		PeakEnvelopeGenerator envelope;
+		TransferTable table;
+	};
+
+	struct Variant
+	{
+		std::string name;
+		std::optional<TablePath> table;
+		std::optional<ProcessingPath> path;
+		std::vector<AviUtl::PixelYC> pixels;
+		int32_t max_y_error = 0;
+		int32_t frames_off = 0;
+		int32_t max_outside_error = 0;
+		double max_envelope_divergence = 0.0;
+		std::vector<int16_t> golden;
+	};
+
+	static inline const bool is_inside_table(const int16_t y) noexcept
+	{
+		return TransferTable::y_lower <= y && y <= TransferTable::y_upper;
+	}
+
+	// Largest Y error against the reference, with source Y beyond the table taken at
+	// the table's edge (edges holds the reference at y_lower and y_upper), and largest
+	// Y difference from the reference itself of the pixels beyond the table. Touching
+	// the chroma counts as an error without bound.
+	static inline const std::array<int32_t, 2> y_error(const std::vector<AviUtl::PixelYC>& source, const std::vector<AviUtl::PixelYC>& reference, const std::array<int16_t, 2>& edges, const std::vector<AviUtl::PixelYC>& result) noexcept
+	{
+		auto error = std::array<int32_t, 2>{ 0, 0 };
+		for (auto i = size_t{ 0 }; i < reference.size(); ++i)
+		{
+			if (is_inside_table(source[i].y))
+			{
+				error[0] = std::max(error[0], std::abs(reference[i].y - result[i].y));
+			}
+			else
+			{
+				const auto edge = source[i].y < TransferTable::y_lower ? edges[0] : edges[1];
+				error[0] = std::max(error[0], std::abs(edge - result[i].y));
+				error[1] = std::max(error[1], std::abs(reference[i].y - result[i].y));
+			}
+			if (reference[i].cb != result[i].cb || reference[i].cr != result[i].cr)
+			{
+				error[0] = std::numeric_limits<int32_t>::max();
+			}
+		}
+		return error;
+	}
+
+	static inline const void keep_y(const std::vector<AviUtl::PixelYC>& pixels, std::vector<int16_t>& golden)
+	{
+		for (const auto& pixel : pixels)
+		{
+			golden.push_back(pixel.y);
+		}
+	}
+
+	static inline const bool is_golden_frame(const Scenario& scenario, const int32_t frame) noexcept
+	{
+		for (auto i = 0u; i < golden_count; ++i)
+		{
+			if (frame == static_cast<int32_t>(i * static_cast<uint32_t>(scenario.frames - 1) / (golden_count - 1u)))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	struct Run
+	{
+		std::vector<Variant> variants;
+		std::vector<int16_t> golden;
+		std::vector<int16_t> sources;
+	};
+
+	// Every variant against the reference over the whole clip. Golden frames are kept
+	// when keep_golden is set.
+	static inline Run run(const Scenario& scenario, const InterpolationMode mode, const uint32_t width, const uint32_t height, ThreadPool& pool, const bool keep_golden, std::FILE* const report)
+	{
+		auto filter = HostFilter();
+		configure(filter, scenario, mode);
+		const auto* const fp = filter.plugin();
+		const auto parameters = Parameters::of(fp);
+
+		auto result = Run();
+		for (const auto instruction_set : { InstructionSet::Scalar, InstructionSet::SSE41, InstructionSet::AVX2, InstructionSet::AVX512 })
+		{
+			if (const auto kernel = kernels_for(instruction_set))
+			{
+				auto& variant = result.variants.emplace_back();
+				variant.name = instruction_set_name(instruction_set);
+				variant.table.emplace(*kernel, parameters);
+			}
+		}
+		auto& staged = result.variants.emplace_back();
+		staged.name = "staged";
+		staged.path = ProcessingPath::Staged;
+		auto& in_place = result.variants.emplace_back();
+		in_place.name = "in_place";
+		in_place.path = ProcessingPath::InPlace;
+
+		auto processors = std::vector<Processor>(result.variants.size());
+		auto reference = ReferenceLimiter(parameters);
+		auto source = std::vector<AviUtl::PixelYC>(static_cast<size_t>(width) * height);
+		auto expected = source;
+
+		for (auto frame = 0; frame < scenario.frames; ++frame)
+		{
+			synthesize(scenario.content, frame, width, height, source);
+			expected = source;
+			const auto enveloped = reference.process(parameters, expected.data(), width, height, width);
+			const auto edges = std::array<int16_t, 2>{
+				ReferenceLimiter::map_y(parameters, enveloped, static_cast<int16_t>(TransferTable::y_lower)),
+				ReferenceLimiter::map_y(parameters, enveloped, static_cast<int16_t>(TransferTable::y_upper)) };
+			if (keep_golden && is_golden_frame(scenario, frame))
+			{
+				keep_y(expected, result.golden);
+				keep_y(source, result.sources);
+			}
+
+			for (auto i = size_t{ 0 }; i < result.variants.size(); ++i)
+			{
+				auto& variant = result.variants[i];
+				variant.pixels = source;
+				auto divergence = std::optional<double>();
+				if (variant.table)
+				{
+					const auto peaks = variant.table->process(parameters, variant.pixels.data(), width, height);
+					divergence = Luminance::denormalize_y(std::max(std::abs(peaks[0] - enveloped[0]), std::abs(peaks[1] - enveloped[1])));
+				}
+				else
+				{
+					const auto request = FrameRequest{ variant.pixels.data(), width, height, width, height, frame, scenario.frames };
+					const auto make_source = [](PeakIndex*, const auto&) {
+						return MemoryPeakSource({});
+						};
+					if (variant.path == ProcessingPath::Staged)
+					{
+						processors[i].process<ProcessingPath::Staged>(fp, request, pool, make_source);
+					}
+					else
+					{
+						processors[i].process<ProcessingPath::InPlace>(fp, request, pool, make_source);
+					}
+				}
+
+				const auto [error, outside] = y_error(source, expected, edges, variant.pixels);
+				variant.max_y_error = std::max(variant.max_y_error, error);
+				variant.frames_off += error > y_tolerance ? 1 : 0;
+				variant.max_outside_error = std::max(variant.max_outside_error, outside);
+				if (divergence)
+				{
+					variant.max_envelope_divergence = std::max(variant.max_envelope_divergence, divergence.value());
+				}
+				if (keep_golden && is_golden_frame(scenario, frame))
+				{
+					keep_y(variant.pixels, variant.golden);
+				}
+				if (report)
+				{
+					std::fprintf(report, "%s\t%s\t%ux%u\t%s\t%d\t%d\t%d\t%s\n", scenario.name, mode_name(mode), width, height,
+						variant.name.c_str(), frame, error, outside,
+						divergence ? std::to_string(divergence.value()).c_str() : "-");
+				}
+			}
+		}
+		return result;
+	}
+
+	static inline const std::optional<std::vector<int16_t>> read_golden(const std::filesystem::path& path)
+	{
+		auto in = std::ifstream(path, std::ios::binary);
+		if (!in)
+		{
+			return std::nullopt;
+		}
+		auto golden = std::vector<int16_t>();
+		auto bytes = std::array<char, 2>();
+		while (in.read(bytes.data(), 2))
+		{
+			golden.push_back(static_cast<int16_t>(static_cast<uint8_t>(bytes[0]) | static_cast<uint8_t>(bytes[1]) << 8));
+		}
+		return golden;
+	}
+
+	static inline const bool write_golden(const std::filesystem::path& path, const std::vector<int16_t>& golden)
+	{
+		auto out = std::ofstream(path, std::ios::binary);
+		for (const auto y : golden)
+		{
+			const auto bits = static_cast<uint16_t>(y);
+			const auto bytes = std::array<char, 2>{ static_cast<char>(bits & 0xffu), static_cast<char>(bits >> 8) };
+			out.write(bytes.data(), 2);
+		}
+		return static_cast<bool>(out);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	using namespace luminance_limiter_sg_diff;
+
+	auto golden_directory = std::filesystem::path("golden");
+	auto update_golden = false;
+	auto report_path = std::string();
+	for (auto i = 1; i < argc; ++i)
+	{
+		const auto arg = std::string(argv[i]);
+		if (arg == "--golden" && i + 1 < argc)
+		{
+			golden_directory = argv[++i];
+		}
+		else if (arg == "--update-golden")
+		{
+			update_golden = true;
+		}
+		else if (arg == "--report" && i + 1 < argc)
+		{
+			report_path = argv[++i];
+		}
+		else
+		{
+			std::fprintf(stderr, "usage: %s [--golden DIR] [--update-golden] [--report FILE]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	ProjectParameter::fps() = 30.0;
+	auto pool = ThreadPool();
+
+	auto* report = report_path.empty() ? nullptr : std::fopen(report_path.c_str(), "w");
+	if (report)
+	{
+		std::fprintf(report, "scenario\tmode\tsize\tvariant\tframe\tmax_y_error\toutside_table_y_error\tenvelope_divergence\n");
+	}
+
+	auto failures = 0;
+	std::printf("%-14s %-9s %-13s %8s %8s %8s %10s\n", "scenario", "mode", "variant", "max_y", "frames", "outside", "envelope");
+	for (const auto& scenario : scenarios)
+	{
+		for (const auto mode : modes)
+		{
+			const auto result = run(scenario, mode, width, height, pool, false, report);
+			for (const auto& variant : result.variants)
+			{
+				const auto failed = variant.max_y_error > y_tolerance || variant.max_outside_error > outside_bound
+					|| variant.max_envelope_divergence > envelope_tolerance;
+				std::printf("%-14s %-9s %-13s %8d %8d %8d %10.4g%s\n", scenario.name, mode_name(mode), variant.name.c_str(),
+					variant.max_y_error, variant.frames_off, variant.max_outside_error, variant.max_envelope_divergence, failed ? "  FAIL" : "");
+				failures += failed ? 1 : 0;
+			}
+		}
+
+		const auto golden_path = golden_directory / (std::string(scenario.name) + ".y16");
+		const auto result = run(scenario, scenario.golden_mode, golden_width, golden_height, pool, true, report);
+		if (update_golden)
+		{
+			if (!write_golden(golden_path, result.golden))
+			{
+				std::fprintf(stderr, "cannot write %s\n", golden_path.string().c_str());
+				failures++;
+			}
+			continue;
+		}
+
+		const auto golden = read_golden(golden_path);
+		if (!golden || golden.value().size() != static_cast<size_t>(golden_count) * golden_width * golden_height)
+		{
+			std::printf("%-14s golden frames missing or of another size: %s\n", scenario.name, golden_path.string().c_str());
+			failures++;
+			continue;
+		}
+		// The optimized paths are held to the golden frames inside the table only.
+		const auto matches = [&](const std::vector<int16_t>& frames, const bool inside_only) {
+			for (auto i = size_t{ 0 }; i < frames.size(); ++i)
+			{
+				if (frames[i] != golden.value()[i] && !(inside_only && !is_inside_table(result.sources[i])))
+				{
+					return false;
+				}
+			}
+			return frames.size() == golden.value().size();
+			};
+		if (!matches(result.golden, false))
+		{
+			std::printf("%-14s reference differs from the golden frames\n", scenario.name);
+			failures++;
+		}
+		for (const auto& variant : result.variants)
+		{
+			if (!matches(variant.golden, true))
+			{
+				std::printf("%-14s %s differs from the golden frames\n", scenario.name, variant.name.c_str());
+				failures++;
+			}
+		}
+	}
+
+	if (report)
+	{
+		std::fclose(report);
+	}
+	if (failures)
+	{
+		std::printf("%d checks failed\n", failures);
+		return 1;
+	}
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,250 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+// Runs every row kernel of each instruction set the CPU supports against the scalar
+// kernels on rows whose length is not a multiple of any vector width, with Y outside
+// the table and at the ends of the int16 range, and fails on the first difference of
+// each kernel. The unit tests check the same under the MSVC test runner only.
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "kernel.h"
+#include "luminance.h"
+#include "transfer_table.h"
+
+
+namespace luminance_limiter_sg_kernel_test
+{
+	using namespace luminance_limiter_sg;
+
+	// Every vector width in pixels, one short of it and one over, and a 1080p row.
+	constexpr static inline auto lengths = std::array<uint32_t, 17>{ 0u, 1u, 3u, 7u, 8u, 9u, 15u, 16u, 17u, 31u, 32u, 33u, 47u, 48u, 49u, 65u, 1921u };
+
+	// Y at the ends of the int16 range and just outside the table on both sides.
+	constexpr static inline auto edges = std::array<int16_t, 8>{
+		INT16_MIN, INT16_MAX,
+		static_cast<int16_t>(TransferTable::y_lower - 1), static_cast<int16_t>(TransferTable::y_lower),
+		static_cast<int16_t>(TransferTable::y_upper), static_cast<int16_t>(TransferTable::y_upper + 1),
+		0, 4096
+	};
+
+	static inline std::vector<AviUtl::PixelYC> random_row(std::mt19937& rng, const uint32_t n)
+	{
+		auto row = std::vector<AviUtl::PixelYC>(n);
+		for (auto i = 0u; i < n; ++i)
+		{
+			const auto y = rng() % 4u == 0u ? edges[rng() % edges.size()]
+				: static_cast<int16_t>(static_cast<int32_t>(rng() % 14000u) - 5000);
+			row[i] = AviUtl::PixelYC{ y, static_cast<int16_t>(rng()), static_cast<int16_t>(rng()) };
+		}
+		return row;
+	}
+
+	static inline const bool same_pixels(const std::vector<AviUtl::PixelYC>& a, const std::vector<AviUtl::PixelYC>& b) noexcept
+	{
+		for (auto i = size_t{ 0 }; i < a.size(); ++i)
+		{
+			if (a[i].y != b[i].y || a[i].cb != b[i].cb || a[i].cr != b[i].cr)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	constexpr static inline const char* instruction_set_name(const InstructionSet instruction_set) noexcept
+	{
+		switch (instruction_set)
+		{
+		case InstructionSet::SSE41:
+			return "sse41";
+		case InstructionSet::AVX2:
+			return "avx2";
+		case InstructionSet::AVX512:
+			return "avx512";
+		default:
+			return "scalar";
+		}
+	}
+
+	class Checker
+	{
+	public:
+		Checker(const InstructionSet instruction_set) noexcept
+			: instruction_set(instruction_set)
+		{
+		}
+
+		inline const void expect(const bool passed, const char* kernel, const uint32_t n) noexcept
+		{
+			if (!passed)
+			{
+				std::printf("%-7s %-15s n = %u differs from scalar\n", instruction_set_name(instruction_set), kernel, n);
+				++failures;
+			}
+		}
+
+		inline const int32_t failed() const noexcept
+		{
+			return failures;
+		}
+	private:
+		const InstructionSet instruction_set;
+		int32_t failures = 0;
+	};
+
+	static inline const void check_reduce(Checker& checker, const Kernels& kernel, const std::vector<AviUtl::PixelYC>& row)
+	{
+		const auto n = static_cast<uint32_t>(row.size());
+
+		// Starts from the empty range, from a range inside the row, and from the
+		// full int16 range that no pixel can widen.
+		constexpr auto starts = std::array<std::array<int16_t, 2>, 3>{ {
+			{ INT16_MIN, INT16_MAX },
+			{ 1000, 2000 },
+			{ INT16_MAX, INT16_MIN },
+		} };
+		for (const auto& start : starts)
+		{
+			auto expected_top = start[0], expected_bottom = start[1], top = start[0], bottom = start[1];
+			scalar_kernels.reduce_y(row.data(), n, expected_top, expected_bottom);
+			kernel.reduce_y(row.data(), n, top, bottom);
+			checker.expect(expected_top == top && expected_bottom == bottom, "reduce_y", n);
+		}
+	}
+
+	static inline const void check_planes(Checker& checker, const Kernels& kernel, const std::vector<AviUtl::PixelYC>& row, std::mt19937& rng)
+	{
+		const auto n = static_cast<uint32_t>(row.size());
+
+		auto expected_f64 = std::vector<double>(n);
+		auto actual_f64 = std::vector<double>(n);
+		scalar_kernels.fetch_y_f64(row.data(), n, expected_f64.data());
+		kernel.fetch_y_f64(row.data(), n, actual_f64.data());
+		checker.expect(expected_f64 == actual_f64, "fetch_y_f64", n);
+
+		auto expected_f32 = std::vector<float>(n);
+		auto actual_f32 = std::vector<float>(n);
+		scalar_kernels.fetch_y_f32(row.data(), n, expected_f32.data());
+		kernel.fetch_y_f32(row.data(), n, actual_f32.data());
+		checker.expect(expected_f32 == actual_f32, "fetch_y_f32", n);
+
+		auto expected_i16 = std::vector<int16_t>(n);
+		auto actual_i16 = std::vector<int16_t>(n);
+		scalar_kernels.fetch_y_i16(row.data(), n, expected_i16.data());
+		kernel.fetch_y_i16(row.data(), n, actual_i16.data());
+		checker.expect(expected_i16 == actual_i16, "fetch_y_i16", n);
+
+		// Scales the planes so that some values round toward zero from both signs and
+		// some saturate past the int16 range.
+		for (auto i = 0u; i < n; ++i)
+		{
+			const auto scale = rng() % 8u == 0u ? 16.0 : 1.7;
+			expected_f64[i] = expected_f64[i] * scale - 0.0003;
+			expected_f32[i] = static_cast<float>(expected_f64[i]);
+			expected_i16[i] = static_cast<int16_t>(rng());
+		}
+
+		auto expected = row;
+		auto actual = row;
+		scalar_kernels.render_y_f64(expected.data(), n, expected_f64.data());
+		kernel.render_y_f64(actual.data(), n, expected_f64.data());
+		checker.expect(same_pixels(expected, actual), "render_y_f64", n);
+
+		expected = row;
+		actual = row;
+		scalar_kernels.render_y_f32(expected.data(), n, expected_f32.data());
+		kernel.render_y_f32(actual.data(), n, expected_f32.data());
+		checker.expect(same_pixels(expected, actual), "render_y_f32", n);
+
+		expected = row;
+		actual = row;
+		scalar_kernels.render_y_i16(expected.data(), n, expected_i16.data());
+		kernel.render_y_i16(actual.data(), n, expected_i16.data());
+		checker.expect(same_pixels(expected, actual), "render_y_i16", n);
+	}
+
+	static inline const void check_tables(Checker& checker, const Kernels& kernel, const std::vector<AviUtl::PixelYC>& row, std::mt19937& rng,
+		const TransferTable& table, const std::vector<int16_t>& left, const std::vector<int16_t>& right)
+	{
+		const auto n = static_cast<uint32_t>(row.size());
+
+		auto expected = row;
+		auto actual = row;
+		scalar_kernels.apply_table_y(expected.data(), n, table.data());
+		kernel.apply_table_y(actual.data(), n, table.data());
+		checker.expect(same_pixels(expected, actual), "apply_table_y", n);
+
+		auto weights = std::vector<int16_t>(n);
+		for (auto i = 0u; i < n; ++i)
+		{
+			weights[i] = static_cast<int16_t>(i % 5u == 0u ? (i % 2u) * Kernels::blend_one : rng() % (Kernels::blend_one + 1u));
+		}
+		for (const auto vertical : { 0, 1, 77, Kernels::blend_one - 1, Kernels::blend_one })
+		{
+			expected = row;
+			actual = row;
+			scalar_kernels.blend_tables_y(expected.data(), n, left.data(), right.data(), weights.data(), vertical);
+			kernel.blend_tables_y(actual.data(), n, left.data(), right.data(), weights.data(), vertical);
+			checker.expect(same_pixels(expected, actual), "blend_tables_y", n);
+		}
+	}
+}
+
+int main()
+{
+	using namespace luminance_limiter_sg_kernel_test;
+
+	auto table = TransferTable();
+	table.bake([](const double y) { return 0.25 + 0.5 * y * y; });
+
+	// Pair tables whose entries span the whole table range, so the blend reaches
+	// both ends of it.
+	auto left = std::vector<int16_t>(TransferTable::size * 2u);
+	auto right = std::vector<int16_t>(TransferTable::size * 2u);
+	for (auto i = size_t{ 0 }; i < TransferTable::size; ++i)
+	{
+		left[i * 2u] = table.data()[i];
+		left[i * 2u + 1u] = static_cast<int16_t>(TransferTable::y_lower + static_cast<int32_t>(i));
+		right[i * 2u] = static_cast<int16_t>(TransferTable::y_upper - static_cast<int32_t>(i));
+		right[i * 2u + 1u] = static_cast<int16_t>(table.data()[i] / 2);
+	}
+
+	auto failures = 0;
+	for (const auto instruction_set : { InstructionSet::SSE41, InstructionSet::AVX2, InstructionSet::AVX512 })
+	{
+		const auto kernel = kernels_for(instruction_set);
+		if (!kernel)
+		{
+			std::printf("%-7s not supported, skipped\n", instruction_set_name(instruction_set));
+			continue;
+		}
+
+		auto checker = Checker(instruction_set);
+		auto rng = std::mt19937(4096u);
+		for (const auto n : lengths)
+		{
+			for (auto round = 0; round < 4; ++round)
+			{
+				const auto row = random_row(rng, n);
+				check_reduce(checker, *kernel, row);
+				check_planes(checker, *kernel, row, rng);
+				check_tables(checker, *kernel, row, rng, table, left, right);
+			}
+		}
+
+		std::printf("%-7s %d differences\n", instruction_set_name(instruction_set), checker.failed());
+		failures += checker.failed();
+	}
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,179 @@
+/*
+	Copyright(c) 2023 SoseiGocho
+	This Source Code Form is subject to the terms of the Mozilla Public License,
+	v. 2.0.If a copy of the MPL was not distributed with this file, You can
+	obtain one at https ://mozilla.org/MPL/2.0/.
+*/
+
+
+// Reads a binary telemetry log (TelemetryLog) and prints one line per clip: how many
+// frames were rendered and seeked to, how often and how much the limiter changed the
+// picture, and the range the peaks and the envelope went through. Peaks are in YC48
+// Y. A clip is every record of one source and one instance, in the order logged.
+//
+// luminance_limiter_sg_telemetry LOG [--csv]
+//
+// --csv prints every record as CSV instead, the same as a log written in that format.
+
+#include <algorithm>
+#include <cmath>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "interpolation.h"
+#include "luminance.h"
+#include "telemetry.h"
+
+
+namespace luminance_limiter_sg_telemetry
+{
+	using namespace luminance_limiter_sg;
+
+	struct ClipSummary
+	{
+		uint64_t clip = 0;
+		uint32_t effector_id = 0;
+		uint32_t frames = 0;
+		// Records that do not follow the frame before them.
+		uint32_t seeks = 0;
+		// Records that counted the pixels the table changes: percentile instances only.
+		uint32_t measured = 0;
+		// Measured records whose table changed any sampled pixel.
+		uint32_t limited = 0;
+		double modified_total = 0.0;
+		double modified_max = 0.0;
+		double raw_top = -std::numeric_limits<double>::infinity();
+		double raw_bottom = std::numeric_limits<double>::infinity();
+		double wrapped_top = std::numeric_limits<double>::infinity();
+		double wrapped_bottom = -std::numeric_limits<double>::infinity();
+		int32_t last_frame = 0;
+		InterpolationMode mode = InterpolationMode::Linear;
+	};
+
+	static inline const std::vector<ClipSummary> summarize(const std::vector<FrameRecord>& records)
+	{
+		auto clips = std::vector<ClipSummary>();
+		for (const auto& record : records)
+		{
+			auto clip = std::find_if(clips.begin(), clips.end(), [&](const ClipSummary& summary) {
+				return summary.clip == record.clip && summary.effector_id == record.effector_id;
+				});
+			if (clip == clips.end())
+			{
+				clip = clips.insert(clips.end(), ClipSummary{ record.clip, record.effector_id });
+			}
+			else if (record.frame != clip->last_frame + 1)
+			{
+				clip->seeks++;
+			}
+
+			clip->frames++;
+			if (!std::isnan(record.modified))
+			{
+				clip->measured++;
+				clip->limited += record.modified > 0.0 ? 1u : 0u;
+				clip->modified_total += record.modified;
+				clip->modified_max = std::max(clip->modified_max, record.modified);
+			}
+			clip->raw_top = std::max(clip->raw_top, record.raw[0]);
+			clip->raw_bottom = std::min(clip->raw_bottom, record.raw[1]);
+			clip->wrapped_top = std::min(clip->wrapped_top, record.wrapped[0]);
+			clip->wrapped_bottom = std::max(clip->wrapped_bottom, record.wrapped[1]);
+			clip->last_frame = record.frame;
+			clip->mode = record.mode;
+		}
+		return clips;
+	}
+
+	static inline const char* mode_name(const InterpolationMode mode) noexcept
+	{
+		switch (mode)
+		{
+		case InterpolationMode::Linear:
+			return "linear";
+		case InterpolationMode::Lagrange:
+			return "lagrange";
+		case InterpolationMode::Spline:
+			return "spline";
+		case InterpolationMode::Monotone:
+			return "monotone";
+		default:
+			return "";
+		}
+	}
+}
+
+
+int main(int argc, char** argv)
+{
+	using namespace luminance_limiter_sg_telemetry;
+
+	auto path = std::string();
+	auto csv = false;
+	for (auto i = 1; i < argc; ++i)
+	{
+		const auto arg = std::string(argv[i]);
+		if (arg == "--csv")
+		{
+			csv = true;
+		}
+		else if (path.empty() && arg.front() != '-')
+		{
+			path = arg;
+		}
+		else
+		{
+			path.clear();
+			break;
+		}
+	}
+	if (path.empty())
+	{
+		std::fprintf(stderr, "usage: %s LOG [--csv]\n", argv[0]);
+		return 2;
+	}
+
+	const auto records = TelemetryLog::read(path);
+	if (!records)
+	{
+		std::fprintf(stderr, "%s is not a binary telemetry log.\n", path.c_str());
+		return 1;
+	}
+
+	if (csv)
+	{
+		std::cout.precision(9);
+		TelemetryLog::write_csv_header(std::cout);
+		for (const auto& record : records.value())
+		{
+			TelemetryLog::write_csv(std::cout, record);
+		}
+		return 0;
+	}
+
+	// Clips with no measured record show - for what only measured records tell.
+	std::printf("clip\teffector\tmode\tframes\tseeks\tmeasured\tlimited\tmodified_mean\tmodified_max\traw_top\traw_bottom\twrapped_top_min\twrapped_bottom_max\n");
+	for (const auto& clip : summarize(records.value()))
+	{
+		std::printf("%016" PRIx64 "\t%u\t%s\t%u\t%u\t%u\t",
+			clip.clip, clip.effector_id, mode_name(clip.mode),
+			clip.frames, clip.seeks, clip.measured);
+		if (clip.measured)
+		{
+			std::printf("%u\t%.4f\t%.4f\t", clip.limited, clip.modified_total / clip.measured, clip.modified_max);
+		}
+		else
+		{
+			std::printf("-\t-\t-\t");
+		}
+		std::printf("%.0f\t%.0f\t%.0f\t%.0f\n",
+			Luminance::denormalize_y(clip.raw_top), Luminance::denormalize_y(clip.raw_bottom),
+			Luminance::denormalize_y(clip.wrapped_top), Luminance::denormalize_y(clip.wrapped_bottom));
+	}
+	return 0;
+}
\ No newline at end of file